@@ -0,0 +1,199 @@
+/*****************************************************************************
+  File:     ckpt.cpp
+
+  Purpose:  This file contains the network object's checkpointing code.
+
+  A checkpoint saves the network in the background while training goes on.
+  Checkpoint() copies the weights into a snapshot (two arrays, kept from one
+  checkpoint to the next) and hands the snapshot to a thread, which writes
+  either an image from it and the network's (frozen) structure, renamed
+  over the target as Save() does, or only the weights, to a weight file
+  (see image.cpp) -- all of them, or just those changed since the last
+  checkpoint.  Only the weights change during training, so the snapshot is
+  all that need be copied; anything which would change the structure --
+  adding or removing units or interconnections, thawing, saving, or closing
+  the network -- first waits for the checkpoint to be written.  One
+  checkpoint is written at a time.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "nwclass.h"
+
+struct NWCheckpoint                     // Checkpoint being written.
+{
+  Network        *Net;                  // Network being saved.
+  pthread_t       Thread;               // Thread writing the checkpoint.
+  int             Running;              // If TRUE, thread has been started.
+  int             Kind;                 // Kind of checkpoint (CKPT_xxx).
+  char            Path[PATH_MAX + 1];   // File being written.
+  unsigned long   NumConn;              // Number of weights in snapshot.
+  unsigned long   NumUnits;             // Number of bias weights in snapshot.
+  double         *Wgt;                  // Snapshot of weights.
+  double         *BiasWgts;             // Snapshot of bias weights.
+  NWErr           Result;               // Result of last checkpoint.
+};
+
+/*****************************************************************************
+  Function:   WriterMain()
+  Purpose:    This function is the main function of the thread which writes
+              a checkpoint.
+  Parameters: void *arg                 The checkpoint (NWCheckpoint *).
+  Returns:    NULL.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void *WriterMain(void *arg)
+{
+  NWCheckpoint   *ckpt = (NWCheckpoint *)arg;
+
+  if(ckpt->Kind == CKPT_IMAGE)
+    ckpt->Result = ckpt->Net->WriteAtomic(ckpt->Path,ckpt->Wgt,
+                                          ckpt->BiasWgts,NULL);
+  else
+    ckpt->Result = ckpt->Net->WriteWeights(ckpt->Path,ckpt->Wgt,
+                                           ckpt->BiasWgts,
+                                           ckpt->Kind == CKPT_DELTA);
+  return(NULL);
+}
+
+/*****************************************************************************
+  Function:   Network::Checkpoint()
+  Purpose:    This function starts writing a checkpoint of the network, and
+              returns without waiting for it to be written (see
+              EndCheckpoint()).  The network is frozen first, if it is not
+              already; if it cannot be (it is recursive), or if the thread
+              cannot be started, an image checkpoint is written before
+              returning.  Unlike Save(), this does not change the network's
+              file.
+  Parameters: char *file                If NULL, the checkpoint is written
+                                        to the network's file (an image
+                                        only).  If a string, it is written
+                                        to the given file.
+              int kind                  Kind of checkpoint (CKPT_xxx).
+  Returns:    A NetWorks error value (0 on success).  An error in writing
+              the previous checkpoint is returned here, if it has not been
+              returned by EndCheckpoint() (the new checkpoint is still
+              started).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::Checkpoint(const char *file,int kind)
+{
+  NWCheckpoint   *ckpt;
+  unsigned long   num_conn;
+  NWErr           nwErr,prev;
+
+  if(file == NULL && kind != CKPT_IMAGE)
+    return(NW_ERR_BADPARAM);            // Weights need a file of their own.
+  if(file == NULL && Handle == NULL)    // No open file.
+    return(NW_ERR_NOFILEOPEN);
+  if(file == NULL)
+    file = Path;
+  if(strlen(file) > PATH_MAX)
+    return(NW_ERR_BADPARAM);
+
+  prev = EndCheckpoint();               // Wait for the last one.
+  if(Ckpt != NULL)
+    Ckpt->Result = NW_SUCCESS;
+
+  if(NumUnits == 0 || (nwErr = Freeze()) != NW_SUCCESS)
+  {
+    if(kind != CKPT_IMAGE)              // No weights to write.
+      nwErr = NumUnits == 0 ? NW_ERR_NOUNITS : nwErr;
+    else
+      nwErr = WriteAtomic(file,NULL,NULL,NULL);
+    return(prev != NW_SUCCESS ? prev : nwErr);
+  }
+
+  if((ckpt = Ckpt) == NULL)             // First checkpoint.
+  {
+    if((ckpt = new NWCheckpoint) == NULL)
+      return(NW_ERR_MEMORY);
+    ckpt->Net      = this;
+    ckpt->Running  = FALSE;
+    ckpt->NumConn  = ckpt->NumUnits = 0;
+    ckpt->Wgt      = ckpt->BiasWgts = NULL;
+    ckpt->Result   = NW_SUCCESS;
+    Ckpt = ckpt;
+  }
+
+// Take the snapshot, making room for it if the network has grown.
+
+  num_conn = RowStart[NumUnits];
+  if(ckpt->NumConn < num_conn || ckpt->Wgt == NULL)
+  {
+    delete[] ckpt->Wgt;
+    if((ckpt->Wgt = new double[num_conn + 1]) == NULL)
+    {
+      ckpt->NumConn = 0;
+      return(NW_ERR_MEMORY);
+    }
+    ckpt->NumConn = num_conn;
+  }
+  if(ckpt->NumUnits < NumUnits)
+  {
+    delete[] ckpt->BiasWgts;
+    if((ckpt->BiasWgts = new double[NumUnits]) == NULL)
+    {
+      ckpt->NumUnits = 0;
+      return(NW_ERR_MEMORY);
+    }
+    ckpt->NumUnits = NumUnits;
+  }
+
+  memcpy(ckpt->Wgt,Wgt,num_conn * sizeof(double));
+  memcpy(ckpt->BiasWgts,BiasWgts,NumUnits * sizeof(double));
+  strcpy(ckpt->Path,file);
+  ckpt->Kind = kind;
+
+  if(pthread_create(&ckpt->Thread,NULL,WriterMain,ckpt) == 0)
+    ckpt->Running = TRUE;
+  else                                  // Write it now instead.
+    WriterMain(ckpt);
+
+  return(prev);
+}
+
+/*****************************************************************************
+  Function:   Network::EndCheckpoint()
+  Purpose:    This function waits for the checkpoint being written, if any,
+              to be finished.
+  Parameters: None.
+  Returns:    A NetWorks error value: the result of writing the last
+              checkpoint (0 on success, or if there has been none).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::EndCheckpoint(void)
+{
+  if(Ckpt == NULL)                      // No checkpoints.
+    return(NW_SUCCESS);
+
+  if(Ckpt->Running)
+  {
+    pthread_join(Ckpt->Thread,NULL);
+    Ckpt->Running = FALSE;
+  }
+
+  return(Ckpt->Result);
+}
+
+/*****************************************************************************
+  Function:   Network::FreeCheckpoint()
+  Purpose:    This function waits for the checkpoint being written, if any,
+              and releases the snapshot.
+  Parameters: None.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::FreeCheckpoint(void)
+{
+  if(Ckpt == NULL)
+    return;
+
+  EndCheckpoint();
+  delete[] Ckpt->Wgt;
+  delete[] Ckpt->BiasWgts;
+  delete Ckpt;
+  Ckpt = NULL;
+}
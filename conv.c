@@ -0,0 +1,44 @@
+// Conv - rewrite a network file as an image.
+//
+// Usage: conv infile outfile
+//
+// The input file may be an image or a file of the original format; the
+// output file is an image, the format in which networks are now saved.
+// Images are the same on every machine, so they can be written on one and
+// run on another.  On little-endian machines with 64-bit longs they are
+// mapped rather than read when opened, so that they open in next to no
+// time however large they are, and their pages are shared by every process
+// using them.
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nwclass.h"
+
+int main(int argc, char *argv[])
+{
+  Network   net;
+  NWErr     nwErr;
+
+  if(argc != 3)
+  {
+    fprintf(stderr, "Usage: %s infile outfile\n", argv[0]);
+    exit(1);
+  }
+
+  if((nwErr = net.Open(argv[1])) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[1], net.ErrMsg(nwErr));
+    exit(1);
+  }
+
+  if((nwErr = net.Save(argv[2])) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[2], net.ErrMsg(nwErr));
+    exit(1);
+  }
+
+  return(0);
+}
@@ -0,0 +1,679 @@
+/*****************************************************************************
+  File:     dataset.cpp
+
+  Purpose:  This file contains the code for training data set files, which
+            hold training samples ready to be fed to a network, so that
+            they need not be parsed from text each time a network is
+            trained.
+
+  A data set is the same on every machine: values are little-endian, and
+  reals are IEEE doubles.  The file begins with a header (NWDataHdr), and
+  holds the samples in blocks of BlockRows samples each (the last block may
+  hold fewer).  Each sample has a learning coefficient, NumInput input
+  values and NumOutput target values.  Within a block the values are kept
+  by column -- first the learning coefficients of all its samples, then
+  their input values, then their target values -- with each sample's input
+  values, and its target values, consecutive, so that they can be handed to
+  the network as they lie:
+
+    eta           double[n]
+    input         double[n][NumInput]
+    target        double[n][NumOutput]
+
+  Blocks are about DATA_BLOCK bytes, and follow one another with no padding,
+  so the file's size, and where each sample lies, follow from the header.
+
+  On a little-endian machine the file is mapped read-only, so opening it
+  costs nothing however large it is, and samples are read from the mapping
+  as they are used.  On any other machine it is read into memory and
+  converted.
+
+  A data set too large to be held in memory is instead read a chunk -- a
+  run of whole blocks -- at a time (OpenStream()).  Two chunks are held:
+  the one in use, and the next, which is read by a thread of its own while
+  the first is used (Fetch() and NextChunk()).  Chunks may be read in any
+  order, so that the samples can be shuffled a chunk at a time.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nwclass.h"
+
+#define DATA_VERSION  1                 // Version of the data set format.
+#define DATA_BLOCK    (1 << 20)         // Approximate size of a block.
+
+struct NWDataHdr                        // Header of a data set file.
+{
+  char            Magic[4];             // Magic number ("NWDS").
+  uint32_t        Version;              // Version of format (DATA_VERSION).
+  uint32_t        Flags;                // Reserved -- set to 0.
+  uint32_t        BlockRows;            // Samples per block.
+  uint64_t        NumRows;              // Number of samples.
+  uint64_t        NumInput;             // Input values per sample.
+  uint64_t        NumOutput;            // Target values per sample.
+  char            _Rsvd[24];            // Reserved -- set to 0.
+};
+
+struct NWStream                         // Data set being streamed.
+{
+  NWDataset      *Set;                  // Data set being read.
+  FILE           *Handle;               // Data set file.
+  pthread_t       Thread;               // Thread reading a chunk.
+  int             Running;              // If TRUE, thread has been started.
+  int             Pending;              // If TRUE, a chunk has been fetched.
+  unsigned long   ChunkBlocks;          // Blocks per chunk.
+  unsigned long   Chunk;                // Chunk fetched.
+  double         *Buf[2];               // Chunk in use, and chunk fetched.
+  NWErr           Result;               // Result of reading chunk fetched.
+};
+
+/*****************************************************************************
+  Function:   SwapHdr()
+  Purpose:    This function converts the fields of a data set header between
+              the byte order of the file and that of this machine.
+  Parameters: NWDataHdr *hdr            The header.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void SwapHdr(NWDataHdr *hdr)
+{
+  hdr->Version   = NW_LE32(hdr->Version);
+  hdr->Flags     = NW_LE32(hdr->Flags);
+  hdr->BlockRows = NW_LE32(hdr->BlockRows);
+  hdr->NumRows   = NW_LE64(hdr->NumRows);
+  hdr->NumInput  = NW_LE64(hdr->NumInput);
+  hdr->NumOutput = NW_LE64(hdr->NumOutput);
+}
+
+/*****************************************************************************
+  Function:   SwapReals()
+  Purpose:    This function converts a list of reals between the byte order
+              of the file and that of this machine.
+  Parameters: double *list              The reals.
+              unsigned long num         Number of reals.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void SwapReals(double *list,unsigned long num)
+{
+#ifndef NW_LSBFIRST
+  uint64_t        bits;
+
+  for(;num > 0;num--,list++)
+  {
+    memcpy(&bits,list,sizeof(bits));
+    bits = NW_LE64(bits);
+    memcpy(list,&bits,sizeof(bits));
+  }
+#else                                   // Already in this machine's order.
+  (void)list;
+  (void)num;
+#endif
+}
+
+/*****************************************************************************
+  Function:   ReadHdr()
+  Purpose:    This function reads and checks the header of a data set file.
+  Parameters: FILE *handle              The file, positioned at its start.
+              NWDataHdr *hdr            Receives the header.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static NWErr ReadHdr(FILE *handle,NWDataHdr *hdr)
+{
+  struct stat     st;
+  uint64_t        width,size;
+
+  if(fread(hdr,1,sizeof(NWDataHdr),handle) < sizeof(NWDataHdr) ||
+     fstat(fileno(handle),&st) != 0)
+    return(NW_ERR_READING);
+  SwapHdr(hdr);
+
+// The size of the file must be just that of the samples it claims to hold
+//   (guarding against overflow in working it out).
+
+  width = hdr->NumInput + hdr->NumOutput + 1;
+  size  = sizeof(NWDataHdr) + hdr->NumRows * width * sizeof(double);
+  if(memcmp(hdr->Magic,"NWDS",4) != 0 || hdr->Version != DATA_VERSION ||
+     hdr->Flags != 0 || hdr->BlockRows == 0 ||
+     hdr->NumInput > (uint64_t)1 << 32 || hdr->NumOutput > (uint64_t)1 << 32 ||
+     hdr->NumRows > ((uint64_t)-1 >> 4) / width ||
+     (uint64_t)st.st_size != size || size > (size_t)-1)
+    return(NW_ERR_BADFILE);
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::Open()
+  Purpose:    This function opens a data set file for reading.  The whole
+              file is mapped (or read) at once; see OpenStream() for a data
+              set too large for that.
+  Parameters: char *file                Name of file.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWDataset::Open(const char *file)
+{
+  NWDataHdr       hdr;
+  FILE           *handle;
+  uint64_t        size;
+  char           *base;
+  NWErr           nwErr;
+
+  if(Data != NULL || Handle != NULL ||  // Already in use.
+     Stream != NULL)
+    return(NW_ERR_NETOPEN);
+
+  if((handle = fopen(file,"rb")) == NULL)
+    return(NW_ERR_OPENING);
+
+  if((nwErr = ReadHdr(handle,&hdr)) != NW_SUCCESS)
+  {
+    fclose(handle);
+    return(nwErr);
+  }
+  size = sizeof(NWDataHdr) +
+         hdr.NumRows * (hdr.NumInput + hdr.NumOutput + 1) * sizeof(double);
+
+#ifdef NW_LSBFIRST
+  base = (char *)mmap(NULL,size,PROT_READ,MAP_SHARED,fileno(handle),0);
+  fclose(handle);
+  if(base == (char *)MAP_FAILED)
+    return(NW_ERR_READING);
+  madvise(base,size,MADV_WILLNEED);
+  Mapped = TRUE;
+#else
+  if((base = (char *)malloc(size)) == NULL)
+  {
+    fclose(handle);
+    return(NW_ERR_MEMORY);
+  }
+  rewind(handle);
+  if(fread(base,1,size,handle) < size)
+  {
+    fclose(handle);
+    free(base);
+    return(NW_ERR_READING);
+  }
+  fclose(handle);
+  SwapReals((double *)(base + sizeof(NWDataHdr)),
+            (size - sizeof(NWDataHdr)) / sizeof(double));
+  Mapped = FALSE;
+#endif
+
+  Data       = base;
+  Size       = size;
+  Rows       = (const double *)(base + sizeof(NWDataHdr));
+  FirstBlock = 0;
+  NumRows    = hdr.NumRows;
+  NumInput   = hdr.NumInput;
+  NumOutput  = hdr.NumOutput;
+  BlockRows  = hdr.BlockRows;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::Row()
+  Purpose:    This function finds where a sample's values lie.  If the
+              data set is being streamed, the sample must be in the chunk in
+              use.
+  Parameters: unsigned long row         Number of sample (less than NumRows).
+              double **input            Receives the sample's input values.
+              double **target           Receives the sample's target values.
+  Returns:    The sample's learning coefficient (a pointer to it).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+const double *NWDataset::Row(unsigned long row,const double **input,
+                             const double **target) const
+{
+  unsigned long   first,num,ix;
+  const double   *block;
+
+  ix    = row % BlockRows;
+  first = row - ix;
+  num   = NumRows - first < BlockRows ? NumRows - first : BlockRows;
+  block = Rows + (first - FirstBlock * BlockRows) *
+                 (NumInput + NumOutput + 1);
+
+  *input  = block + num + ix * NumInput;
+  *target = block + num + num * NumInput + ix * NumOutput;
+  return(block + ix);
+}
+
+/*****************************************************************************
+  Function:   ReaderMain()
+  Purpose:    This function is the main function of the thread which reads
+              a chunk of a data set being streamed.  The chunk is read into
+              the second of the stream's buffers.
+  Parameters: void *arg                 The stream (NWStream *).
+  Returns:    NULL.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void *ReaderMain(void *arg)
+{
+  NWStream       *stream = (NWStream *)arg;
+  NWDataset      *set = stream->Set;
+  unsigned long   first,num,width;
+  off_t           off;
+  size_t          len,done;
+  ssize_t         got;
+
+  width = set->NumInput + set->NumOutput + 1;
+  first = stream->Chunk * stream->ChunkBlocks * set->BlockRows;
+  num   = set->NumRows - first;
+  if(num > stream->ChunkBlocks * set->BlockRows)
+    num = stream->ChunkBlocks * set->BlockRows;
+  off   = sizeof(NWDataHdr) + (off_t)first * width * sizeof(double);
+  len   = num * width * sizeof(double);
+
+  for(done = 0;done < len;done += got)
+  {
+    got = pread(fileno(stream->Handle),(char *)stream->Buf[1] + done,
+                len - done,off + done);
+    if(got <= 0)
+    {
+      stream->Result = NW_ERR_READING;
+      return(NULL);
+    }
+  }
+  SwapReals(stream->Buf[1],num * width);
+
+// The chunk is not wanted again until the next pass, so don't let the
+//   file's pages build up in memory.
+
+  posix_fadvise(fileno(stream->Handle),off,len,POSIX_FADV_DONTNEED);
+  stream->Result = NW_SUCCESS;
+  return(NULL);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::OpenStream()
+  Purpose:    This function opens a data set file to be read a chunk at a
+              time, so that no more than two chunks are in memory at once
+              however large the data set is.  A chunk is read by Fetch()
+              and made ready for use by NextChunk(), after which its samples
+              may be found by Row().
+  Parameters: char *file                Name of file.
+              unsigned long window      Samples per chunk.  This is rounded
+                                        up to a whole number of blocks.
+              unsigned long *num_chunks Receives the number of chunks.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWDataset::OpenStream(const char *file,unsigned long window,
+                            unsigned long *num_chunks)
+{
+  NWDataHdr       hdr;
+  NWStream       *stream;
+  FILE           *handle;
+  unsigned long   blocks,space;
+  NWErr           nwErr;
+
+  if(Data != NULL || Handle != NULL ||  // Already in use.
+     Stream != NULL)
+    return(NW_ERR_NETOPEN);
+
+  if((handle = fopen(file,"rb")) == NULL)
+    return(NW_ERR_OPENING);
+
+  if((nwErr = ReadHdr(handle,&hdr)) != NW_SUCCESS)
+  {
+    fclose(handle);
+    return(nwErr);
+  }
+
+  if((stream = new NWStream) == NULL)
+  {
+    fclose(handle);
+    return(NW_ERR_MEMORY);
+  }
+  stream->Set         = this;
+  stream->Handle      = handle;
+  stream->Running     = FALSE;
+  stream->Pending     = FALSE;
+  stream->ChunkBlocks = (window + hdr.BlockRows - 1) / hdr.BlockRows;
+  if(stream->ChunkBlocks == 0)
+    stream->ChunkBlocks = 1;
+  stream->Chunk       = 0;
+  stream->Result      = NW_SUCCESS;
+
+// A chunk needs no more room than the whole data set.
+
+  space = stream->ChunkBlocks * hdr.BlockRows;
+  if(space > hdr.NumRows)
+    space = hdr.NumRows;
+  space = space * (hdr.NumInput + hdr.NumOutput + 1) + 1;
+  stream->Buf[0] = new double[space];
+  stream->Buf[1] = new double[space];
+  if(stream->Buf[0] == NULL || stream->Buf[1] == NULL)
+  {
+    delete[] stream->Buf[0];
+    delete[] stream->Buf[1];
+    delete stream;
+    fclose(handle);
+    return(NW_ERR_MEMORY);
+  }
+
+  Stream     = stream;
+  Rows       = NULL;
+  FirstBlock = 0;
+  NumRows    = hdr.NumRows;
+  NumInput   = hdr.NumInput;
+  NumOutput  = hdr.NumOutput;
+  BlockRows  = hdr.BlockRows;
+
+  blocks = (NumRows + BlockRows - 1) / BlockRows;
+  *num_chunks = (blocks + stream->ChunkBlocks - 1) / stream->ChunkBlocks;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::Fetch()
+  Purpose:    This function begins reading a chunk of a data set being
+              streamed, and returns without waiting for it to be read (see
+              NextChunk()).  The chunk in use is left as it is.  If a chunk
+              is already being read, it is waited for and discarded.
+  Parameters: unsigned long chunk       Number of chunk.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWDataset::Fetch(unsigned long chunk)
+{
+  NWStream       *stream = Stream;
+
+  if(stream == NULL)                    // Not being streamed.
+    return(NW_ERR_NOFILEOPEN);
+  if(chunk * stream->ChunkBlocks * BlockRows >= NumRows)
+    return(NW_ERR_BADPARAM);
+
+  if(stream->Running)
+  {
+    pthread_join(stream->Thread,NULL);
+    stream->Running = FALSE;
+  }
+
+  stream->Chunk   = chunk;
+  stream->Pending = TRUE;
+
+  if(pthread_create(&stream->Thread,NULL,ReaderMain,stream) == 0)
+    stream->Running = TRUE;
+  else                                  // Read it now instead.
+    ReaderMain(stream);
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::NextChunk()
+  Purpose:    This function waits for the chunk being read (see Fetch()) and
+              puts it in use in place of the last one.
+  Parameters: unsigned long *first      Receives the number of the chunk's
+                                        first sample.
+              unsigned long *num        Receives the number of samples in
+                                        the chunk.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWDataset::NextChunk(unsigned long *first,unsigned long *num)
+{
+  NWStream       *stream = Stream;
+  double         *buf;
+
+  if(stream == NULL)                    // Not being streamed.
+    return(NW_ERR_NOFILEOPEN);
+  if(!stream->Pending)                  // No chunk fetched.
+    return(NW_ERR_NOTREADY);
+
+  if(stream->Running)
+  {
+    pthread_join(stream->Thread,NULL);
+    stream->Running = FALSE;
+  }
+  stream->Pending = FALSE;
+  if(stream->Result != NW_SUCCESS)
+    return(stream->Result);
+
+  buf            = stream->Buf[0];
+  stream->Buf[0] = stream->Buf[1];
+  stream->Buf[1] = buf;
+
+  Rows       = stream->Buf[0];
+  FirstBlock = stream->Chunk * stream->ChunkBlocks;
+  *first     = FirstBlock * BlockRows;
+  *num       = NumRows - *first;
+  if(*num > stream->ChunkBlocks * BlockRows)
+    *num = stream->ChunkBlocks * BlockRows;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::Create()
+  Purpose:    This function begins writing a data set file.  The samples are
+              given to Append(), and the file is completed by Finish(); it
+              is written beside the given file (with ".tmp" appended to its
+              name), and renamed over it once it is complete.
+  Parameters: char *file                Name of file.
+              unsigned long num_in      Input values per sample.
+              unsigned long num_out     Target values per sample.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWDataset::Create(const char *file,unsigned long num_in,
+                        unsigned long num_out)
+{
+  NWDataHdr       hdr;
+  char            temp[PATH_MAX + 8];
+  unsigned long   width;
+
+  if(Data != NULL || Handle != NULL ||  // Already in use.
+     Stream != NULL)
+    return(NW_ERR_NETOPEN);
+  if(strlen(file) > PATH_MAX || num_in > 1UL << 24 || num_out > 1UL << 24)
+    return(NW_ERR_BADPARAM);
+
+  width     = num_in + num_out + 1;
+  BlockRows = DATA_BLOCK / (width * sizeof(double));
+  if(BlockRows == 0)
+    BlockRows = 1;
+  if((Block = new double[BlockRows * width]) == NULL)
+    return(NW_ERR_MEMORY);
+
+  sprintf(temp, "%s.tmp", file);
+  if((Handle = fopen(temp,"wb")) == NULL)
+  {
+    delete[] Block;
+    Block = NULL;
+    return(NW_ERR_CREATING);
+  }
+
+  strcpy(Path,file);
+  NumRows   = 0;
+  NumInput  = num_in;
+  NumOutput = num_out;
+  Fill      = 0;
+
+// Write the header now, to make room for it; Finish() fills in the number
+//   of samples.
+
+  memset(&hdr,0,sizeof(NWDataHdr));
+  if(fwrite(&hdr,1,sizeof(NWDataHdr),Handle) < sizeof(NWDataHdr))
+  {
+    Close();
+    return(NW_ERR_WRITING);
+  }
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   FlushBlock()
+  Purpose:    This function writes out a block of samples, packing it first
+              if it is not full.
+  Parameters: FILE *handle              File being written.
+              double *block             The block, laid out for a full one.
+              unsigned long space       Samples in a full block.
+              unsigned long num         Samples in this block.
+              unsigned long num_in      Input values per sample.
+              unsigned long num_out     Target values per sample.
+  Returns:    TRUE if the block was written.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int FlushBlock(FILE *handle,double *block,unsigned long space,
+                      unsigned long num,unsigned long num_in,
+                      unsigned long num_out)
+{
+  unsigned long   len;
+
+  if(num < space)
+  {
+    memmove(block + num,block + space,num * num_in * sizeof(double));
+    memmove(block + num + num * num_in,block + space + space * num_in,
+            num * num_out * sizeof(double));
+  }
+
+  len = num * (num_in + num_out + 1);
+  SwapReals(block,len);
+  return(fwrite(block,sizeof(double),len,handle) == len);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::Append()
+  Purpose:    This function adds a sample to the file being written.
+  Parameters: double eta                Learning coefficient.
+              double *input             Input values (NumInput of them).
+              double *target            Target values (NumOutput of them).
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWDataset::Append(double eta,const double *input,const double *target)
+{
+  if(Handle == NULL)                    // Not being written.
+    return(NW_ERR_NOFILEOPEN);
+
+  Block[Fill] = eta;
+  memcpy(Block + BlockRows + Fill * NumInput,input,
+         NumInput * sizeof(double));
+  memcpy(Block + BlockRows + BlockRows * NumInput + Fill * NumOutput,target,
+         NumOutput * sizeof(double));
+  NumRows++;
+
+  if(++Fill == BlockRows)
+  {
+    if(!FlushBlock(Handle,Block,BlockRows,Fill,NumInput,NumOutput))
+    {
+      Close();
+      return(NW_ERR_WRITING);
+    }
+    Fill = 0;
+  }
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::Finish()
+  Purpose:    This function completes the file being written: it writes the
+              last samples and the header, and, once the file is safely on
+              disk, renames it over the file named to Create().
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWDataset::Finish(void)
+{
+  NWDataHdr       hdr;
+  char            temp[PATH_MAX + 8];
+  NWErr           nwErr = NW_SUCCESS;
+
+  if(Handle == NULL)                    // Not being written.
+    return(NW_ERR_NOFILEOPEN);
+
+  memset(&hdr,0,sizeof(NWDataHdr));
+  memcpy(hdr.Magic,"NWDS",4);
+  hdr.Version   = DATA_VERSION;
+  hdr.BlockRows = BlockRows;
+  hdr.NumRows   = NumRows;
+  hdr.NumInput  = NumInput;
+  hdr.NumOutput = NumOutput;
+  SwapHdr(&hdr);
+
+  if(Fill > 0 && !FlushBlock(Handle,Block,BlockRows,Fill,NumInput,NumOutput))
+    nwErr = NW_ERR_WRITING;
+  if(nwErr == NW_SUCCESS &&
+     (fseek(Handle,0,SEEK_SET) != 0 ||
+      fwrite(&hdr,1,sizeof(NWDataHdr),Handle) < sizeof(NWDataHdr)))
+    nwErr = NW_ERR_WRITING;
+
+  sprintf(temp, "%s.tmp", Path);
+  if(nwErr == NW_SUCCESS)
+    nwErr = NWReplaceFile(Handle,temp,Path);
+
+  fclose(Handle);
+  Handle = NULL;
+  if(nwErr != NW_SUCCESS)
+    remove(temp);
+  Close();
+
+  return(nwErr);
+}
+
+/*****************************************************************************
+  Function:   NWDataset::Close()
+  Purpose:    This function releases the data set.  A file being written is
+              abandoned (see Finish()), and a chunk being read is waited
+              for.
+  Parameters: None.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void NWDataset::Close(void)
+{
+  char            temp[PATH_MAX + 8];
+
+  if(Handle != NULL)
+  {
+    fclose(Handle);
+    sprintf(temp, "%s.tmp", Path);
+    remove(temp);
+    Handle = NULL;
+  }
+  delete[] Block;
+  Block = NULL;
+  Fill  = 0;
+  strcpy(Path,"");
+
+  if(Stream != NULL)
+  {
+    if(Stream->Running)
+      pthread_join(Stream->Thread,NULL);
+    fclose(Stream->Handle);
+    delete[] Stream->Buf[0];
+    delete[] Stream->Buf[1];
+    delete Stream;
+    Stream = NULL;
+  }
+
+  if(Data != NULL && Mapped)
+    munmap(Data,Size);
+  else if(Data != NULL)
+    free(Data);
+  Data = NULL;
+  Size = 0;
+  Mapped = FALSE;
+  Rows = NULL;
+  FirstBlock = 0;
+
+  NumRows = NumInput = NumOutput = BlockRows = 0;
+}
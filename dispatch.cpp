@@ -0,0 +1,250 @@
+/*****************************************************************************
+  File:     dispatch.cpp
+
+  Purpose:  This file contains the entry points of the numeric kernels,
+            and the code which chooses the set of kernels behind them to
+            suit the CPU.
+
+  Each set is an NWKernelSet, a table of the kernels: the scalar set
+  (scalar.cpp), and the sets built from kernel.cpp for SSE2, AVX2 and
+  AVX-512 (see the Makefile), the latter two in strict and fused forms.  A
+  strict set gives exactly the results of the scalar set; a fused set lets
+  the compiler fuse multiplies with adds, which is faster but rounds
+  differently.
+
+  When the program starts, the widest set the CPU supports is chosen, in
+  its fused form if the CPU has fused multiply-adds.  The environment
+  variable NW_KERNELS overrides the choice: it holds one of the names
+  "scalar", "sse2", "avx2" or "avx512", to choose that set, and/or the word
+  "strict", to choose a strict set, separated by commas.  A set the CPU
+  does not support gives way to the widest one it does.  NWSetKernels()
+  changes the choice while the program runs; it must not be called while
+  any kernel is running.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nwclass.h"
+
+static const char *KernelNames[] = {"scalar","sse2","avx2","avx512"};
+
+static int KernSet;                     // Set in use (KERN_xxx).
+static int KernStrict;                  // If TRUE, set in use is strict.
+static const NWKernelSet *Kern;         // Kernels in use.
+
+/*****************************************************************************
+  Function:   Supported()
+  Purpose:    This function determines whether the CPU can run a set of
+              kernels.
+  Parameters: int set                   The set (KERN_xxx).
+              int fused                 If TRUE, the fused form of the set.
+  Returns:    TRUE if it can, else FALSE.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int Supported(int set,int fused)
+{
+  if(set == KERN_SCALAR || set == KERN_SSE2)
+    return(TRUE);
+
+#if defined(__x86_64__)
+  if(fused && !__builtin_cpu_supports("fma"))
+    return(FALSE);
+  if(set == KERN_AVX2)
+    return(__builtin_cpu_supports("avx2"));
+  if(set == KERN_AVX512)
+    return(__builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512bw"));
+#endif
+
+  return(FALSE);
+}
+
+/*****************************************************************************
+  Function:   NWSetKernels()
+  Purpose:    This function chooses the set of numeric kernels to be used.
+              The set must not be changed while any kernel is running.
+  Parameters: int set                   The set (KERN_xxx).
+              int strict                If TRUE, the kernels must give
+                                        exactly the results of the scalar
+                                        set; if FALSE, they may fuse
+                                        multiplies with adds, if the CPU
+                                        can.
+  Returns:    A NetWorks error value (0 on success).  NW_ERR_BADPARAM is
+              returned if the CPU cannot run the set.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWSetKernels(int set,int strict)
+{
+  int fused;
+
+  if(set < KERN_SCALAR || set > KERN_AVX512 || !Supported(set,FALSE))
+    return(NW_ERR_BADPARAM);
+
+  fused = !strict && Supported(set,TRUE);
+  switch(set)
+  {
+    case KERN_SCALAR:
+      Kern = &NWKernelsScalar;
+      break;
+    case KERN_SSE2:
+      Kern = &NWKernelsSse2;
+      break;
+#if defined(__x86_64__)
+    case KERN_AVX2:
+      Kern = fused ? &NWKernelsAvx2F : &NWKernelsAvx2;
+      break;
+    case KERN_AVX512:
+      Kern = fused ? &NWKernelsAvx512F : &NWKernelsAvx512;
+      break;
+#endif
+  }
+
+  KernSet    = set;
+  KernStrict = strict;
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   ChooseKernels()
+  Purpose:    This function chooses the set of numeric kernels when the
+              program starts: the widest set the CPU supports, or the one
+              NW_KERNELS names.
+  Parameters: None.
+  Returns:    TRUE.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int ChooseKernels(void)
+{
+  const char *env = getenv("NW_KERNELS"),*end;
+  size_t      len;
+  int         set = KERN_AVX512,strict = FALSE,ix;
+
+#if defined(__x86_64__)
+  __builtin_cpu_init();                 // Runs before the CPU is examined.
+#endif
+
+  for(;env != NULL && *env != '\0';env = *end ? end + 1 : end)
+  {
+    end = strchr(env,',');
+    if(end == NULL)
+      end = env + strlen(env);
+    len = end - env;
+
+    if(len == 6 && strncmp(env,"strict",len) == 0)
+      strict = TRUE;
+    for(ix = KERN_SCALAR;ix <= KERN_AVX512;ix++)
+      if(strlen(KernelNames[ix]) == len &&
+         strncmp(env,KernelNames[ix],len) == 0)
+        set = ix;
+  }
+
+  while(NWSetKernels(set,strict) != NW_SUCCESS)
+    set--;                              // Scalar and SSE2 always succeed.
+
+  return(TRUE);
+}
+
+static int Chosen = ChooseKernels();    // Choose before main() runs.
+
+/*****************************************************************************
+  Function:   NWGetKernels()
+  Purpose:    This function reports the set of numeric kernels in use.
+  Parameters: int *strict               If not NULL, receives TRUE if the
+                                        set is strict.
+  Returns:    The set (KERN_xxx).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+int NWGetKernels(int *strict)
+{
+  if(strict != NULL)
+    *strict = KernStrict;
+  return(KernSet);
+}
+
+/*****************************************************************************
+  Function:   NWKernelName()
+  Purpose:    This function returns the name of a set of numeric kernels,
+              as NW_KERNELS gives it.
+  Parameters: int set                   The set (KERN_xxx).
+  Returns:    The name, or NULL if there is no such set.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+const char *NWKernelName(int set)
+{
+  if(set < KERN_SCALAR || set > KERN_AVX512)
+    return(NULL);
+  return(KernelNames[set]);
+}
+
+/*****************************************************************************
+  Function:   NWDot(), NWAxpy(), NWGemv(), NWGemm(), NWDotF(), NWAxpyF(),
+              NWGemmF(), NWDotQ(), NWSigmoid(), NWSell(), NWSellF()
+  Purpose:    These functions are the numeric kernels (see kernel.cpp); each
+              calls its counterpart in the set in use.
+  Parameters: As the kernels.
+  Returns:    As the kernels.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+double NWDot(const double *x,const double *y,unsigned long n)
+{
+  return(Kern->Dot(x,y,n));
+}
+
+void NWAxpy(unsigned long n,double a,const double *x,double *y)
+{
+  Kern->Axpy(n,a,x,y);
+}
+
+void NWGemv(unsigned long rows,unsigned long cols,const double *w,
+            const double *x,double *y)
+{
+  Kern->Gemv(rows,cols,w,x,y);
+}
+
+void NWGemm(unsigned long rows,unsigned long cols,const double *w,
+            unsigned long num,const double *x,unsigned long ldx,
+            double *y,unsigned long ldy)
+{
+  Kern->Gemm(rows,cols,w,num,x,ldx,y,ldy);
+}
+
+double NWDotF(const float *w,const double *x,unsigned long n,int single)
+{
+  return(Kern->DotF(w,x,n,single));
+}
+
+void NWAxpyF(unsigned long n,double a,const float *x,double *y)
+{
+  Kern->AxpyF(n,a,x,y);
+}
+
+void NWGemmF(unsigned long rows,unsigned long cols,const float *w,
+             unsigned long num,const double *x,unsigned long ldx,
+             double *y,unsigned long ldy,int single)
+{
+  Kern->GemmF(rows,cols,w,num,x,ldx,y,ldy,single);
+}
+
+long NWDotQ(const signed char *x,const signed char *y,unsigned long n)
+{
+  return(Kern->DotQ(x,y,n));
+}
+
+void NWSigmoid(unsigned long n,const double *x,double *y,int mode)
+{
+  Kern->Sigmoid(n,x,y,mode);
+}
+
+void NWSell(unsigned long len,const unsigned int *idx,const double *w,
+            const double *x,double *y)
+{
+  Kern->Sell(len,idx,w,x,y);
+}
+
+void NWSellF(unsigned long len,const unsigned int *idx,const float *w,
+             const double *x,double *y,int single)
+{
+  Kern->SellF(len,idx,w,x,y,single);
+}
@@ -0,0 +1,123 @@
+// Dsconv - convert training data from text to a data set file.
+//
+// Usage: dsconv [-h] inputs outputs datafile
+//
+//   -h  Skip the first two lines of stdin (the network file and number of
+//       iterations), so that the input given to train can be converted as
+//       it stands.
+//
+// Each remaining line of stdin holds a sample, as train reads it: the
+// learning coefficient, then the input values, then the target values,
+// whitespace-separated.  Blank lines are skipped.  The text is read in large
+// chunks, each parsed by a thread per processor.  The samples are written
+// to the data file, which train reads with -d: it is mapped rather than
+// parsed, so that large data sets load in next to no time.
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nwclass.h"
+
+#define CHUNK   (64 << 20)              // Text converted at a time.
+
+int main(int argc, char *argv[])
+{
+  char     *buffer, *last;
+  size_t    space = CHUNK, len = 0, cut, got;
+  unsigned long num_in, num_out, num_rows, width, line = 0, bad, i;
+  int       opt, eof = FALSE, skip = 0;
+  double   *rows;
+  NWDataset data;
+  Network   net;
+  NWErr     nwErr;
+
+  while((opt = getopt(argc, argv, "h")) != -1)
+  {
+    if(opt == 'h')
+    {
+      skip = 2;
+      continue;
+    }
+    optind = argc + 1;
+    break;
+  }
+
+  if(optind != argc - 3)
+  {
+    fprintf(stderr, "Usage: %s [-h] inputs outputs datafile\n", argv[0]);
+    exit(1);
+  }
+
+  num_in = strtoul(argv[optind], NULL, 0);
+  num_out = strtoul(argv[optind + 1], NULL, 0);
+  width = num_in + num_out + 1;
+  buffer = (char *)malloc(space);
+
+  if((nwErr = data.Create(argv[optind + 2], num_in, num_out)) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind + 2], net.ErrMsg(nwErr));
+    exit(1);
+  }
+
+  for(; skip > 0; skip--, line++)       // Skip train's first two lines.
+    while((opt = getchar()) != EOF && opt != '\n')
+      ;
+
+  // Convert the text a chunk of whole lines at a time, the chunk's lines
+  // being parsed in parallel.
+
+  while(!eof || len > 0)
+  {
+    if(!eof)
+    {
+      if((got = fread(buffer + len, 1, space - len, stdin)) == 0)
+        eof = TRUE;
+      len += got;
+    }
+
+    last = (char *)memrchr(buffer, '\n', len);
+    if(last == NULL && !eof)            // Line longer than the buffer.
+    {
+      if(len == space)
+        buffer = (char *)realloc(buffer, space *= 2);
+      continue;
+    }
+    cut = eof || last == NULL ? len : last + 1 - buffer;
+
+    nwErr = NWParseText(buffer, cut, width, 0, &rows, &num_rows, &bad);
+    if(nwErr == NW_ERR_BADFILE)
+      fprintf(stderr, "Badly formatted input at line %lu.\n", line + bad);
+    else if(nwErr != NW_SUCCESS)
+      fprintf(stderr, "%s\n", net.ErrMsg(nwErr));
+    for(i = 0; i < num_rows && nwErr == NW_SUCCESS; i++)
+      if((nwErr = data.Append(rows[i * width], &rows[i * width + 1],
+                              &rows[i * width + 1 + num_in])) != NW_SUCCESS)
+        fprintf(stderr, "%s: %s\n", argv[optind + 2], net.ErrMsg(nwErr));
+    free(rows);
+    if(nwErr != NW_SUCCESS)
+    {
+      data.Close();
+      exit(1);
+    }
+
+    for(last = buffer; (last = (char *)memchr(last, '\n',
+                                               buffer + cut - last)) != NULL;
+        last++)
+      line++;
+    memmove(buffer, buffer + cut, len - cut);
+    len -= cut;
+  }
+
+  num_rows = data.NumRows;
+  if((nwErr = data.Finish()) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind + 2], net.ErrMsg(nwErr));
+    exit(1);
+  }
+
+  fprintf(stdout, "%lu samples.\n", num_rows);
+  return(0);
+}
@@ -1,33 +1,640 @@
-// Exec - perform a single forward-pass on a network.
+// Exec - perform forward passes on a network.
 //
-// First line of stdin is the name of the network file.
-// Remaining lines of stdin are input values.
-// Output is newline-separated list of output values.
+// Usage: exec [-s | -u socket] [-n network] [-b batch-size] [-p precision]
+//             [-f sigmoid]
+//
+// Without -s or -u, a single forward pass is done:
+//   First line of stdin is the name of the network file.
+//   Remaining lines of stdin are input values.
+//   Output is newline-separated list of output values.
+//
+//   -s  Serve records from stdin.  The network is loaded once; each
+//       remaining line of stdin is then a record of input values for the
+//       input units (whitespace-separated, in order of their definition),
+//       and for each record a line of output values (space-separated, in
+//       order of the output units' definition) is written to stdout.  A
+//       record that can't be read gets the line "error" instead, as does
+//       every record of a batch the network can't be run on (a recursive
+//       network, for one).  Blank lines are skipped.  The server runs
+//       until the input ends or it is interrupted (SIGINT or SIGTERM).
+//   -u  Serve records, as for -s, to clients of a UNIX-domain stream socket
+//       created at the given path.  Each connection is served by its own
+//       thread; all of them share the one copy of the network.  The server
+//       runs until interrupted (SIGINT or SIGTERM), and then shuts down the
+//       open connections and waits for their threads to finish.
+//   -n  Name of the network file; if not given, the first line of stdin
+//       names it.
+//   -b  Most records to pass through the network together (default 64).
+//       Records that have already arrived when a batch is started are
+//       run together, up to this number; a lone record is not held back
+//       waiting for others.
+//   -p  Precision of the arithmetic: "double", "single" (single-precision
+//       weights and sums, which halves the memory the weights are read
+//       from), or "mixed" (single-precision weights, double-precision
+//       sums).  The default is the precision the network was saved in.
+//   -f  How to compute the sigmoid function: "exact" (the default, with the
+//       C library's exp()), "poly" (a vectorized polynomial approximation,
+//       within 1e-15), or "table" (an interpolated table, within 3e-6).
+//
+// The numeric kernels are chosen to suit the CPU.  The environment variable
+// NW_KERNELS may name the set to use ("scalar", "sse2", "avx2" or "avx512"),
+// and/or "strict", for arithmetic which gives the same results whichever set
+// is used, separated by commas (see dispatch.cpp).
+//
+// When serving, statistics (throughput, batch sizes, and latency from the
+// arrival of a record to the writing of its result) are written to stderr
+// when the input ends or the server is stopped.
 
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "nwclass.h"
 
-void main(void)
+#define HIST_SIZE   320                 // Latency histogram buckets.
+#define READ_SIZE   65536               // Smallest read from a client.
+
+struct Conn                             // Connection being served.
+{
+  pthread_t       thread;               // Thread serving it.
+  int             fd;                   // Its socket.
+  int             done;                 // TRUE once the thread is done.
+};
+
+struct Stats                            // Serving statistics.
+{
+  pthread_mutex_t lock;
+  double          start;                // Time serving started.
+  double          compute;              // Time spent in Execute().
+  unsigned long   records;              // Records answered.
+  unsigned long   bad;                  // Records that couldn't be read.
+  unsigned long   batches;              // Batches run.
+  double          lat_sum;              // Sum of latencies (seconds).
+  double          lat_max;              // Greatest latency (seconds).
+  unsigned long   hist[HIST_SIZE];      // Latency histogram.
+};
+
+static Network  net;
+static Stats    stats;
+static int      max_batch = 64;
+static int      wake[2] = { -1, -1 };   // Pipe Stop() writes to.
+static pthread_mutex_t conn_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Return a monotonic time in seconds.
+
+static double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+// Map a latency in microseconds to a histogram bucket.  Below 8 us each
+// bucket is 1 us wide; above, each power of two is split into 8 buckets, so
+// a bucket is never more than 12.5% wide.
+
+static int HistIndex(double us)
+{
+  unsigned long v = (unsigned long)us;
+  int           e, ix;
+
+  if(v < 8)
+    return((int)v);
+
+  for(e = 3; (v >> (e + 1)) != 0; e++)
+    ;
+  ix = 8 + (e - 3) * 8 + (int)((v >> (e - 3)) & 7);
+  return(ix < HIST_SIZE ? ix : HIST_SIZE - 1);
+}
+
+// Return the lower bound of a histogram bucket, in microseconds.
+
+static double HistValue(int ix)
+{
+  if(ix < 8)
+    return(ix);
+  return((8 + (ix - 8) % 8) * (double)(1UL << ((ix - 8) / 8)));
+}
+
+// Return the latency (in ms) below which the given fraction of records fell.
+
+static double Percentile(double frac)
+{
+  unsigned long want = (unsigned long)(frac * stats.records), seen = 0;
+  int           ix;
+
+  for(ix = 0; ix < HIST_SIZE; ix++)
+    if((seen += stats.hist[ix]) > want)
+      break;
+  return(HistValue(ix < HIST_SIZE ? ix : HIST_SIZE - 1) / 1000.0);
+}
+
+// Write the serving statistics to stderr.
+
+static void Report(void)
+{
+  double elapsed = Now() - stats.start;
+
+  pthread_mutex_lock(&stats.lock);
+  fprintf(stderr, "exec: %lu records (%lu bad) in %lu batches, "
+          "%.1f records/batch\n", stats.records, stats.bad, stats.batches,
+          stats.batches ? (double)stats.records / stats.batches : 0.0);
+  fprintf(stderr, "exec: %.3f s elapsed, %.1f records/s; "
+          "%.3f s computing, %.1f records/s\n", elapsed,
+          elapsed > 0 ? stats.records / elapsed : 0.0, stats.compute,
+          stats.compute > 0 ? stats.records / stats.compute : 0.0);
+  if(stats.records)
+    fprintf(stderr, "exec: latency mean %.3f ms, p50 %.3f ms, p99 %.3f ms, "
+            "max %.3f ms\n", stats.lat_sum * 1000.0 / stats.records,
+            Percentile(0.50), Percentile(0.99), stats.lat_max * 1000.0);
+  pthread_mutex_unlock(&stats.lock);
+}
+
+// Return the precision (PREC_xxx) with the given name, or -1.
+
+static int Precision(const char *name)
+{
+  if(strcmp(name, "double") == 0)
+    return(PREC_DOUBLE);
+  if(strcmp(name, "single") == 0)
+    return(PREC_SINGLE);
+  if(strcmp(name, "mixed") == 0)
+    return(PREC_MIXED);
+  return(-1);
+}
+
+// Return the way of computing the sigmoid function (SIG_xxx) with the given
+// name, or -1.
+
+static int SigmoidMode(const char *name)
+{
+  if(strcmp(name, "exact") == 0)
+    return(SIG_EXACT);
+  if(strcmp(name, "poly") == 0)
+    return(SIG_POLY);
+  if(strcmp(name, "table") == 0)
+    return(SIG_TABLE);
+  return(-1);
+}
+
+// Wait until data can be read from a descriptor.  Returns FALSE instead if
+// the server has been stopped.  Stop() writes to the wake pipe, which is
+// never drained, so a signal that arrives before poll() is called isn't
+// missed, and every thread waiting sees it.
+
+static int Wait(int fd)
+{
+  struct pollfd pfd[2];
+
+  pfd[0].fd = fd;
+  pfd[0].events = POLLIN;
+  pfd[1].fd = wake[0];
+  pfd[1].events = POLLIN;
+  for(;;)
+  {
+    pfd[0].revents = pfd[1].revents = 0;
+    if(poll(pfd, 2, -1) < 0)
+    {
+      if(errno == EINTR)
+        continue;
+      return(TRUE);                     // Let the read report it.
+    }
+    if(pfd[1].revents)
+      return(FALSE);
+    if(pfd[0].revents)
+      return(TRUE);
+  }
+}
+
+// Return TRUE if data can be read from a descriptor without waiting.
+
+static int Ready(int fd)
+{
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  return(poll(&pfd, 1, 0) > 0);
+}
+
+// Write a whole buffer to a descriptor.  Returns FALSE on error.
+
+static int WriteAll(int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while(len > 0)
+  {
+    if((n = write(fd, buf, len)) < 0)
+    {
+      if(errno == EINTR)
+        continue;
+      return(FALSE);
+    }
+    buf += n;
+    len -= n;
+  }
+  return(TRUE);
+}
+
+// Serve records read from one descriptor, writing results to another, until
+// the input ends.  Records that are waiting are gathered into a batch and
+// passed through the network together.
+
+static void Serve(int in, int out)
+{
+  NWContext ctx;
+  char     *buf = NULL, *obuf = NULL, *end;
+  size_t    pos = 0, len = 0, cap = 0, olen, ocap = 0;
+  ssize_t   n;
+  int       count, nbad, eof = FALSE, done = FALSE, i, j, k;
+  int      *bad;
+  double   *input, *output, *arrive, stamp = 0, start, computed, finish, lat;
+
+  input = (double *)malloc(max_batch * net.NumInput * sizeof(double));
+  output = (double *)malloc(max_batch * net.NumOutput * sizeof(double));
+  arrive = (double *)malloc(max_batch * sizeof(double));
+  bad = (int *)malloc(max_batch * sizeof(int));
+
+  while(!done)
+  {
+    count = 0;
+
+    // Gather a batch: take complete lines already read, and read more
+    // only while the batch is empty or more input is waiting.
+
+    while(count < max_batch)
+    {
+      end = len > pos ? (char *)memchr(buf + pos, '\n', len - pos) : NULL;
+      if(end == NULL && eof && pos < len)
+        end = buf + len;                // Unterminated last line.
+
+      if(end != NULL)
+      {
+        k = NWParseLine(buf + pos, end, net.NumInput,
+                        &input[count * net.NumInput]);
+        pos = end + 1 - buf;
+        if(pos > len)
+          pos = len;
+        if(k < 0)                       // Blank line.
+          continue;
+
+        bad[count] = !k;
+        arrive[count] = stamp;
+        count++;
+        continue;
+      }
+
+      if(eof)
+      {
+        done = TRUE;
+        break;
+      }
+      if(count > 0 && !Ready(in))       // Run what we have.
+        break;
+      if(count == 0 && !Wait(in))       // Stopped.
+      {
+        done = TRUE;
+        break;
+      }
+
+      if(pos > 0)                       // Make room for more.
+      {
+        memmove(buf, buf + pos, len - pos);
+        len -= pos;
+        pos = 0;
+      }
+      if(cap - len < READ_SIZE + 1)
+      {
+        cap = cap * 2 + READ_SIZE + 1;
+        buf = (char *)realloc(buf, cap);
+      }
+
+      if((n = read(in, buf + len, cap - len - 1)) < 0 && errno == EINTR)
+        continue;
+      if(n <= 0)
+        eof = TRUE;
+      else
+        len += n;
+      stamp = Now();
+    }
+
+    if(count == 0)
+      break;
+
+    for(i = 0; i < count; i++)          // Feed zeros for bad records.
+      if(bad[i])
+        memset(&input[i * net.NumInput], 0, net.NumInput * sizeof(double));
+
+    start = Now();
+    if(net.Execute(&ctx, count, input, output) != NW_SUCCESS)
+      for(i = 0; i < count; i++)        // No results for any of them.
+        bad[i] = TRUE;
+    computed = Now();
+
+    for(i = nbad = 0; i < count; i++)
+      nbad += bad[i];
+
+    olen = 0;                           // Format the results.
+    for(i = 0; i < count; i++)
+    {
+      for(j = 0; j <= net.NumOutput; j++)
+      {
+        if(ocap - olen < 512)
+        {
+          ocap = ocap * 2 + 65536;
+          obuf = (char *)realloc(obuf, ocap);
+        }
+
+        if(bad[i])
+        {
+          olen += snprintf(obuf + olen, ocap - olen, "error\n");
+          break;
+        }
+        if(j == net.NumOutput)
+          obuf[olen++] = '\n';
+        else
+          olen += snprintf(obuf + olen, ocap - olen, j ? " %f" : "%f",
+                           output[i * net.NumOutput + j]);
+      }
+    }
+
+    if(!WriteAll(out, obuf, olen))      // Client has gone away.
+      done = TRUE;
+    finish = Now();
+
+    pthread_mutex_lock(&stats.lock);
+    stats.compute += computed - start;
+    stats.records += count;
+    stats.bad += nbad;
+    stats.batches++;
+    for(i = 0; i < count; i++)
+    {
+      lat = finish - arrive[i];
+      stats.lat_sum += lat;
+      if(lat > stats.lat_max)
+        stats.lat_max = lat;
+      stats.hist[HistIndex(lat * 1e6)]++;
+    }
+    pthread_mutex_unlock(&stats.lock);
+  }
+
+  net.FreeContext(&ctx);
+  free(buf);
+  free(obuf);
+  free(input);
+  free(output);
+  free(arrive);
+  free(bad);
+}
+
+// Serve one socket connection.  The socket is closed by Listen(), once the
+// thread has been joined.
+
+static void *ConnMain(void *arg)
+{
+  Conn *conn = (Conn *)arg;
+
+  Serve(conn->fd, conn->fd);
+
+  pthread_mutex_lock(&conn_lock);
+  conn->done = TRUE;
+  pthread_mutex_unlock(&conn_lock);
+  return(NULL);
+}
+
+// Wait for the threads of the given connections to finish, and close their
+// sockets.  If all is FALSE, only threads that are already done are waited
+// for.  Returns the number of connections left.
+
+static int Reap(Conn **conns, int num, int all)
+{
+  int i, left, done;
+
+  for(i = left = 0; i < num; i++)
+  {
+    pthread_mutex_lock(&conn_lock);
+    done = conns[i]->done;
+    pthread_mutex_unlock(&conn_lock);
+
+    if(!all && !done)
+    {
+      conns[left++] = conns[i];
+      continue;
+    }
+
+    pthread_join(conns[i]->thread, NULL);
+    close(conns[i]->fd);
+    delete conns[i];
+  }
+  return(left);
+}
+
+static void Stop(int sig)
+{
+  int     saved = errno;
+  char    c = 0;
+  ssize_t n;
+
+  n = write(wake[1], &c, 1);            // If full, a wake-up is pending.
+  (void)n;
+  errno = saved;
+}
+
+// Arrange for SIGINT and SIGTERM to stop the server.  Returns FALSE on
+// error.
+
+static int Catch(void)
+{
+  struct sigaction sa;
+
+  if(pipe(wake) < 0)
+    return(FALSE);
+  fcntl(wake[1], F_SETFL, fcntl(wake[1], F_GETFL) | O_NONBLOCK);
+
+  memset(&sa, 0, sizeof(sa));           // No SA_RESTART.
+  sa.sa_handler = Stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  return(TRUE);
+}
+
+// Serve clients of a UNIX-domain socket until interrupted.
+
+static int Listen(const char *path)
+{
+  struct sockaddr_un addr;
+  Conn             **conns = NULL, *conn;
+  int                fd, sock, num = 0, cap = 0, i;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(addr.sun_path))
+    { fprintf(stderr, "Socket path too long.\n"); return(1); }
+  strcpy(addr.sun_path, path);
+
+  if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    { perror("socket"); return(1); }
+  unlink(path);
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0)
+    { perror(path); close(fd); return(1); }
+
+  while(Wait(fd))
+  {
+    if((sock = accept(fd, NULL, NULL)) < 0)
+    {
+      if(errno == EINTR || errno == ECONNABORTED)
+        continue;                       // Wait() checks for a stop.
+      perror("accept");
+      break;
+    }
+
+    num = Reap(conns, num, FALSE);      // Clear away finished connections.
+    if(num == cap)
+    {
+      Conn **grown = (Conn **)realloc(conns, (cap * 2 + 16) * sizeof(Conn *));
+
+      if(grown == NULL)
+      {
+        fprintf(stderr, "Out of memory.\n");
+        close(sock);
+        continue;
+      }
+      conns = grown;
+      cap = cap * 2 + 16;
+    }
+
+    if((conn = new Conn) == NULL)
+    {
+      fprintf(stderr, "Out of memory.\n");
+      close(sock);
+      continue;
+    }
+    conn->fd = sock;
+    conn->done = FALSE;
+    if(pthread_create(&conn->thread, NULL, ConnMain, conn) != 0)
+    {
+      fprintf(stderr, "Unable to start thread.\n");
+      close(sock);
+      delete conn;
+      continue;
+    }
+    conns[num++] = conn;
+  }
+
+  close(fd);
+  unlink(path);
+
+  for(i = 0; i < num; i++)              // End the connections still open.
+    shutdown(conns[i]->fd, SHUT_RDWR);
+  Reap(conns, num, TRUE);
+  free(conns);
+  return(0);
+}
+
+// Read the network's filename from the first line of stdin.  In server mode
+// this reads a byte at a time, so that nothing beyond the line is consumed
+// from the descriptor.
+
+static void ReadName(char *name, int size, int raw)
+{
+  int i = 0;
+
+  if(!raw)
+    fgets(name, size, stdin);
+  else
+  {
+    while(i < size - 1 && read(0, &name[i], 1) == 1 && name[i] != '\n')
+      i++;
+    name[i] = '\0';
+  }
+
+  name[strcspn(name, "\r\n")] = '\0';
+}
+
+int main(int argc, char *argv[])
 {
   char    buffer[1027];
-  Network net;
-  int     i;
+  char   *name = NULL, *sock_path = NULL;
+  int     i, serve = FALSE, result = 0, prec = -1, sig = SIG_EXACT;
   double  value;
+  NWErr   nwErr;
+
+  while((i = getopt(argc, argv, "su:n:b:p:f:")) != -1)
+  {
+    if(i == 's')
+      serve = TRUE;
+    else if(i == 'u')
+      sock_path = optarg;
+    else if(i == 'n')
+      name = optarg;
+    else if(i == 'b' && (max_batch = atoi(optarg)) > 0)
+      ;
+    else if(i == 'p' && (prec = Precision(optarg)) >= 0)
+      ;
+    else if(i == 'f' && (sig = SigmoidMode(optarg)) >= 0)
+      ;
+    else
+    {
+      fprintf(stderr,
+              "Usage: %s [-s | -u socket] [-n network] [-b batch-size] "
+              "[-p precision] [-f sigmoid]\n", argv[0]);
+      exit(1);
+    }
+  }
+
+  if(name == NULL)
+  {
+    ReadName(buffer, sizeof(buffer), serve || sock_path != NULL);
+    name = buffer;
+  }
+  if((nwErr = net.Open(name)) != NW_SUCCESS ||
+     (prec >= 0 && (nwErr = net.SetPrecision(prec)) != NW_SUCCESS) ||
+     (nwErr = net.SetSigmoid(sig)) != NW_SUCCESS ||
+     (nwErr = net.SetupExec()) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", name, net.ErrMsg(nwErr));
+    exit(1);
+  }
+
+  if(serve || sock_path != NULL)        // Long-running server.
+  {
+    pthread_mutex_init(&stats.lock, NULL);
+    stats.start = Now();
+    if(!Catch())
+    {
+      perror("pipe");
+      exit(1);
+    }
 
-  fgets(buffer, sizeof(buffer), stdin);
-  net.Open(buffer);
-  net.SetupExec();
+    if(sock_path != NULL)
+      result = Listen(sock_path);
+    else
+      Serve(0, 1);
+
+    Report();
+    return(result);
+  }
 
   for(i = 0; i < net.NumInput; i++)
   {
-    fgets(buffer, sizeof(buffer), stdin);
+    if(fgets(buffer, sizeof(buffer), stdin) == NULL ||
+       NWParseLine(buffer, buffer + strlen(buffer), 1, &value) != 1)
+      value = 0;
 
-    net.SetInput(i, atof(buffer));
+    net.SetInput(i, value);
   }
 
   net.ForwardPass();
@@ -37,5 +644,6 @@ void main(void)
     net.ReadOutput(net.NumUnits - net.NumOutput + i, &value);
     fprintf(stdout, "%f\n", value);
   }
-}
 
+  return(0);
+}
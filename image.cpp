@@ -0,0 +1,1276 @@
+/*****************************************************************************
+  File:     image.cpp
+
+  Purpose:  This file contains the network object's code for network
+            images: the file format in which networks are saved.  An image
+            holds the network's compact layout, and is mapped or read in
+            bulk rather than unit by unit.  It also contains the code for
+            weight files, which hold only a network's weights.
+
+  An image is the same on every machine.  All values are fixed-width and
+  little-endian (integers are 64 bits unless noted, reals are IEEE doubles),
+  and all padding is explicit.  The header (NWImageHdr) gives the offset of
+  each section; the sections are aligned to IMAGE_ALIGN bytes, and are, in
+  order:
+
+    Units         NWImageUnit[NumUnits]     Coordinates, type, flags, range.
+    RowStart      integer[NumUnits+1]
+    SrcIdx        integer[NumConn]
+    Wgt           double[NumConn]           Floats (IEEE single) if the
+    BiasWgts      double[NumUnits]          header has IMAGE_SINGLE.
+    ExecSeq       integer[NumUnits]         Absent (offset 0) if the network
+                                            had no processing order when
+                                            saved (it was recursive).
+    Names         Names of the input and output units, each terminated by
+                  a NULL, running to the end of the file.
+
+  On a little-endian machine with 64-bit unsigned longs -- the usual case --
+  the sections are already laid out just as the network lays them out in
+  memory.  There the file is mapped copy-on-write, and the layout arrays
+  point straight into the mapping, so opening an image costs only the unit
+  records, and pages which are only read are shared by every process using
+  the file.  Weights which are changed (by training) are copied as they are
+  written; the file itself is never changed through the mapping.  On any
+  other machine the file is read into memory in a single transfer and its
+  sections are converted in place.  Either way the image is released when
+  the network is closed, or when its layout is thawed to change its shape.
+
+  A network saved in single or mixed precision (see SetPrecision()) is
+  written with its weights in single precision, which halves their size;
+  the header's flags record the precision, which the network takes up again
+  when the image is opened.  The single-precision weights are then used in
+  place from the image, as WgtF, and Wgt is filled from them.
+
+  The connection lists are trusted: they are not checked when the image is
+  opened, as that would mean reading every page of them.
+
+  A weight file is a log of checkpoints of a network's weights, encoded as
+  an image is.  It begins with a header (NWWeightHdr) identifying the
+  network by a checksum of its shape (its connection lists), and holds a
+  series of records, each a header (NWWeightRec) followed by 64-bit words.
+  The weights are numbered in a single sequence: those of Wgt, then those
+  of BiasWgts.  The first record is a full one, holding every weight in
+  order; those after it are deltas, each holding the weights which changed
+  since the record before it, as runs (the number of the first weight, the
+  number of weights, then the weights).  Each record has a checksum, so
+  that a record left incomplete (by a crash while it was being appended) is
+  recognized, and the log is taken to end before it.  Weight files always
+  hold the weights of Wgt, in double precision, whatever the network's
+  precision.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nwclass.h"
+
+#define IMAGE_VERSION 1                 // Version of the image format.
+#define IMAGE_ALIGN   64                // Alignment of image sections.
+#define IMAGE_SINGLE  0x01              // Weights are single precision.
+#define IMAGE_MIXED   0x02              // Sums are double (PREC_MIXED).
+
+#define WEIGHT_VERSION 1                // Version of the weight file format.
+#define WREC_FULL     1                 // Record holding every weight.
+#define WREC_DELTA    2                 // Record holding changed weights.
+#define WREC_GAP      2                 // Unchanged weights a run may span.
+
+#define SUM_INIT      2166136261U       // Initial checksum (FNV-1a).
+
+#define ALIGN(n)    (((n) + IMAGE_ALIGN - 1) & ~(uint64_t)(IMAGE_ALIGN - 1))
+
+// Where the sections of an image match this machine's own arrays, NATIVE
+//   is defined.
+
+#if defined(NW_LSBFIRST) && ULONG_MAX == 0xFFFFFFFFFFFFFFFF
+#define NATIVE
+#endif
+
+struct NWImageHdr                       // Header of an image (256 bytes).
+{
+  char            Magic[4];             // Magic number ("NWIM").  The first
+                                        //   two bytes match those of the
+                                        //   original format's.
+  uint32_t        Version;              // Format version (IMAGE_VERSION).
+  uint32_t        Flags;                // Image flags (IMAGE_xxx).
+  uint32_t        _Pad;                 // Reserved -- set to 0.
+  uint64_t        Size;                 // Size of file.
+  uint64_t        NumUnits;             // Number of processing units.
+  uint64_t        NumConn;              // Number of interconnections.
+  uint64_t        NumInput;             // Number of input units.
+  uint64_t        NumOutput;            // Number of output units.
+
+// Offsets of the sections, from the start of the file.
+
+  uint64_t        Units;                // Unit records.
+  uint64_t        RowStart;             // Start of each unit's inputs.
+  uint64_t        SrcIdx;               // Input units of all units.
+  uint64_t        Wgt;                  // Input weights of all units.
+  uint64_t        BiasWgts;             // Bias weights.
+  uint64_t        ExecSeq;              // Processing order (or 0).
+  uint64_t        Names;                // Unit names.
+  char            _Rsvd[144];           // Reserved -- set to 0.
+};
+
+struct NWImageUnit                      // Unit record in an image (48 bytes).
+{
+  uint64_t        X,Y;                  // Unit's coordinates.
+  uint64_t        Min,Max;              // Input/output range (doubles).
+  uint64_t        Name;                 // If an input or output unit, offset
+                                        //   of name within the names.
+  uint8_t         Type;                 // Type -- input, internal, or output.
+  uint8_t         Binary;               // If TRUE, unit is binary.
+  uint8_t         Bias;                 // If TRUE, unit has bias input.
+  uint8_t         Sigmoid;              // If output unit & TRUE, uses sigmoid.
+  uint8_t         _Pad[4];              // Reserved -- set to 0.
+};
+
+struct NWWeightHdr                      // Header of a weight file (64 bytes).
+{
+  char            Magic[4];             // Magic number ("NWWT").
+  uint32_t        Version;              // Format version (WEIGHT_VERSION).
+  uint32_t        Flags;                // Reserved -- set to 0.
+  uint32_t        Shape;                // Checksum of network's shape.
+  uint64_t        NumUnits;             // Number of processing units.
+  uint64_t        NumConn;              // Number of interconnections.
+  char            _Rsvd[32];            // Reserved -- set to 0.
+};
+
+struct NWWeightRec                      // Header of a weight record.
+{
+  uint32_t        Type;                 // WREC_FULL or WREC_DELTA.
+  uint32_t        Sum;                  // Checksum of type, length, and words.
+  uint64_t        Length;               // Number of words which follow.
+};
+
+struct NWWeightLog                      // Weights last written to a file.
+{
+  char            Path[PATH_MAX + 1];   // The file.
+  unsigned long   Num;                  // Number of weights.
+  double         *Base;                 // The weights, as written.
+};
+
+/*****************************************************************************
+  Function:   SwapHdr()
+  Purpose:    This function converts the fields of an image header between
+              little-endian and this machine's byte order (either way).
+  Parameters: NWImageHdr *hdr           The header.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void SwapHdr(NWImageHdr *hdr)
+{
+  hdr->Version   = NW_LE32(hdr->Version);
+  hdr->Flags     = NW_LE32(hdr->Flags);
+  hdr->Size      = NW_LE64(hdr->Size);
+  hdr->NumUnits  = NW_LE64(hdr->NumUnits);
+  hdr->NumConn   = NW_LE64(hdr->NumConn);
+  hdr->NumInput  = NW_LE64(hdr->NumInput);
+  hdr->NumOutput = NW_LE64(hdr->NumOutput);
+  hdr->Units     = NW_LE64(hdr->Units);
+  hdr->RowStart  = NW_LE64(hdr->RowStart);
+  hdr->SrcIdx    = NW_LE64(hdr->SrcIdx);
+  hdr->Wgt       = NW_LE64(hdr->Wgt);
+  hdr->BiasWgts  = NW_LE64(hdr->BiasWgts);
+  hdr->ExecSeq   = NW_LE64(hdr->ExecSeq);
+  hdr->Names     = NW_LE64(hdr->Names);
+}
+
+/*****************************************************************************
+  Function:   GetReal()
+  Purpose:    This function converts a double from its image form.
+  Parameters: uint64_t bits             The double, as stored.
+  Returns:    Its value.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static double GetReal(uint64_t bits)
+{
+  double          value;
+
+  bits = NW_LE64(bits);
+  memcpy(&value,&bits,sizeof(double));
+  return(value);
+}
+
+/*****************************************************************************
+  Function:   PutReal()
+  Purpose:    This function converts a double to its image form.
+  Parameters: double value              The value.
+  Returns:    The double, as stored.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static uint64_t PutReal(double value)
+{
+  uint64_t        bits;
+
+  memcpy(&bits,&value,sizeof(double));
+  return(NW_LE64(bits));
+}
+
+/*****************************************************************************
+  Function:   AddSum()
+  Purpose:    This function adds a 64-bit word to a checksum (FNV-1a, a half
+              word at a time).
+  Parameters: uint32_t sum              The checksum so far.
+              uint64_t word             The word, in this machine's order.
+  Returns:    The new checksum.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static inline uint32_t AddSum(uint32_t sum,uint64_t word)
+{
+  sum = (sum ^ (uint32_t)word) * 16777619U;
+  return((sum ^ (uint32_t)(word >> 32)) * 16777619U);
+}
+
+/*****************************************************************************
+  Function:   Bits()
+  Purpose:    This function returns the bits of a double.
+  Parameters: double value              The value.
+  Returns:    Its bits, as a 64-bit word in this machine's order.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static inline uint64_t Bits(double value)
+{
+  uint64_t        bits;
+
+  memcpy(&bits,&value,sizeof(double));
+  return(bits);
+}
+
+/*****************************************************************************
+  Function:   FromBits()
+  Purpose:    This function returns the double with the given bits.
+  Parameters: uint64_t bits             The bits, in this machine's order.
+  Returns:    The value.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static inline double FromBits(uint64_t bits)
+{
+  double          value;
+
+  memcpy(&value,&bits,sizeof(double));
+  return(value);
+}
+
+/*****************************************************************************
+  Function:   Weight()
+  Purpose:    This function returns one of a network's weights, numbered as
+              in a weight file.
+  Parameters: const double *wgt         Interconnection weights.
+              const double *bias        Bias weights.
+              unsigned long conn        Number of interconnection weights.
+              unsigned long ix          Number of the weight.
+  Returns:    The weight.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static inline double Weight(const double *wgt,const double *bias,
+                            unsigned long conn,unsigned long ix)
+{
+  return(ix < conn ? wgt[ix] : bias[ix - conn]);
+}
+
+/*****************************************************************************
+  Function:   NextRun()
+  Purpose:    This function finds the next run of weights which differ from
+              those last written.  A run may span up to WREC_GAP unchanged
+              weights, as that takes no more room than starting a new run.
+  Parameters: const double *wgt         Interconnection weights.
+              const double *bias        Bias weights.
+              unsigned long conn        Number of interconnection weights.
+              unsigned long num         Number of weights in all.
+              const double *base        Weights last written.
+              unsigned long *pos        Weight to start looking at; receives
+                                        the first weight of the run.
+              unsigned long *count      Receives the number of weights in
+                                        the run.
+  Returns:    TRUE if a run was found.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int NextRun(const double *wgt,const double *bias,unsigned long conn,
+                   unsigned long num,const double *base,unsigned long *pos,
+                   unsigned long *count)
+{
+  unsigned long   ix,last;
+
+  for(ix = *pos;ix < num;ix++)
+    if(Bits(Weight(wgt,bias,conn,ix)) != Bits(base[ix]))
+      break;
+  if(ix == num)                         // No more changes.
+    return(FALSE);
+
+  *pos = last = ix;
+  for(ix++;ix < num && ix <= last + WREC_GAP + 1;ix++)
+    if(Bits(Weight(wgt,bias,conn,ix)) != Bits(base[ix]))
+      last = ix;
+
+  *count = last - *pos + 1;
+  return(TRUE);
+}
+
+/*****************************************************************************
+  Function:   ShapeSum()
+  Purpose:    This function computes the checksum of a network's shape: the
+              number of units and their connection lists.
+  Parameters: unsigned long num         Number of units.
+              const unsigned long *row  RowStart array.
+              const unsigned long *src  SrcIdx array.
+  Returns:    The checksum.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static uint32_t ShapeSum(unsigned long num,const unsigned long *row,
+                         const unsigned long *src)
+{
+  uint32_t        sum = AddSum(SUM_INIT,num);
+  unsigned long   ix;
+
+  for(ix = 0;ix <= num;ix++)
+    sum = AddSum(sum,row[ix]);
+  for(ix = 0;ix < row[num];ix++)
+    sum = AddSum(sum,src[ix]);
+
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   InSection()
+  Purpose:    This function checks that a section lies within an image and
+              is properly aligned.
+  Parameters: NWImageHdr *hdr           The image's header.
+              uint64_t off              Offset of the section.
+              uint64_t num              Number of elements in the section.
+              uint64_t size             Size of each element.
+  Returns:    TRUE if the section is sound.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int InSection(NWImageHdr *hdr,uint64_t off,uint64_t num,uint64_t size)
+{
+  return(off % IMAGE_ALIGN == 0 && off >= sizeof(NWImageHdr) &&
+         off <= hdr->Size && num <= (hdr->Size - off) / size);
+}
+
+#ifndef NATIVE
+/*****************************************************************************
+  Function:   GetWords()
+  Purpose:    This function converts an array of integers from their image
+              form to unsigned longs, in place.
+  Parameters: void *sec                 The array.
+              uint64_t num              Number of integers.
+  Returns:    TRUE if every value fits in an unsigned long.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int GetWords(void *sec,uint64_t num)
+{
+  unsigned long  *dst = (unsigned long *)sec;
+  uint64_t        ix,value;
+
+  for(ix = 0;ix < num;ix++)             // Never overtakes the source.
+  {
+    memcpy(&value,(char *)sec + ix * sizeof(uint64_t),sizeof(uint64_t));
+    value = NW_LE64(value);
+    if(value > ULONG_MAX)
+      return(FALSE);
+    dst[ix] = (unsigned long)value;
+  }
+
+  return(TRUE);
+}
+
+/*****************************************************************************
+  Function:   GetReals()
+  Purpose:    This function converts an array of doubles from their image
+              form, in place.
+  Parameters: void *sec                 The array.
+              uint64_t num              Number of doubles.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void GetReals(void *sec,uint64_t num)
+{
+  uint64_t       *src = (uint64_t *)sec;
+  double         *dst = (double *)sec;
+  uint64_t        ix;
+
+  for(ix = 0;ix < num;ix++)
+    dst[ix] = GetReal(src[ix]);
+}
+
+/*****************************************************************************
+  Function:   GetFloats()
+  Purpose:    This function converts an array of floats from their image
+              form, in place.
+  Parameters: void *sec                 The array.
+              uint64_t num              Number of floats.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void GetFloats(void *sec,uint64_t num)
+{
+  uint32_t       *src = (uint32_t *)sec;
+  uint64_t        ix;
+
+  for(ix = 0;ix < num;ix++)
+    src[ix] = NW_LE32(src[ix]);
+}
+#endif
+
+/*****************************************************************************
+  Function:   PutWords()
+  Purpose:    This function writes an array of unsigned longs to an image.
+  Parameters: FILE *handle              File to write to.
+              const unsigned long *data The array.
+              unsigned long num         Number of elements.
+  Returns:    TRUE on success.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int PutWords(FILE *handle,const unsigned long *data,unsigned long num)
+{
+#ifdef NATIVE
+  return(num == 0 || fwrite(data,sizeof(unsigned long),num,handle) == num);
+#else
+  uint64_t        buf[1024];
+  unsigned long   ix,jx,cnt;
+
+  for(ix = 0;ix < num;ix += cnt)
+  {
+    cnt = num - ix < 1024 ? num - ix : 1024;
+    for(jx = 0;jx < cnt;jx++)
+      buf[jx] = NW_LE64((uint64_t)data[ix + jx]);
+    if(fwrite(buf,sizeof(uint64_t),cnt,handle) < cnt)
+      return(FALSE);
+  }
+
+  return(TRUE);
+#endif
+}
+
+/*****************************************************************************
+  Function:   PutReals()
+  Purpose:    This function writes an array of doubles to an image.
+  Parameters: FILE *handle              File to write to.
+              const double *data        The array.
+              unsigned long num         Number of elements.
+  Returns:    TRUE on success.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int PutReals(FILE *handle,const double *data,unsigned long num)
+{
+#ifdef NATIVE
+  return(num == 0 || fwrite(data,sizeof(double),num,handle) == num);
+#else
+  uint64_t        buf[1024];
+  unsigned long   ix,jx,cnt;
+
+  for(ix = 0;ix < num;ix += cnt)
+  {
+    cnt = num - ix < 1024 ? num - ix : 1024;
+    for(jx = 0;jx < cnt;jx++)
+      buf[jx] = PutReal(data[ix + jx]);
+    if(fwrite(buf,sizeof(uint64_t),cnt,handle) < cnt)
+      return(FALSE);
+  }
+
+  return(TRUE);
+#endif
+}
+
+/*****************************************************************************
+  Function:   PutFloats()
+  Purpose:    This function writes an array of doubles to an image as
+              floats.
+  Parameters: FILE *handle              File to write to.
+              const double *data        The array.
+              unsigned long num         Number of elements.
+  Returns:    TRUE on success.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int PutFloats(FILE *handle,const double *data,unsigned long num)
+{
+  uint32_t        buf[1024];
+  unsigned long   ix,jx,cnt;
+  float           value;
+
+  for(ix = 0;ix < num;ix += cnt)
+  {
+    cnt = num - ix < 1024 ? num - ix : 1024;
+    for(jx = 0;jx < cnt;jx++)
+    {
+      value = (float)data[ix + jx];
+      memcpy(&buf[jx],&value,sizeof(float));
+      buf[jx] = NW_LE32(buf[jx]);
+    }
+    if(fwrite(buf,sizeof(uint32_t),cnt,handle) < cnt)
+      return(FALSE);
+  }
+
+  return(TRUE);
+}
+
+/*****************************************************************************
+  Function:   PadTo()
+  Purpose:    This function pads an image with zeros up to the offset of
+              the next section.
+  Parameters: FILE *handle              File to write to.
+              uint64_t *pos             Current position; updated.
+              uint64_t off              Offset of the section.
+  Returns:    TRUE on success.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int PadTo(FILE *handle,uint64_t *pos,uint64_t off)
+{
+  static const char zero[IMAGE_ALIGN] = {0};
+
+  if(off - *pos > sizeof(zero) ||
+     fwrite(zero,1,off - *pos,handle) < off - *pos)
+    return(FALSE);
+
+  *pos = off;
+  return(TRUE);
+}
+
+/*****************************************************************************
+  Function:   Network::OpenImage()
+  Purpose:    This function opens an image file and sets the network up from
+              it, frozen, with its compact layout in the image (unless the
+              network is recursive, in which case it is left thawed).  It is
+              called by Open(), which has recognized the magic number.
+  Parameters: FILE *handle              The open file.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::OpenImage(FILE *handle)
+{
+  struct stat     st;
+  NWImageHdr      hdr;
+  char           *base,*names;
+  uint64_t        len;
+  unsigned long   ix,num,conn,num_in = 0,num_out = 0;
+  unsigned long  *row,*seq = NULL;
+  uint64_t        wsize;
+  float          *wgt;
+  NWImageUnit    *rec;
+  NWUnit        **units;
+  NWErr           nwErr;
+
+  rewind(handle);
+  if(fread(&hdr,1,sizeof(NWImageHdr),handle) < sizeof(NWImageHdr))
+    return(NW_ERR_READING);
+  SwapHdr(&hdr);
+
+  if(hdr.Version != IMAGE_VERSION ||
+     (hdr.Flags & ~(IMAGE_SINGLE | IMAGE_MIXED)) != 0 ||
+     hdr.Flags == IMAGE_MIXED)
+    return(NW_ERR_BADFILE);             // Written by a later version.
+  wsize = (hdr.Flags & IMAGE_SINGLE) ? sizeof(uint32_t) : sizeof(uint64_t);
+  if(fstat(fileno(handle),&st) != 0)
+    return(NW_ERR_READING);
+  if((uint64_t)st.st_size < hdr.Size || hdr.Size > (size_t)-1)
+    return(NW_ERR_BADFILE);             // File is truncated.
+
+  num  = hdr.NumUnits;
+  conn = hdr.NumConn;
+  if(num != hdr.NumUnits || conn != hdr.NumConn ||
+     hdr.NumInput > num || hdr.NumOutput > num ||
+     !InSection(&hdr,hdr.Units,num,sizeof(NWImageUnit)) ||
+     !InSection(&hdr,hdr.RowStart,(uint64_t)num + 1,sizeof(uint64_t)) ||
+     !InSection(&hdr,hdr.SrcIdx,conn,sizeof(uint64_t)) ||
+     !InSection(&hdr,hdr.Wgt,conn,wsize) ||
+     !InSection(&hdr,hdr.BiasWgts,num,wsize) ||
+     (hdr.ExecSeq != 0 && !InSection(&hdr,hdr.ExecSeq,num,sizeof(uint64_t))) ||
+     !InSection(&hdr,hdr.Names,0,1))
+    return(NW_ERR_BADFILE);
+
+  if(num == 0)                          // Empty network.
+  {
+    if((UnitList = new NWUnit *[512]) == NULL)
+      return(NW_ERR_MEMORY);
+    memset(UnitList,0,512 * sizeof(NWUnit *));
+    UnitSpace = 512;
+    return(NW_SUCCESS);
+  }
+
+#ifdef NATIVE
+  base = (char *)mmap(NULL,hdr.Size,PROT_READ | PROT_WRITE,MAP_PRIVATE,
+                      fileno(handle),0);
+  if(base == (char *)MAP_FAILED)
+    return(NW_ERR_READING);
+  ImageMapped = TRUE;
+#else
+  if((base = (char *)malloc(hdr.Size)) == NULL)
+    return(NW_ERR_MEMORY);
+  rewind(handle);
+  if(fread(base,1,hdr.Size,handle) < hdr.Size)
+  {
+    free(base);
+    return(NW_ERR_READING);
+  }
+  ImageMapped = FALSE;
+#endif
+
+  Image     = base;
+  ImageSize = hdr.Size;
+
+#ifndef NATIVE                          // Convert the sections.
+  if(!GetWords(base + hdr.RowStart,(uint64_t)num + 1) ||
+     !GetWords(base + hdr.SrcIdx,conn) ||
+     (hdr.ExecSeq != 0 && !GetWords(base + hdr.ExecSeq,num)))
+  {
+    FreeImage();
+    return(NW_ERR_BADFILE);
+  }
+  if(hdr.Flags & IMAGE_SINGLE)
+  {
+    GetFloats(base + hdr.Wgt,conn);
+    GetFloats(base + hdr.BiasWgts,num);
+  }
+  else
+  {
+    GetReals(base + hdr.Wgt,conn);
+    GetReals(base + hdr.BiasWgts,num);
+  }
+#endif
+
+// Check the unit-level structure of the layout.
+
+  rec   = (NWImageUnit *)(base + hdr.Units);
+  row   = (unsigned long *)(base + hdr.RowStart);
+  names = base + hdr.Names;
+  len   = hdr.Size - hdr.Names;
+  if(hdr.ExecSeq != 0)
+    seq = (unsigned long *)(base + hdr.ExecSeq);
+
+  nwErr = row[0] == 0 && row[num] == conn ? NW_SUCCESS : NW_ERR_BADFILE;
+  for(ix = 0;ix < num && nwErr == NW_SUCCESS;ix++)
+  {
+    if(row[ix + 1] < row[ix] || (seq != NULL && seq[ix] >= num) ||
+       rec[ix].Type > UNIT_OUTPUT)
+      nwErr = NW_ERR_BADFILE;
+    else if(rec[ix].Type != UNIT_INTERNAL &&
+            (NW_LE64(rec[ix].Name) >= len ||
+             memchr(names + NW_LE64(rec[ix].Name),'\0',len - NW_LE64(rec[ix].Name)) == NULL))
+      nwErr = NW_ERR_BADFILE;
+    else if(rec[ix].Type == UNIT_INPUT)
+      num_in++;
+    else if(rec[ix].Type == UNIT_OUTPUT)
+      num_out++;
+  }
+  if(num_in != hdr.NumInput || num_out != hdr.NumOutput)
+    nwErr = NW_ERR_BADFILE;
+
+  if(nwErr != NW_SUCCESS)
+  {
+    FreeImage();
+    return(nwErr);
+  }
+
+  RowStart = row;
+  SrcIdx   = (unsigned long *)(base + hdr.SrcIdx);
+  ExecSeq  = seq;
+  Frozen   = TRUE;
+
+  if(hdr.Flags & IMAGE_SINGLE)          // Widen the weights; the passes use
+  {                                     //   the image's own.
+    Precision = (hdr.Flags & IMAGE_MIXED) ? PREC_MIXED : PREC_SINGLE;
+    WgtF = (float *)(base + hdr.Wgt);
+    wgt  = (float *)(base + hdr.BiasWgts);
+    if((Wgt = new double[conn + 1]) == NULL ||
+       (BiasWgts = new double[num]) == NULL)
+    {
+      Close();
+      return(NW_ERR_MEMORY);
+    }
+    for(ix = 0;ix < conn;ix++)
+      Wgt[ix] = WgtF[ix];
+    for(ix = 0;ix < num;ix++)
+      BiasWgts[ix] = wgt[ix];
+  }
+  else
+  {
+    Precision = PREC_DOUBLE;
+    Wgt       = (double *)(base + hdr.Wgt);
+    BiasWgts  = (double *)(base + hdr.BiasWgts);
+  }
+
+// Build the unit list.  The units' input lists point into the layout, as
+//   they do in any frozen network.
+
+  if((units = new NWUnit *[num + 512]) == NULL)
+  {
+    Close();
+    return(NW_ERR_MEMORY);
+  }
+  memset(units,0,(num + 512) * sizeof(NWUnit *));
+  UnitList  = units;
+  NumUnits  = num;
+  UnitSpace = num + 512;                // Room for 512 extra units.
+  NumInput  = num_in;
+  NumOutput = num_out;
+
+  for(ix = 0;ix < num;ix++)
+  {
+    if((units[ix] = new NWUnit) == NULL)
+    {
+      Close();
+      return(NW_ERR_MEMORY);
+    }
+    memset(units[ix],0,sizeof(NWUnit));
+
+    units[ix]->X          = NW_LE64(rec[ix].X);
+    units[ix]->Y          = NW_LE64(rec[ix].Y);
+    units[ix]->NumInput   = row[ix + 1] - row[ix];
+    units[ix]->Type       = rec[ix].Type;
+    units[ix]->Binary     = rec[ix].Binary;
+    units[ix]->Bias       = rec[ix].Bias;
+    units[ix]->Sigmoid    = rec[ix].Sigmoid;
+    units[ix]->BiasWgt    = BiasWgts[ix];
+    units[ix]->InputUnits = &SrcIdx[row[ix]];
+    units[ix]->InputWgts  = &Wgt[row[ix]];
+
+    if(rec[ix].Type != UNIT_INTERNAL)   // Input/output unit.
+    {
+      char *name = names + NW_LE64(rec[ix].Name);
+
+      if((units[ix]->IODef = new NWIODef) == NULL ||
+         (units[ix]->IODef->Name = new char[strlen(name) + 1]) == NULL)
+      {
+        Close();
+        return(NW_ERR_MEMORY);
+      }
+      strcpy(units[ix]->IODef->Name,name);
+      units[ix]->IODef->Min = GetReal(rec[ix].Min);
+      units[ix]->IODef->Max = GetReal(rec[ix].Max);
+    }
+  }
+
+// Fill in the rest of the layout, which is derived from the units.
+
+  if((UnitFlags = new unsigned char[num]) == NULL ||
+     (IOMin = new double[num]) == NULL ||
+     (IOMax = new double[num]) == NULL ||
+     (OutputUnits = new unsigned long[num_out + 1]) == NULL)
+  {
+    Close();
+    return(NW_ERR_MEMORY);
+  }
+  for(ix = num_out = 0;ix < num;ix++)
+    GatherUnit(ix,&num_out);
+
+  if(seq == NULL && (nwErr = BuildPlan()) != NW_SUCCESS)
+  {
+    if(nwErr == NW_ERR_RECURSIVE &&     // Leave a recursive network thawed.
+       (nwErr = Thaw()) == NW_SUCCESS)
+      return(NW_SUCCESS);
+    Close();
+    return(nwErr);
+  }
+
+  if((nwErr = FindLayers()) != NW_SUCCESS)
+  {
+    Close();
+    return(nwErr);
+  }
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::WriteImage()
+  Purpose:    This function writes the network to a file as an image.  The
+              network need not be frozen.  The processing order is written
+              if it can be computed.
+  Parameters: FILE *handle              File to write to, positioned at its
+                                        start.
+              const double *wgt         If not NULL, weights to write in
+                                        place of Wgt (the network must be
+                                        frozen).
+              const double *bias        If not NULL, bias weights to write
+                                        in place of BiasWgts.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::WriteImage(FILE *handle,const double *wgt,const double *bias)
+{
+  NWImageHdr      hdr;
+  NWImageUnit     rec[256];
+  unsigned long   row[1024];
+  double          buf[1024];
+  NWUnit         *cur;
+  unsigned long   ix,jx,cnt,conn,start,name;
+  uint64_t        pos,wsize;
+  int             ok,single = Precision != PREC_DOUBLE;
+
+  if(ExecSeq == NULL)                   // No order if it is recursive.
+    BuildPlan();
+  if(wgt == NULL)
+    wgt = Wgt;
+  if(bias == NULL)
+    bias = BiasWgts;
+
+  for(ix = conn = 0;ix < NumUnits;ix++)
+    conn += UnitList[ix]->NumInput;
+
+// Lay out the sections.
+
+  memset(&hdr,0,sizeof(NWImageHdr));
+  memcpy(hdr.Magic,"NWIM",4);
+  hdr.Version   = IMAGE_VERSION;
+  if(single)
+    hdr.Flags   = IMAGE_SINGLE | (Precision == PREC_MIXED ? IMAGE_MIXED : 0);
+  hdr.NumUnits  = NumUnits;
+  hdr.NumConn   = conn;
+  hdr.NumInput  = NumInput;
+  hdr.NumOutput = NumOutput;
+  hdr.Units     = ALIGN(sizeof(NWImageHdr));
+  hdr.RowStart  = ALIGN(hdr.Units + hdr.NumUnits * sizeof(NWImageUnit));
+  hdr.SrcIdx    = ALIGN(hdr.RowStart + (hdr.NumUnits + 1) * sizeof(uint64_t));
+  hdr.Wgt       = ALIGN(hdr.SrcIdx + hdr.NumConn * sizeof(uint64_t));
+  wsize         = single ? sizeof(uint32_t) : sizeof(uint64_t);
+  hdr.BiasWgts  = ALIGN(hdr.Wgt + hdr.NumConn * wsize);
+  hdr.Names     = ALIGN(hdr.BiasWgts + hdr.NumUnits * wsize);
+  if(ExecSeq != NULL)
+  {
+    hdr.ExecSeq = hdr.Names;
+    hdr.Names   = ALIGN(hdr.ExecSeq + hdr.NumUnits * sizeof(uint64_t));
+  }
+
+  for(ix = 0,hdr.Size = hdr.Names;ix < NumUnits;ix++)
+    if(UnitList[ix]->IODef != NULL)
+      hdr.Size += strlen(UnitList[ix]->IODef->Name) + 1;
+
+  SwapHdr(&hdr);
+  ok = fwrite(&hdr,1,sizeof(NWImageHdr),handle) == sizeof(NWImageHdr);
+  SwapHdr(&hdr);
+  pos = sizeof(NWImageHdr);
+
+  ok = ok && PadTo(handle,&pos,hdr.Units);
+  for(ix = name = 0;ok && ix < NumUnits;ix += cnt)  // Unit records.
+  {
+    cnt = NumUnits - ix < 256 ? NumUnits - ix : 256;
+    memset(rec,0,cnt * sizeof(NWImageUnit));
+
+    for(jx = 0;jx < cnt;jx++)
+    {
+      cur = UnitList[ix + jx];
+      rec[jx].X       = NW_LE64((uint64_t)cur->X);
+      rec[jx].Y       = NW_LE64((uint64_t)cur->Y);
+      rec[jx].Type    = cur->Type;
+      rec[jx].Binary  = cur->Binary;
+      rec[jx].Bias    = cur->Bias;
+      rec[jx].Sigmoid = cur->Sigmoid;
+      if(cur->IODef != NULL)
+      {
+        rec[jx].Min  = PutReal(cur->IODef->Min);
+        rec[jx].Max  = PutReal(cur->IODef->Max);
+        rec[jx].Name = NW_LE64((uint64_t)name);
+        name += strlen(cur->IODef->Name) + 1;
+      }
+    }
+
+    ok = fwrite(rec,sizeof(NWImageUnit),cnt,handle) == cnt;
+  }
+  pos += hdr.NumUnits * sizeof(NWImageUnit);
+
+  ok = ok && PadTo(handle,&pos,hdr.RowStart);
+  for(ix = 0,row[0] = start = 0,cnt = 1;ok && ix < NumUnits;ix++)
+  {
+    if(cnt == 1024)                     // Row starts, a buffer at a time.
+    {
+      ok = PutWords(handle,row,cnt);
+      cnt = 0;
+    }
+    start += UnitList[ix]->NumInput;
+    row[cnt++] = start;
+  }
+  ok = ok && PutWords(handle,row,cnt);
+  pos += (hdr.NumUnits + 1) * sizeof(uint64_t);
+
+  ok = ok && PadTo(handle,&pos,hdr.SrcIdx);
+  if(Frozen)                            // Input lists, all at once.
+    ok = ok && PutWords(handle,SrcIdx,conn);
+  else
+    for(ix = 0;ok && ix < NumUnits;ix++)
+      ok = PutWords(handle,UnitList[ix]->InputUnits,UnitList[ix]->NumInput);
+  pos += hdr.NumConn * sizeof(uint64_t);
+
+  ok = ok && PadTo(handle,&pos,hdr.Wgt);
+  if(Frozen)
+    ok = ok && (single ? PutFloats(handle,wgt,conn) :
+                         PutReals(handle,wgt,conn));
+  else
+    for(ix = 0;ok && ix < NumUnits;ix++)
+    {
+      cur = UnitList[ix];
+      ok = single ? PutFloats(handle,cur->InputWgts,cur->NumInput) :
+                    PutReals(handle,cur->InputWgts,cur->NumInput);
+    }
+  pos += hdr.NumConn * wsize;
+
+  ok = ok && PadTo(handle,&pos,hdr.BiasWgts);
+  if(Frozen)
+    ok = ok && (single ? PutFloats(handle,bias,NumUnits) :
+                         PutReals(handle,bias,NumUnits));
+  else
+    for(ix = 0;ok && ix < NumUnits;ix += cnt)
+    {
+      cnt = NumUnits - ix < 1024 ? NumUnits - ix : 1024;
+      for(jx = 0;jx < cnt;jx++)
+        buf[jx] = UnitList[ix + jx]->BiasWgt;
+      ok = single ? PutFloats(handle,buf,cnt) : PutReals(handle,buf,cnt);
+    }
+  pos += hdr.NumUnits * wsize;
+
+  if(ExecSeq != NULL)
+  {
+    ok = ok && PadTo(handle,&pos,hdr.ExecSeq) &&
+         PutWords(handle,ExecSeq,NumUnits);
+    pos += hdr.NumUnits * sizeof(uint64_t);
+  }
+
+  ok = ok && PadTo(handle,&pos,hdr.Names);
+  for(ix = 0;ok && ix < NumUnits;ix++)  // Unit names.
+    if(UnitList[ix]->IODef != NULL)
+      ok = fputs(UnitList[ix]->IODef->Name,handle) >= 0 &&
+           fputc('\0',handle) != EOF;
+
+  return(ok ? NW_SUCCESS : NW_ERR_WRITING);
+}
+
+/*****************************************************************************
+  Function:   Network::SaveWeights()
+  Purpose:    This function saves the network's weights to a weight file
+              (see WriteWeights()).  The network is frozen first, if it is
+              not already.
+  Parameters: char *file                Name of weight file.
+              int delta                 If TRUE, only the weights which have
+                                        changed are written, if possible.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::SaveWeights(const char *file,int delta)
+{
+  NWErr           nwErr;
+
+  EndCheckpoint();                      // It may be writing the same file.
+
+  if(NumUnits == 0)                     // No units in network.
+    return(NW_ERR_NOUNITS);
+  if((nwErr = Freeze()) != NW_SUCCESS)
+    return(nwErr);
+
+  return(WriteWeights(file,Wgt,BiasWgts,delta));
+}
+
+/*****************************************************************************
+  Function:   Network::WriteWeights()
+  Purpose:    This function writes weights to a weight file.  A full record
+              is written to a new file, which is renamed over the given one
+              once it is safely on disk.  A delta record is appended to the
+              file -- if this network last wrote the file, and its shape
+              has not changed since; otherwise a full record is written
+              instead.  If no weight has changed, nothing is written.
+              The network must be frozen.
+  Parameters: char *file                Name of weight file.
+              const double *wgt         Interconnection weights (Wgt, or a
+                                        copy).
+              const double *bias        Bias weights (BiasWgts, or a copy).
+              int delta                 If TRUE, only the weights which have
+                                        changed are written, if possible.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::WriteWeights(const char *file,const double *wgt,
+                            const double *bias,int delta)
+{
+  NWWeightHdr     hdr;
+  NWWeightRec     rec;
+  NWWeightLog    *log = WLog;
+  FILE           *handle;
+  char            temp[PATH_MAX + 8];
+  uint64_t        buf[1024];
+  unsigned long   ix,jx,pos,cnt,conn,num;
+  uint32_t        sum;
+  int             ok;
+
+  if(!Frozen)                           // No compact layout.
+    return(NW_ERR_NOTREADY);
+  if(strlen(file) > PATH_MAX)
+    return(NW_ERR_BADPARAM);
+
+  conn = RowStart[NumUnits];
+  num  = conn + NumUnits;
+
+  if(delta && log != NULL && log->Num == num && strcmp(log->Path,file) == 0)
+  {
+    sum = SUM_INIT;                     // Size up the record.
+    rec.Length = 0;
+    for(pos = 0;NextRun(wgt,bias,conn,num,log->Base,&pos,&cnt);pos += cnt)
+    {
+      sum = AddSum(AddSum(sum,pos),cnt);
+      for(ix = pos;ix < pos + cnt;ix++)
+        sum = AddSum(sum,Bits(Weight(wgt,bias,conn,ix)));
+      rec.Length += cnt + 2;
+    }
+    if(rec.Length == 0)                 // Nothing has changed.
+      return(NW_SUCCESS);
+
+    rec.Type   = NW_LE32((uint32_t)WREC_DELTA);
+    rec.Sum    = NW_LE32(AddSum(AddSum(sum,WREC_DELTA),rec.Length));
+    rec.Length = NW_LE64(rec.Length);
+
+    if((handle = fopen(file,"ab")) == NULL)
+    {
+      FreeWeightLog();
+      return(NW_ERR_OPENING);           // Error opening file.
+    }
+    ok = fwrite(&rec,1,sizeof(NWWeightRec),handle) == sizeof(NWWeightRec);
+
+    for(pos = 0,jx = 0;ok && NextRun(wgt,bias,conn,num,log->Base,&pos,&cnt);
+        pos += cnt)
+    {
+      buf[jx++] = NW_LE64((uint64_t)pos);  // Runs, a buffer at a time.
+      buf[jx++] = NW_LE64((uint64_t)cnt);
+      for(ix = pos;ix < pos + cnt;ix++)
+      {
+        if(jx == 1024)
+        {
+          ok = ok && fwrite(buf,sizeof(uint64_t),jx,handle) == jx;
+          jx = 0;
+        }
+        log->Base[ix] = Weight(wgt,bias,conn,ix);
+        buf[jx++] = NW_LE64(Bits(log->Base[ix]));
+      }
+      if(jx > 1022)
+      {
+        ok = ok && fwrite(buf,sizeof(uint64_t),jx,handle) == jx;
+        jx = 0;
+      }
+    }
+    ok = ok && fwrite(buf,sizeof(uint64_t),jx,handle) == jx;
+
+    ok = ok && fflush(handle) == 0 && fsync(fileno(handle)) == 0;
+    fclose(handle);
+    if(!ok)                             // Next record must be a full one.
+    {
+      FreeWeightLog();
+      return(NW_ERR_WRITING);
+    }
+    return(NW_SUCCESS);
+  }
+
+// Write a full record, to a new file.
+
+  FreeWeightLog();
+
+  memset(&hdr,0,sizeof(NWWeightHdr));
+  memcpy(hdr.Magic,"NWWT",4);
+  hdr.Version  = NW_LE32((uint32_t)WEIGHT_VERSION);
+  hdr.Shape    = NW_LE32(ShapeSum(NumUnits,RowStart,SrcIdx));
+  hdr.NumUnits = NW_LE64((uint64_t)NumUnits);
+  hdr.NumConn  = NW_LE64((uint64_t)conn);
+
+  for(ix = 0,sum = SUM_INIT;ix < num;ix++)
+    sum = AddSum(sum,Bits(Weight(wgt,bias,conn,ix)));
+  rec.Type   = NW_LE32((uint32_t)WREC_FULL);
+  rec.Sum    = NW_LE32(AddSum(AddSum(sum,WREC_FULL),num));
+  rec.Length = NW_LE64((uint64_t)num);
+
+  sprintf(temp, "%s.tmp", file);
+  if((handle = fopen(temp,"w+b")) == NULL)
+    return(NW_ERR_CREATING);            // Error creating file.
+
+  ok = fwrite(&hdr,1,sizeof(NWWeightHdr),handle) == sizeof(NWWeightHdr) &&
+       fwrite(&rec,1,sizeof(NWWeightRec),handle) == sizeof(NWWeightRec) &&
+       PutReals(handle,wgt,conn) && PutReals(handle,bias,NumUnits) &&
+       NWReplaceFile(handle,temp,file) == NW_SUCCESS;
+  fclose(handle);
+
+  if(!ok)
+  {
+    remove(temp);
+    return(NW_ERR_WRITING);
+  }
+
+// Remember what was written, for the deltas which follow.  Without room
+//   for it, the next record is simply a full one again.
+
+  if((log = new NWWeightLog) == NULL)
+    return(NW_SUCCESS);
+  if((log->Base = new double[num + 1]) == NULL)
+  {
+    delete log;
+    return(NW_SUCCESS);
+  }
+  strcpy(log->Path,file);
+  log->Num = num;
+  memcpy(log->Base,wgt,conn * sizeof(double));
+  memcpy(log->Base + conn,bias,NumUnits * sizeof(double));
+  WLog = log;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::LoadWeights()
+  Purpose:    This function loads the network's weights from a weight file,
+              replaying its records in turn.  The network must have the
+              shape of the one which wrote the file.  The network is frozen
+              first, if it is not already.  If a record after the first is
+              incomplete or damaged, the log is taken to end before it.
+  Parameters: char *file                Name of weight file.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::LoadWeights(const char *file)
+{
+  FILE           *handle;
+  NWWeightHdr     hdr;
+  NWWeightRec     rec;
+  uint64_t       *buf = NULL;
+  uint64_t        ix,jx,len,pos,cnt;
+  unsigned long   conn,num,num_rec;
+  uint32_t        sum;
+  int             ok;
+  NWErr           nwErr;
+
+  if(NumUnits == 0)                     // No units in network.
+    return(NW_ERR_NOUNITS);
+  if((nwErr = Freeze()) != NW_SUCCESS)
+    return(nwErr);
+
+  conn = RowStart[NumUnits];
+  num  = conn + NumUnits;
+
+  if((handle = fopen(file,"rb")) == NULL)
+    return(NW_ERR_OPENING);             // Error opening file.
+
+  if(fread(&hdr,1,sizeof(NWWeightHdr),handle) < sizeof(NWWeightHdr))
+  {
+    fclose(handle);
+    return(NW_ERR_READING);             // Error reading file.
+  }
+  if(memcmp(hdr.Magic,"NWWT",4) != 0 ||
+     NW_LE32(hdr.Version) != WEIGHT_VERSION || NW_LE32(hdr.Flags) != 0 ||
+     NW_LE64(hdr.NumUnits) != NumUnits || NW_LE64(hdr.NumConn) != conn ||
+     NW_LE32(hdr.Shape) != ShapeSum(NumUnits,RowStart,SrcIdx))
+  {
+    fclose(handle);
+    return(NW_ERR_BADFILE);             // Not this network's weights.
+  }
+
+  for(num_rec = 0;;num_rec++)           // Replay each record.
+  {
+    delete[] buf;
+    buf = NULL;
+
+    if(fread(&rec,1,sizeof(NWWeightRec),handle) < sizeof(NWWeightRec))
+      break;                            // End of log.
+    rec.Type = NW_LE32(rec.Type);
+    len      = NW_LE64(rec.Length);
+    if(rec.Type == WREC_FULL ? len != num :
+       rec.Type != WREC_DELTA || num_rec == 0 || len > 3 * (uint64_t)num)
+      break;
+    if((buf = new uint64_t[len + 1]) == NULL)
+    {
+      fclose(handle);
+      return(NW_ERR_MEMORY);
+    }
+    if(fread(buf,sizeof(uint64_t),len,handle) < len)
+      break;
+
+    for(ix = 0,sum = SUM_INIT;ix < len;ix++)
+      sum = AddSum(sum,buf[ix] = NW_LE64(buf[ix]));
+    if(AddSum(AddSum(sum,rec.Type),len) != NW_LE32(rec.Sum))
+      break;                            // Record is damaged.
+
+    if(rec.Type == WREC_FULL)
+    {
+      for(ix = 0;ix < conn;ix++)
+        Wgt[ix] = FromBits(buf[ix]);
+      for(;ix < num;ix++)
+        BiasWgts[ix - conn] = FromBits(buf[ix]);
+      continue;
+    }
+
+    for(ix = 0,ok = TRUE;ok && ix < len;ix += cnt + 2)  // Check the runs.
+    {
+      ok  = len - ix >= 2;
+      pos = ok ? buf[ix] : 0;
+      cnt = ok ? buf[ix + 1] : 0;
+      ok  = ok && pos <= num && cnt <= num - pos && cnt <= len - ix - 2;
+    }
+    if(!ok)
+      break;
+
+    for(ix = 0;ix < len;ix += cnt + 2)  // Apply them.
+    {
+      pos = buf[ix];
+      cnt = buf[ix + 1];
+      for(jx = 0;jx < cnt;jx++)
+        if(pos + jx < conn)
+          Wgt[pos + jx] = FromBits(buf[ix + 2 + jx]);
+        else
+          BiasWgts[pos + jx - conn] = FromBits(buf[ix + 2 + jx]);
+    }
+  }
+
+  delete[] buf;
+  fclose(handle);
+  SyncWeights(0,conn);
+
+  return(num_rec > 0 ? NW_SUCCESS : NW_ERR_BADFILE);
+}
+
+/*****************************************************************************
+  Function:   Network::FreeWeightLog()
+  Purpose:    This function forgets the weights last written to a weight
+              file, so that the next one written is a full one.  It is done
+              whenever the network's shape changes.
+  Parameters: None.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::FreeWeightLog(void)
+{
+  if(WLog == NULL)
+    return;
+
+  delete[] WLog->Base;
+  delete WLog;
+  WLog = NULL;
+}
+
+/*****************************************************************************
+  Function:   Network::InImage()
+  Purpose:    This function determines whether a pointer points into the
+              image (and so must not be freed).
+  Parameters: const void *ptr           The pointer.
+  Returns:    TRUE if it does.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+int Network::InImage(const void *ptr)
+{
+  return(Image != NULL && (const char *)ptr >= Image &&
+         (const char *)ptr <= Image + ImageSize);
+}
+
+/*****************************************************************************
+  Function:   Network::FreeImage()
+  Purpose:    This function releases the image, if any.  Nothing may still
+              point into it.
+  Parameters: None.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::FreeImage(void)
+{
+  if(Image != NULL && ImageMapped)
+    munmap(Image,ImageSize);
+  else
+    free(Image);
+  Image = NULL;
+  ImageSize = 0;
+  ImageMapped = FALSE;
+}
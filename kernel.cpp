@@ -0,0 +1,919 @@
+/*****************************************************************************
+  File:     kernel.cpp
+
+  Purpose:  This file contains the numeric kernels used by the network
+            object: dot products, axpy updates, and dense matrix-vector and
+            matrix-matrix products over rows of interconnection weights.
+            The kernels whose names end in F take single-precision weights
+            (see Network::SetPrecision()), and DotQ() takes 8-bit integers
+            (see quant.cpp).  Sigmoid() computes the units' activation
+            function over a run of units, and Sell() and SellF() the
+            weighted sums of a slice of a sparse group (see sparse.cpp).
+
+  The file is compiled once for each set of kernels built from it, with
+  KERNEL_SET naming the set and the compiler's options choosing the
+  instructions it may use (see the Makefile); the kernels are reached
+  through the set (see dispatch.cpp).  Unless fused multiply-adds are
+  allowed, every set gives the same results.
+
+  Every dot product is formed the same way, whichever kernel computes it:
+  the elements are split into four interleaved partial sums (element j goes
+  to sum j % 4), the partial sums are combined as (s0 + s1) + (s2 + s3), and
+  the remaining (n % 4) elements are then added in order.  A row therefore
+  yields the same result whether it is computed alone or as part of a
+  matrix product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "nwclass.h"
+
+typedef double v2d __attribute__((vector_size(16)));
+typedef double v4d __attribute__((vector_size(32)));
+typedef double v2du __attribute__((vector_size(16),aligned(8)));
+typedef double v4du __attribute__((vector_size(32),aligned(8)));
+typedef float v4f __attribute__((vector_size(16)));
+#if defined(__AVX512F__)
+typedef double v8d __attribute__((vector_size(64)));
+typedef double v8du __attribute__((vector_size(64),aligned(8)));
+typedef float v8f __attribute__((vector_size(32)));
+typedef float v8fu __attribute__((vector_size(32),aligned(4)));
+#endif
+typedef float v4fu __attribute__((vector_size(16),aligned(4)));
+
+#if defined(__AVX512F__)                // Sigmoid() takes the widest vectors
+#define SIG_LANES   8                   //   the instructions allow.
+#elif defined(__AVX__)
+#define SIG_LANES   4
+#else
+#define SIG_LANES   2
+#endif
+
+typedef double vsd __attribute__((vector_size(SIG_LANES * 8)));
+typedef long long vsi __attribute__((vector_size(SIG_LANES * 8)));
+
+typedef signed char v16qi __attribute__((vector_size(16),aligned(1)));
+typedef short v16hi __attribute__((vector_size(32)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef int v8si __attribute__((vector_size(32)));
+
+#define LOAD2(p)    (*(const v2du *)(p))  // Load two (unaligned) doubles.
+#define LOAD4(p)    (*(const v4du *)(p))  // Load four (unaligned) doubles.
+#define LOAD4F(p)   (*(const v4fu *)(p))  // Load four (unaligned) floats.
+#define LOAD16Q(p)  (*(const v16qi *)(p)) // Load sixteen 8-bit integers.
+#define LOW8(v)     __builtin_shufflevector(v,v,0,1,2,3,4,5,6,7)
+#define HIGH8(v)    __builtin_shufflevector(v,v,8,9,10,11,12,13,14,15)
+
+#if SELL_LANES != 8
+#error Sell() and SellF() take slices of eight units.
+#endif
+
+#define GEMM_PANEL  16384               // Weights per row panel (128 KB).
+#define GEMM_BLOCK  16                  // Vectors per block.
+#define DOTQ_RUN    (1UL << 20)         // Most elements summed in 32 bits.
+
+#define SIG_POLY_MAX  700.0             // Largest |x| SIG_POLY distinguishes.
+#define SIG_TABLE_MAX 16                // Table covers [-16, 16].
+#define SIG_TABLE_RES 64                // Table entries per unit of x.
+#define SIG_TABLE_LEN (2 * SIG_TABLE_MAX * SIG_TABLE_RES + 1)
+
+/*****************************************************************************
+  Function:   Reduce4()
+  Purpose:    This function combines four partial sums.
+  Parameters: const v4d &s              The partial sums.
+  Returns:    (s0 + s1) + (s2 + s3).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static inline double Reduce4(const v4d &s)
+{
+  return((s[0] + s[1]) + (s[2] + s[3]));
+}
+
+/*****************************************************************************
+  Function:   Dot()
+  Purpose:    This function computes the dot product of two vectors.
+  Parameters: const double *x           First vector.
+              const double *y           Second vector.
+              unsigned long n           Number of elements.
+  Returns:    The dot product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static double Dot(const double *x,const double *y,unsigned long n)
+{
+  unsigned long ix,n4 = n & ~3UL;
+  v4d           s = {0.0,0.0,0.0,0.0};
+  double        sum;
+
+  for(ix = 0;ix < n4;ix += 4)
+    s += LOAD4(&x[ix]) * LOAD4(&y[ix]);
+
+  sum = Reduce4(s);
+  for(;ix < n;ix++)
+    sum += x[ix] * y[ix];
+
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   Axpy()
+  Purpose:    This function adds a multiple of one vector to another
+              (y += a * x).
+  Parameters: unsigned long n           Number of elements.
+              double a                  Multiplier.
+              const double *x           Vector to be scaled and added.
+              double *y                 Vector to be updated.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Axpy(unsigned long n,double a,const double *x,double *y)
+{
+  unsigned long ix,n4 = n & ~3UL;
+  v4d           va = {a,a,a,a};
+
+  for(ix = 0;ix < n4;ix += 4)
+  {
+    *(v4du *)&y[ix] = LOAD4(&y[ix]) + va * LOAD4(&x[ix]);
+  }
+
+  for(;ix < n;ix++)
+    y[ix] += a * x[ix];
+}
+
+/*****************************************************************************
+  Function:   Gemv()
+  Purpose:    This function multiplies a row-major matrix by a vector, adding
+              the result to another vector (y += W * x).  Four rows are done
+              at a time, so that each element of x is loaded once for the
+              four of them.
+  Parameters: unsigned long rows        Number of rows in W.
+              unsigned long cols        Number of columns in W (and
+                                        elements in x).
+              const double *w           The matrix; rows follow each other
+                                        with no gaps.
+              const double *x           Vector to be multiplied.
+              double *y                 Vector to receive the result.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Gemv(unsigned long rows,unsigned long cols,const double *w,
+                 const double *x,double *y)
+{
+  unsigned long   ix,jx,n4 = cols & ~3UL;
+  const double   *w0,*w1,*w2,*w3;
+  double          t0,t1,t2,t3;
+  v4d             s0,s1,s2,s3,vx;
+
+  for(ix = 0;ix + 4 <= rows;ix += 4)
+  {
+    w0 = w + ix * cols;
+    w1 = w0 + cols;
+    w2 = w1 + cols;
+    w3 = w2 + cols;
+    s0 = s1 = s2 = s3 = (v4d){0.0,0.0,0.0,0.0};
+
+    for(jx = 0;jx < n4;jx += 4)
+    {
+      vx  = LOAD4(&x[jx]);
+      s0 += LOAD4(&w0[jx]) * vx;
+      s1 += LOAD4(&w1[jx]) * vx;
+      s2 += LOAD4(&w2[jx]) * vx;
+      s3 += LOAD4(&w3[jx]) * vx;
+    }
+
+    t0 = Reduce4(s0);
+    t1 = Reduce4(s1);
+    t2 = Reduce4(s2);
+    t3 = Reduce4(s3);
+    for(;jx < cols;jx++)
+    {
+      t0 += w0[jx] * x[jx];
+      t1 += w1[jx] * x[jx];
+      t2 += w2[jx] * x[jx];
+      t3 += w3[jx] * x[jx];
+    }
+
+    y[ix]     += t0;
+    y[ix + 1] += t1;
+    y[ix + 2] += t2;
+    y[ix + 3] += t3;
+  }
+
+  for(;ix < rows;ix++)                  // Leftover rows.
+    y[ix] += Dot(w + ix * cols,x,cols);
+}
+
+/*****************************************************************************
+  Function:   Gemm()
+  Purpose:    This function multiplies a row-major matrix by each of a
+              number of vectors, adding the results to a second set of
+              vectors (y[b] += W * x[b]).  The vectors are taken in blocks,
+              and the rows in panels, small enough that a block and a panel
+              stay in cache together; each panel is run through every vector
+              of the block before moving on.  Within a panel two rows are
+              paired with two vectors at a time.
+  Parameters: unsigned long rows        Number of rows in W.
+              unsigned long cols        Number of columns in W (and
+                                        elements in each x).
+              const double *w           The matrix; rows follow each other
+                                        with no gaps.
+              unsigned long num         Number of vectors.
+              const double *x           First vector to be multiplied.
+              unsigned long ldx         Distance between vectors in x.
+              double *y                 First vector to receive a result.
+              unsigned long ldy         Distance between vectors in y.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Gemm(unsigned long rows,unsigned long cols,const double *w,
+                 unsigned long num,const double *x,unsigned long ldx,
+                 double *y,unsigned long ldy)
+{
+  unsigned long   panel,block,stop,first,last,bx,ix,jx,n4 = cols & ~3UL;
+  const double   *w0,*w1,*x0,*x1;
+  double          t00,t01,t10,t11;
+  v4d             s00,s01,s10,s11,a0,a1,b0,b1;
+
+  if(num == 1)                          // Single vector.
+  {
+    Gemv(rows,cols,w,x,y);
+    return;
+  }
+
+  panel = cols ? GEMM_PANEL / cols : rows;
+  if(panel < 2)
+    panel = 2;
+
+  for(block = 0;block < num;block = stop)
+  {
+    stop = block + GEMM_BLOCK < num ? block + GEMM_BLOCK : num;
+
+    for(first = 0;first < rows;first = last)
+    {
+      last = first + panel < rows ? first + panel : rows;
+
+      for(bx = block;bx + 2 <= stop;bx += 2)  // Two vectors at a time.
+      {
+        x0 = x + bx * ldx;
+        x1 = x0 + ldx;
+
+        for(ix = first;ix + 2 <= last;ix += 2)  // Two rows at a time.
+        {
+          w0 = w + ix * cols;
+          w1 = w0 + cols;
+          s00 = s01 = s10 = s11 = (v4d){0.0,0.0,0.0,0.0};
+
+          for(jx = 0;jx < n4;jx += 4)
+          {
+            a0 = LOAD4(&w0[jx]);
+            a1 = LOAD4(&w1[jx]);
+            b0 = LOAD4(&x0[jx]);
+            b1 = LOAD4(&x1[jx]);
+            s00 += a0 * b0;
+            s01 += a0 * b1;
+            s10 += a1 * b0;
+            s11 += a1 * b1;
+          }
+
+          t00 = Reduce4(s00);
+          t01 = Reduce4(s01);
+          t10 = Reduce4(s10);
+          t11 = Reduce4(s11);
+          for(;jx < cols;jx++)
+          {
+            t00 += w0[jx] * x0[jx];
+            t01 += w0[jx] * x1[jx];
+            t10 += w1[jx] * x0[jx];
+            t11 += w1[jx] * x1[jx];
+          }
+
+          y[bx * ldy + ix]           += t00;
+          y[(bx + 1) * ldy + ix]     += t01;
+          y[bx * ldy + ix + 1]       += t10;
+          y[(bx + 1) * ldy + ix + 1] += t11;
+        }
+
+        if(ix < last)                   // Leftover row.
+        {
+          y[bx * ldy + ix]       += Dot(w + ix * cols,x0,cols);
+          y[(bx + 1) * ldy + ix] += Dot(w + ix * cols,x1,cols);
+        }
+      }
+
+      if(bx < stop)                     // Leftover vector.
+        Gemv(last - first,cols,w + first * cols,x + bx * ldx,
+             y + bx * ldy + first);
+    }
+  }
+}
+
+/*****************************************************************************
+  Function:   DotFV()
+  Purpose:    This function computes the dot product of a vector of
+              single-precision weights with a vector of doubles, in the
+              arithmetic of V (four floats or four doubles) and T.
+  Parameters: const float *w            Weights.
+              const double *x           Vector.
+              unsigned long n           Number of elements.
+  Returns:    The dot product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+template <class V,class T>
+static inline T DotFV(const float *w,const double *x,unsigned long n)
+{
+  unsigned long ix,n4 = n & ~3UL;
+  V             s = {0,0,0,0};
+  T             sum;
+
+  for(ix = 0;ix < n4;ix += 4)
+    s += __builtin_convertvector(LOAD4F(&w[ix]),V) *
+         __builtin_convertvector(LOAD4(&x[ix]),V);
+
+  sum = (s[0] + s[1]) + (s[2] + s[3]);
+  for(;ix < n;ix++)
+    sum += (T)w[ix] * (T)x[ix];
+
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   GemvFV()
+  Purpose:    This function is Gemv() for single-precision weights, in the
+              arithmetic of V and T.
+  Parameters: As Gemv().
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+template <class V,class T>
+static void GemvFV(unsigned long rows,unsigned long cols,const float *w,
+                   const double *x,double *y)
+{
+  unsigned long   ix,jx,n4 = cols & ~3UL;
+  const float    *w0,*w1,*w2,*w3;
+  T               t0,t1,t2,t3,vt;
+  V               s0,s1,s2,s3,vx;
+
+  for(ix = 0;ix + 4 <= rows;ix += 4)
+  {
+    w0 = w + ix * cols;
+    w1 = w0 + cols;
+    w2 = w1 + cols;
+    w3 = w2 + cols;
+    s0 = s1 = s2 = s3 = (V){0,0,0,0};
+
+    for(jx = 0;jx < n4;jx += 4)
+    {
+      vx  = __builtin_convertvector(LOAD4(&x[jx]),V);
+      s0 += __builtin_convertvector(LOAD4F(&w0[jx]),V) * vx;
+      s1 += __builtin_convertvector(LOAD4F(&w1[jx]),V) * vx;
+      s2 += __builtin_convertvector(LOAD4F(&w2[jx]),V) * vx;
+      s3 += __builtin_convertvector(LOAD4F(&w3[jx]),V) * vx;
+    }
+
+    t0 = (s0[0] + s0[1]) + (s0[2] + s0[3]);
+    t1 = (s1[0] + s1[1]) + (s1[2] + s1[3]);
+    t2 = (s2[0] + s2[1]) + (s2[2] + s2[3]);
+    t3 = (s3[0] + s3[1]) + (s3[2] + s3[3]);
+    for(;jx < cols;jx++)
+    {
+      vt  = (T)x[jx];
+      t0 += (T)w0[jx] * vt;
+      t1 += (T)w1[jx] * vt;
+      t2 += (T)w2[jx] * vt;
+      t3 += (T)w3[jx] * vt;
+    }
+
+    y[ix]     += t0;
+    y[ix + 1] += t1;
+    y[ix + 2] += t2;
+    y[ix + 3] += t3;
+  }
+
+  for(;ix < rows;ix++)                  // Leftover rows.
+    y[ix] += DotFV<V,T>(w + ix * cols,x,cols);
+}
+
+/*****************************************************************************
+  Function:   GemmFV()
+  Purpose:    This function is Gemm() for single-precision weights, in the
+              arithmetic of V and T.  The weights take half the room, so a
+              panel holds twice as many rows.
+  Parameters: As Gemm().
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+template <class V,class T>
+static void GemmFV(unsigned long rows,unsigned long cols,const float *w,
+                   unsigned long num,const double *x,unsigned long ldx,
+                   double *y,unsigned long ldy)
+{
+  unsigned long   panel,block,stop,first,last,bx,ix,jx,n4 = cols & ~3UL;
+  const float    *w0,*w1;
+  const double   *x0,*x1;
+  T               t00,t01,t10,t11,v0,v1;
+  V               s00,s01,s10,s11,a0,a1,b0,b1;
+
+  if(num == 1)                          // Single vector.
+  {
+    GemvFV<V,T>(rows,cols,w,x,y);
+    return;
+  }
+
+  panel = cols ? 2 * GEMM_PANEL / cols : rows;
+  if(panel < 2)
+    panel = 2;
+
+  for(block = 0;block < num;block = stop)
+  {
+    stop = block + GEMM_BLOCK < num ? block + GEMM_BLOCK : num;
+
+    for(first = 0;first < rows;first = last)
+    {
+      last = first + panel < rows ? first + panel : rows;
+
+      for(bx = block;bx + 2 <= stop;bx += 2)  // Two vectors at a time.
+      {
+        x0 = x + bx * ldx;
+        x1 = x0 + ldx;
+
+        for(ix = first;ix + 2 <= last;ix += 2)  // Two rows at a time.
+        {
+          w0 = w + ix * cols;
+          w1 = w0 + cols;
+          s00 = s01 = s10 = s11 = (V){0,0,0,0};
+
+          for(jx = 0;jx < n4;jx += 4)
+          {
+            a0 = __builtin_convertvector(LOAD4F(&w0[jx]),V);
+            a1 = __builtin_convertvector(LOAD4F(&w1[jx]),V);
+            b0 = __builtin_convertvector(LOAD4(&x0[jx]),V);
+            b1 = __builtin_convertvector(LOAD4(&x1[jx]),V);
+            s00 += a0 * b0;
+            s01 += a0 * b1;
+            s10 += a1 * b0;
+            s11 += a1 * b1;
+          }
+
+          t00 = (s00[0] + s00[1]) + (s00[2] + s00[3]);
+          t01 = (s01[0] + s01[1]) + (s01[2] + s01[3]);
+          t10 = (s10[0] + s10[1]) + (s10[2] + s10[3]);
+          t11 = (s11[0] + s11[1]) + (s11[2] + s11[3]);
+          for(;jx < cols;jx++)
+          {
+            v0   = (T)x0[jx];
+            v1   = (T)x1[jx];
+            t00 += (T)w0[jx] * v0;
+            t01 += (T)w0[jx] * v1;
+            t10 += (T)w1[jx] * v0;
+            t11 += (T)w1[jx] * v1;
+          }
+
+          y[bx * ldy + ix]           += t00;
+          y[(bx + 1) * ldy + ix]     += t01;
+          y[bx * ldy + ix + 1]       += t10;
+          y[(bx + 1) * ldy + ix + 1] += t11;
+        }
+
+        if(ix < last)                   // Leftover row.
+        {
+          y[bx * ldy + ix]       += DotFV<V,T>(w + ix * cols,x0,cols);
+          y[(bx + 1) * ldy + ix] += DotFV<V,T>(w + ix * cols,x1,cols);
+        }
+      }
+
+      if(bx < stop)                     // Leftover vector.
+        GemvFV<V,T>(last - first,cols,w + first * cols,x + bx * ldx,
+                    y + bx * ldy + first);
+    }
+  }
+}
+
+/*****************************************************************************
+  Function:   DotF()
+  Purpose:    This function computes the dot product of a vector of
+              single-precision weights with a vector of doubles.
+  Parameters: const float *w            Weights.
+              const double *x           Vector.
+              unsigned long n           Number of elements.
+              int single                If TRUE, the products are formed and
+                                        summed in single precision; if
+                                        FALSE, in double precision.
+  Returns:    The dot product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static double DotF(const float *w,const double *x,unsigned long n,
+                   int single)
+{
+  if(single)
+    return(DotFV<v4f,float>(w,x,n));
+  return(DotFV<v4d,double>(w,x,n));
+}
+
+/*****************************************************************************
+  Function:   AxpyF()
+  Purpose:    This function adds a multiple of a vector of single-precision
+              weights to a vector of doubles (y += a * x), in double
+              precision.
+  Parameters: unsigned long n           Number of elements.
+              double a                  Multiplier.
+              const float *x            Vector to be scaled and added.
+              double *y                 Vector to be updated.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void AxpyF(unsigned long n,double a,const float *x,double *y)
+{
+  unsigned long ix,n4 = n & ~3UL;
+  v4d           va = {a,a,a,a};
+
+  for(ix = 0;ix < n4;ix += 4)
+  {
+    *(v4du *)&y[ix] = LOAD4(&y[ix]) +
+                      va * __builtin_convertvector(LOAD4F(&x[ix]),v4d);
+  }
+
+  for(;ix < n;ix++)
+    y[ix] += a * x[ix];
+}
+
+/*****************************************************************************
+  Function:   GemmF()
+  Purpose:    This function is Gemm() for a matrix of single-precision
+              weights: it multiplies the matrix by each of a number of
+              vectors of doubles, adding the results to a second set of
+              vectors (y[b] += W * x[b]).  Only the weights are single
+              precision; each sum is still split and combined as any other.
+  Parameters: As Gemm(), and:
+              int single                If TRUE, the products are formed and
+                                        summed in single precision; if
+                                        FALSE, in double precision.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void GemmF(unsigned long rows,unsigned long cols,const float *w,
+                  unsigned long num,const double *x,unsigned long ldx,
+                  double *y,unsigned long ldy,int single)
+{
+  if(single)
+    GemmFV<v4f,float>(rows,cols,w,num,x,ldx,y,ldy);
+  else
+    GemmFV<v4d,double>(rows,cols,w,num,x,ldx,y,ldy);
+}
+
+/*****************************************************************************
+  Function:   DotQ()
+  Purpose:    This function computes the dot product of two vectors of
+              8-bit integers (see quant.cpp), exactly.  Sixteen elements are
+              multiplied at a time, as 16-bit integers (no product of two
+              8-bit integers overflows one), and summed as 32-bit integers,
+              in two sets of eight lanes (which every set of vector
+              instructions can hold), in runs short enough that no sum
+              overflows either.
+  Parameters: const signed char *x      First vector.
+              const signed char *y      Second vector.
+              unsigned long n           Number of elements.
+  Returns:    The dot product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static long DotQ(const signed char *x,const signed char *y,unsigned long n)
+{
+  unsigned long ix,jx,stop,n16 = n & ~15UL;
+  v16qi         a,b;
+  v16hi         p;
+  v8si          s0,s1;
+  long          sum = 0;
+
+  for(ix = 0;ix < n16;)
+  {
+    stop = ix + DOTQ_RUN < n16 ? ix + DOTQ_RUN : n16;
+    s0 = s1 = (v8si){0};
+    for(;ix < stop;ix += 16)
+    {
+      a   = LOAD16Q(&x[ix]);
+      b   = LOAD16Q(&y[ix]);
+      p   = __builtin_convertvector(a,v16hi) * __builtin_convertvector(b,v16hi);
+      s0 += __builtin_convertvector(LOW8(p),v8si);
+      s1 += __builtin_convertvector(HIGH8(p),v8si);
+    }
+    for(jx = 0;jx < 8;jx++)
+      sum += (long)s0[jx] + s1[jx];
+  }
+
+  for(;ix < n;ix++)
+    sum += x[ix] * y[ix];
+
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   SigmoidPoly()
+  Purpose:    This function computes the sigmoid function of a vector's
+              worth of values (V holds doubles; VI is the vector of 64-bit
+              integers of the same size) by way of a polynomial
+              approximation of exp().  exp(-x) is split as 2^k * exp(r),
+              with k the integer nearest -x / ln 2 and |r| <= (ln 2) / 2;
+              exp(r) is then its Taylor series to the r^12 term, whose
+              truncation error is below 2e-16 of its value over that range,
+              and 2^k is built directly in the exponent bits.  Values
+              beyond +/-SIG_POLY_MAX are taken as that, which changes the
+              result by less than 1e-300.
+  Parameters: const double *x           The values.
+              double *y                 Receives the results; may be x.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+template <class V,class VI>
+static inline void SigmoidPoly(const double *x,double *y)
+{
+  typedef V Vu __attribute__((aligned(8)));
+  const double shift = 6755399441055744.0;      // 1.5 * 2^52.
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+  V            t,k,r,p,big = (V){} + SIG_POLY_MAX;
+  VI           bits,out;
+
+  t   = -*(const Vu *)x;
+  out = t > big;                        // Clamp t to [-big, big].
+  t   = (V)(((VI)t & ~out) | ((VI)big & out));
+  out = t < -big;
+  t   = (V)(((VI)t & ~out) | ((VI)-big & out));
+
+// Adding 1.5 * 2^52 rounds t / ln 2 to an integer, which is left in the
+//   low bits of the sum.
+
+  k    = t * M_LOG2E + shift;
+  bits = (VI)k - (VI)((V){} + shift);
+  k   -= shift;
+  r    = (t - k * ln2_hi) - k * ln2_lo;
+
+  p = r * (1.0 / 479001600.0) + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+
+  p *= (V)((bits + 1023) << 52);        // Times 2^k.
+  *(Vu *)y = 1.0 / (1.0 + p);
+}
+
+/*****************************************************************************
+  Function:   BuildSigmoidTable()
+  Purpose:    This function builds the table of the sigmoid function used
+              by SIG_TABLE.  Entry i holds the function of
+              (i / SIG_TABLE_RES - SIG_TABLE_MAX); a copy of the last entry
+              follows, so that interpolation may read one past any entry.
+  Parameters: None.
+  Returns:    The table.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static const double *BuildSigmoidTable(void)
+{
+  static double table[SIG_TABLE_LEN + 1];
+  unsigned long ix;
+
+  for(ix = 0;ix < SIG_TABLE_LEN;ix++)
+    table[ix] = 1.0 / (1.0 + exp(SIG_TABLE_MAX - (double)ix / SIG_TABLE_RES));
+  table[SIG_TABLE_LEN] = table[SIG_TABLE_LEN - 1];
+
+  return(table);
+}
+
+/*****************************************************************************
+  Function:   Sigmoid()
+  Purpose:    This function computes the sigmoid function, 1 / (1 + e^-x),
+              of each of a vector of values, in one of three ways:
+                SIG_EXACT   With exp() from the C library, as a single unit
+                            does.
+                SIG_POLY    A vector of values at a time, with a polynomial
+                            approximation (see SigmoidPoly()); the results
+                            are within 1e-15 of the exact function.
+                SIG_TABLE   By linear interpolation in a table of 2049
+                            values over [-16, 16]; the results are within
+                            3e-6 of the exact function, and within 1.2e-7
+                            beyond that range, where the end values are
+                            used.
+  Parameters: unsigned long n           Number of values.
+              const double *x           Values.
+              double *y                 Receives the results; may be x.
+              int mode                  How to compute them (SIG_xxx).
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Sigmoid(unsigned long n,const double *x,double *y,int mode)
+{
+  unsigned long ix,jx,nv = n - n % SIG_LANES;
+  double        pos,frac,pad[SIG_LANES];
+  long          entry;
+
+  if(mode == SIG_POLY)
+  {
+    for(ix = 0;ix < nv;ix += SIG_LANES)
+      SigmoidPoly<vsd,vsi>(&x[ix],&y[ix]);
+    if(ix < n)                          // Pad the last few to a vector.
+    {
+      for(jx = 0;jx < SIG_LANES;jx++)
+        pad[jx] = ix + jx < n ? x[ix + jx] : 0.0;
+      SigmoidPoly<vsd,vsi>(pad,pad);
+      for(jx = 0;ix + jx < n;jx++)
+        y[ix + jx] = pad[jx];
+    }
+  }
+  else if(mode == SIG_TABLE)
+  {
+    static const double *table = BuildSigmoidTable();  // Built once.
+
+    for(ix = 0;ix < n;ix++)
+    {
+      pos = (x[ix] + SIG_TABLE_MAX) * SIG_TABLE_RES;
+      pos = pos > 0.0 ? pos : 0.0;      // Also takes NaN to 0.
+      pos = pos < SIG_TABLE_LEN - 1 ? pos : SIG_TABLE_LEN - 1;
+      entry = (long)pos;
+      frac  = pos - entry;
+      y[ix] = table[entry] + frac * (table[entry + 1] - table[entry]);
+    }
+  }
+  else                                  // SIG_EXACT.
+  {
+    for(ix = 0;ix < n;ix++)
+      y[ix] = 1.0 / (1.0 + exp(-x[ix]));
+  }
+}
+
+/*****************************************************************************
+  Function:   Sell()
+  Purpose:    This function forms the weighted sums of a slice of a sparse
+              group (see sparse.cpp), adding them to y.  The activation
+              levels named by each entry are gathered into vectors -- with
+              the gather instructions, where there are any -- and each
+              lane's sum is formed in the order of its entries.
+  Parameters: unsigned long len         Entries per unit.
+              const unsigned int *idx   Input units of the entries.
+              const double *w           Weights of the entries.
+              const double *x           Activation levels.
+              double *y                 The SELL_LANES sums; updated.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Sell(unsigned long len,const unsigned int *idx,const double *w,
+                 const double *x,double *y)
+{
+  unsigned long ix;
+
+#if defined(__AVX512F__)
+  v8d           s = *(const v8du *)y;
+
+  for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+    s += (v8d)_mm512_i32gather_pd(_mm256_loadu_si256((const __m256i *)idx),
+                                  x,8) * *(const v8du *)w;
+  *(v8du *)y = s;
+#elif defined(__AVX2__)
+  v4d           s0 = LOAD4(&y[0]),s1 = LOAD4(&y[4]);
+
+  for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+  {
+    s0 += (v4d)_mm256_i32gather_pd(x,_mm_loadu_si128((const __m128i *)&idx[0]),
+                                   8) * LOAD4(&w[0]);
+    s1 += (v4d)_mm256_i32gather_pd(x,_mm_loadu_si128((const __m128i *)&idx[4]),
+                                   8) * LOAD4(&w[4]);
+  }
+  *(v4du *)&y[0] = s0;
+  *(v4du *)&y[4] = s1;
+#else
+  v2d           s0 = LOAD2(&y[0]),s1 = LOAD2(&y[2]);
+  v2d           s2 = LOAD2(&y[4]),s3 = LOAD2(&y[6]);
+
+  for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+  {
+    s0 += (v2d){x[idx[0]],x[idx[1]]} * LOAD2(&w[0]);
+    s1 += (v2d){x[idx[2]],x[idx[3]]} * LOAD2(&w[2]);
+    s2 += (v2d){x[idx[4]],x[idx[5]]} * LOAD2(&w[4]);
+    s3 += (v2d){x[idx[6]],x[idx[7]]} * LOAD2(&w[6]);
+  }
+  *(v2du *)&y[0] = s0;
+  *(v2du *)&y[2] = s1;
+  *(v2du *)&y[4] = s2;
+  *(v2du *)&y[6] = s3;
+#endif
+}
+
+/*****************************************************************************
+  Function:   SellF()
+  Purpose:    This function is Sell() for a slice of single-precision
+              weights.
+  Parameters: As Sell(), and:
+              const float *w            Weights of the entries.
+              int single                If TRUE, the products are formed and
+                                        summed in single precision, from
+                                        zero, and each sum is then added to
+                                        y; if FALSE, they are formed in
+                                        double precision and added to y.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void SellF(unsigned long len,const unsigned int *idx,const float *w,
+                  const double *x,double *y,int single)
+{
+  unsigned long ix;
+
+#if defined(__AVX512F__)
+  v8d           s = *(const v8du *)y,g;
+  v8f           f = {0,0,0,0,0,0,0,0};
+
+  for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+  {
+    g = (v8d)_mm512_i32gather_pd(_mm256_loadu_si256((const __m256i *)idx),
+                                 x,8);
+    if(single)
+      f += __builtin_convertvector(g,v8f) * *(const v8fu *)w;
+    else
+      s += g * __builtin_convertvector(*(const v8fu *)w,v8d);
+  }
+  *(v8du *)y = single ? s + __builtin_convertvector(f,v8d) : s;
+#elif defined(__AVX2__)
+  v4d           s0 = LOAD4(&y[0]),s1 = LOAD4(&y[4]),g0,g1;
+  v4f           f0 = {0,0,0,0},f1 = {0,0,0,0};
+
+  for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+  {
+    g0 = (v4d)_mm256_i32gather_pd(x,_mm_loadu_si128((const __m128i *)&idx[0]),
+                                  8);
+    g1 = (v4d)_mm256_i32gather_pd(x,_mm_loadu_si128((const __m128i *)&idx[4]),
+                                  8);
+    if(single)
+    {
+      f0 += __builtin_convertvector(g0,v4f) * LOAD4F(&w[0]);
+      f1 += __builtin_convertvector(g1,v4f) * LOAD4F(&w[4]);
+    }
+    else
+    {
+      s0 += g0 * __builtin_convertvector(LOAD4F(&w[0]),v4d);
+      s1 += g1 * __builtin_convertvector(LOAD4F(&w[4]),v4d);
+    }
+  }
+  if(single)
+  {
+    s0 += __builtin_convertvector(f0,v4d);
+    s1 += __builtin_convertvector(f1,v4d);
+  }
+  *(v4du *)&y[0] = s0;
+  *(v4du *)&y[4] = s1;
+#else
+  v2d           s0 = LOAD2(&y[0]),s1 = LOAD2(&y[2]);
+  v2d           s2 = LOAD2(&y[4]),s3 = LOAD2(&y[6]);
+  v4f           f0 = {0,0,0,0},f1 = {0,0,0,0};
+
+  for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+  {
+    if(single)
+    {
+      f0 += (v4f){(float)x[idx[0]],(float)x[idx[1]],
+                  (float)x[idx[2]],(float)x[idx[3]]} * LOAD4F(&w[0]);
+      f1 += (v4f){(float)x[idx[4]],(float)x[idx[5]],
+                  (float)x[idx[6]],(float)x[idx[7]]} * LOAD4F(&w[4]);
+    }
+    else
+    {
+      s0 += (v2d){x[idx[0]],x[idx[1]]} * (v2d){w[0],w[1]};
+      s1 += (v2d){x[idx[2]],x[idx[3]]} * (v2d){w[2],w[3]};
+      s2 += (v2d){x[idx[4]],x[idx[5]]} * (v2d){w[4],w[5]};
+      s3 += (v2d){x[idx[6]],x[idx[7]]} * (v2d){w[6],w[7]};
+    }
+  }
+  if(single)
+  {
+    s0 += (v2d){f0[0],f0[1]};
+    s1 += (v2d){f0[2],f0[3]};
+    s2 += (v2d){f1[0],f1[1]};
+    s3 += (v2d){f1[2],f1[3]};
+  }
+  *(v2du *)&y[0] = s0;
+  *(v2du *)&y[2] = s1;
+  *(v2du *)&y[4] = s2;
+  *(v2du *)&y[6] = s3;
+#endif
+}
+
+/*****************************************************************************
+  The set of kernels built from this file.  The baseline build (no
+  KERNEL_SET given) is the SSE2 set, every x86-64 CPU having SSE2.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#ifndef KERNEL_SET
+#define KERNEL_SET  NWKernelsSse2
+#endif
+
+const NWKernelSet KERNEL_SET =
+{
+  Dot,Axpy,Gemv,Gemm,DotF,AxpyF,GemmF,DotQ,Sigmoid,Sell,SellF
+};
@@ -7,6 +7,8 @@
 - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <math.h>
 #include <stdio.h>
@@ -49,9 +51,10 @@ char *Network::ErrMsg(NWErr error)
           "No units in network",
           "Unit is not an input unit",
           "Unit is not an output unit",
+          "Network is not set up for execution",
         };
 
-  if(error >= 0 && error <= 19)
+  if(error >= 0 && error <= 20)
     return(err_msgs[error]);
   else
     return("Unknown error");
@@ -93,7 +96,9 @@ unsigned long Network::ULongSearch(unsigned long key, unsigned long num,
 
 /*****************************************************************************
   Function:   Network::Open()
-  Purpose:    This function opens the given network file.
+  Purpose:    This function opens the given network file.  An image file is
+              opened by OpenImage(); a file of the original format is read
+              unit by unit.
   Parameters: char *file                The file to be opened.
   Returns:    A NetWorks error value (0 on success).
 - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -105,6 +110,7 @@ NWErr Network::Open(const char *file)
   NWFileHdr       hdr;
   NWUnit        **units;
   NWFileUnit      unit_def;
+  NWErr           nwErr;
 
   if(NumUnits)                          // We have a network.
     Close();                            // Close it first.
@@ -112,7 +118,26 @@ NWErr Network::Open(const char *file)
   if((handle = fopen(file,"r+b")) == NULL)  // Open file.
     return(NW_ERR_OPENING);             // Error opening file.
 
-  if(fread(&hdr,1,sizeof(NWFileHdr),handle) < sizeof(NWFileHdr))
+  if(fread(&hdr,1,4,handle) < 4)
+  {
+    fclose(handle);
+    return(NW_ERR_READING);             // Error reading file.
+  }
+
+  if(memcmp(&hdr,"NWIM",4) == 0)        // An image.
+  {
+    if((nwErr = OpenImage(handle)) != NW_SUCCESS)
+    {
+      fclose(handle);
+      return(nwErr);
+    }
+
+    Handle = handle;
+    realpath(file, Path);
+    return(NW_SUCCESS);
+  }
+
+  if(fread((char *)&hdr + 4,1,sizeof(NWFileHdr) - 4,handle) < sizeof(NWFileHdr) - 4)
   {
     fclose(handle);
     return(NW_ERR_READING);             // Error reading file.
@@ -140,8 +165,8 @@ ReadErr:
       {
         delete units[ix]->IODef->Name;
         delete units[ix]->IODef;
-        delete units[ix]->InputUnits;
-        delete units[ix]->InputWgts;
+        free(units[ix]->InputUnits);
+        free(units[ix]->InputWgts);
         delete units[ix];
         if(ix == 0)
           break;
@@ -158,8 +183,8 @@ MemErr:
       {
         delete units[ix]->IODef->Name;
         delete units[ix]->IODef;
-        delete units[ix]->InputUnits;
-        delete units[ix]->InputWgts;
+        free(units[ix]->InputUnits);
+        free(units[ix]->InputWgts);
         delete units[ix];
         if(ix == 0)
           break;
@@ -201,9 +226,9 @@ MemErr:
 
     if(unit_def.NumInput > 0)           // Some input connections.
     {
-      if((units[ix]->InputUnits = new unsigned long[units[ix]->NumInput]) == NULL)
+      if((units[ix]->InputUnits = (unsigned long *)malloc(units[ix]->NumInput * sizeof(unsigned long))) == NULL)
         goto MemErr;
-      if((units[ix]->InputWgts = new double[units[ix]->NumInput]) == NULL)
+      if((units[ix]->InputWgts = (double *)malloc(units[ix]->NumInput * sizeof(double))) == NULL)
         goto MemErr;
 
 // Read backwards interconnections.
@@ -246,6 +271,9 @@ MemErr:
 NWErr Network::Close(void)
 {
   unsigned long ix;
+
+  FreeCheckpoint();                     // Finish writing any checkpoint.
+  FreeWeightLog();
   for(ix = 0;ix < NumUnits;ix++)        // Free unit list.
   {
     if(UnitList[ix] == NULL)            // Not allocated.
@@ -257,16 +285,22 @@ NWErr Network::Close(void)
       delete UnitList[ix]->IODef;
     }
 
-    if(UnitList[ix]->NumInput)
+    if(UnitList[ix]->NumInput && !Frozen)  // Not part of compact layout.
     {
-      delete UnitList[ix]->InputUnits;
-      delete UnitList[ix]->InputWgts;
+      free(UnitList[ix]->InputUnits);
+      free(UnitList[ix]->InputWgts);
     }
 
     delete UnitList[ix];
   }
 
   delete[] UnitList;                    // Free list itself.
+  EndThreads();                         // Stop training threads.
+  FreeContext(&Batch);                  // Free batch state.
+  FreeLayout();                         // Free compact layout.
+  Frozen = FALSE;
+  DropPlan();                           // Free processing order.
+  FreeImage();                          // Unmap image.
 
   strcpy(Path, "");
   if(Handle != NULL)
@@ -283,13 +317,18 @@ NWErr Network::Close(void)
   BackSeq = NULL;
   Accum = NULL;
   Momentum = NULL;
+  Precision = PREC_DOUBLE;
 
   return(NW_SUCCESS);
 }
 
 /*****************************************************************************
   Function:   Network::Save()
-  Purpose:    This function saves the current network.
+  Purpose:    This function saves the current network, as an image (see
+              WriteImage()).  The image is written to a new file beside the
+              target, which is then renamed over it, so that the target is
+              never left half written; a target which is mapped as an image
+              is never seen to change.
   Parameters: char *file                If NULL, then the file will be saved
                                         under its current name (if it has
                                         one).  If a string, then the file will
@@ -299,78 +338,120 @@ NWErr Network::Close(void)
 
 NWErr Network::Save(const char *file)
 {
-  FILE           *handle = Handle;
-  unsigned long   ix;
-  NWFileHdr       hdr;
-  NWFileUnit      unit;
+  FILE           *handle;
+  char            real[PATH_MAX + 1];
+  NWErr           nwErr;
 
   if(file == NULL && Handle == NULL)    // No open file.
     return(NW_ERR_NOFILEOPEN);
 
-  if(file != NULL)                      // Open a new file.
-    if((handle = fopen(file,"w+")) == NULL)
-      return(NW_ERR_CREATING);          // Error creating file.
+  EndCheckpoint();                      // It may be writing the same file.
 
-// Write out the header.
+  if(file == NULL)
+    file = Path;
+  else if(realpath(file, real) != NULL) // Replace the file, not a link.
+    file = real;
 
-  memset(&hdr,0,sizeof(NWFileHdr));
-  hdr.MagicNum = 0x574E;                // Magic number.
-  hdr.NumUnits = NumUnits;              // Number of units.
-  if(fwrite(&hdr,1,sizeof(NWFileHdr),handle) < sizeof(NWFileHdr))
-  {
-WriteErr:
-    if(file != NULL)                    // Opened a new file.
-      fclose(handle);
-    return(NW_ERR_WRITING);             // Error writing file.
-  }
-
-  for(ix = 0;ix < NumUnits;ix++)        // Write out the units.
-  {
-    unit.X        = UnitList[ix]->X;    // Coordinates.
-    unit.Y        = UnitList[ix]->Y;
-    unit.NumInput = UnitList[ix]->NumInput;  // Number of input units.
-    unit.Type     = UnitList[ix]->Type;      // Unit type.
-    unit.Binary   = UnitList[ix]->Binary;    // Binary flag.
-    unit.Sigmoid  = UnitList[ix]->Sigmoid;   // Sigmoid function flag.
-    unit.Bias     = UnitList[ix]->Bias;      // Bias unit flag.
-    unit.BiasWgt  = UnitList[ix]->BiasWgt;   // Bias weight.
-
-    if(fwrite(&unit,1,sizeof(NWFileUnit),handle) < sizeof(NWFileUnit))
-      goto WriteErr;
-    if(unit.Type != UNIT_INTERNAL)      // Input or output unit.
-    {                                   // Write input/output def.
-      short word = strlen(UnitList[ix]->IODef->Name) + 1;
-
-      if(fwrite(&word,1,sizeof(short),handle) < sizeof(short))
-        goto WriteErr;
-      if(fwrite(UnitList[ix]->IODef->Name,1,word,handle) < word)
-        goto WriteErr;
-      if(fwrite(&UnitList[ix]->IODef->Min,1,sizeof(double),handle) < sizeof(double))
-        goto WriteErr;
-      if(fwrite(&UnitList[ix]->IODef->Max,1,sizeof(double),handle) < sizeof(double))
-        goto WriteErr;
-    }
+  if((nwErr = WriteAtomic(file,NULL,NULL,&handle)) != NW_SUCCESS)
+    return(nwErr);
 
-    if(UnitList[ix]->NumInput > 0)      // Write out backwards connections.
-    {
-      if(fwrite(UnitList[ix]->InputUnits,1,UnitList[ix]->NumInput * sizeof(unsigned long),handle) < UnitList[ix]->NumInput * sizeof(unsigned long))
-        goto WriteErr;
-      if(fwrite(UnitList[ix]->InputWgts,1,UnitList[ix]->NumInput * sizeof(double),handle) < UnitList[ix]->NumInput * sizeof(double))
-       goto WriteErr;
-    }
+  if(Handle != NULL)                    // Close the original.
+    fclose(Handle);
+  Handle = handle;
+  if(file != Path)
+    realpath(file, Path);
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWReplaceFile()
+  Purpose:    This function puts a newly written file in place of another,
+              durably: the new file is flushed to disk, renamed over the
+              old one, and the directory holding them is flushed to disk in
+              turn, so that the rename itself survives a crash.  The new
+              file is left open, and is not removed if anything fails.
+  Parameters: FILE *handle              The new file, open for writing.
+              const char *temp          Name of the new file, which must be
+                                        in the same directory as file.
+              const char *file          Name of file to replace.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWReplaceFile(FILE *handle,const char *temp,const char *file)
+{
+  char            dir[PATH_MAX + 1];
+  const char     *slash;
+  int             fd,ok;
+
+  if(fflush(handle) != 0 || fsync(fileno(handle)) != 0 ||
+     rename(temp,file) != 0)
+    return(NW_ERR_WRITING);
+
+  if((slash = strrchr(file,'/')) == NULL)  // In the current directory.
+    strcpy(dir,".");
+  else if(slash == file)                // In the root directory.
+    strcpy(dir,"/");
+  else if(slash - file <= PATH_MAX)
+  {
+    memcpy(dir,file,slash - file);
+    dir[slash - file] = '\0';
   }
+  else
+    return(NW_ERR_BADPARAM);
+
+  if((fd = open(dir,O_RDONLY)) < 0)
+    return(NW_ERR_WRITING);
+  ok = fsync(fd) == 0 || errno == EINVAL;  // EINVAL: cannot be synced.
+  close(fd);
+
+  return(ok ? NW_SUCCESS : NW_ERR_WRITING);
+}
+
+/*****************************************************************************
+  Function:   Network::WriteAtomic()
+  Purpose:    This function writes the network as an image to a new file
+              beside the given one (with ".tmp" appended to its name), and
+              then puts it in place of the given file (see NWReplaceFile()).
+              It is used by Save() and by the checkpoint writer.
+  Parameters: char *file                Name of file.
+              const double *wgt         Weights to write in place of the
+                                        network's own (see WriteImage()).
+              const double *bias        Bias weights likewise.
+              FILE **keep               If not NULL, receives the file,
+                                        left open; otherwise it is closed.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::WriteAtomic(const char *file,const double *wgt,
+                           const double *bias,FILE **keep)
+{
+  FILE           *handle;
+  char            temp[PATH_MAX + 8];
+  NWErr           nwErr;
+
+  if(strlen(file) > PATH_MAX)
+    return(NW_ERR_BADPARAM);
+
+  sprintf(temp, "%s.tmp", file);
+  if((handle = fopen(temp,"w+b")) == NULL)
+    return(NW_ERR_CREATING);            // Error creating file.
 
-  fflush(handle);                       // Flush output.
+  nwErr = WriteImage(handle,wgt,bias);
+  if(nwErr == NW_SUCCESS)
+    nwErr = NWReplaceFile(handle,temp,file);
 
-  if(file != NULL)                      // Saved in new file, close orig.
+  if(nwErr != NW_SUCCESS)
   {
-    if(Handle != NULL)
-      fclose(Handle);
-    realpath(file, Path);
+    fclose(handle);
+    remove(temp);
   }
-  Handle = handle;
+  else if(keep != NULL)
+    *keep = handle;
+  else
+    fclose(handle);
 
-  return(NW_SUCCESS);
+  return(nwErr);
 }
 
 /*****************************************************************************
@@ -400,6 +481,10 @@ NWErr Network::CreateUnit(unsigned long x,unsigned long y,int type,int binary,
                           double max,unsigned long *index)
 {
   void *temp;
+  NWErr nwErr;
+
+  if((nwErr = Thaw()) != NW_SUCCESS)    // Layout is about to be stale.
+    return(nwErr);
 
   if(NumUnits >= UnitSpace)             // No more prealloced entries.
   {
@@ -474,10 +559,14 @@ NWErr Network::CreateUnit(unsigned long x,unsigned long y,int type,int binary,
 NWErr Network::DeleteUnit(unsigned long unit)
 {
   unsigned long   ix,jx;
+  NWErr           nwErr;
 
   if(unit >= NumUnits)                  // Illegal unit id.
     return(NW_ERR_BADPARAM);
 
+  if((nwErr = Thaw()) != NW_SUCCESS)    // Layout is about to be stale.
+    return(nwErr);
+
   if(UnitList[unit]->Type == UNIT_INPUT)
     NumInput--;
   else if(UnitList[unit]->Type == UNIT_OUTPUT)
@@ -492,20 +581,20 @@ NWErr Network::DeleteUnit(unsigned long unit)
     {
       memmove(&UnitList[ix]->InputUnits[jx],
               &UnitList[ix]->InputUnits[jx + 1],
-              (--UnitList[ix]->NumInput - jx));
+              (--UnitList[ix]->NumInput - jx) * sizeof(unsigned long));
       UnitList[ix]->InputUnits = (unsigned long *)realloc(UnitList[ix]->InputUnits,UnitList[ix]->NumInput * sizeof(unsigned long));
 
       memmove(&UnitList[ix]->InputWgts[jx],
               &UnitList[ix]->InputWgts[jx + 1],
-              (UnitList[ix]->NumInput - jx));
+              (UnitList[ix]->NumInput - jx) * sizeof(double));
       UnitList[ix]->InputWgts = (double *)realloc(UnitList[ix]->InputWgts,UnitList[ix]->NumInput * sizeof(double));
     }
   }
 
 // Remove the unit from the units list.
 
-  delete UnitList[unit]->InputUnits;
-  delete UnitList[unit]->InputWgts;
+  free(UnitList[unit]->InputUnits);
+  free(UnitList[unit]->InputWgts);
   if(UnitList[unit]->Type != UNIT_INTERNAL)
   {
     delete[] UnitList[unit]->IODef->Name;
@@ -542,6 +631,7 @@ NWErr Network::CreateConnection(unsigned long source,unsigned long dest)
 {
   void           *temp;
   unsigned long   ix;
+  NWErr           nwErr;
 
   if(source >= NumUnits || dest >= NumUnits)  // Illegal unit ids.
     return(NW_ERR_BADPARAM);
@@ -560,6 +650,9 @@ NWErr Network::CreateConnection(unsigned long source,unsigned long dest)
       break;
   }
 
+  if((nwErr = Thaw()) != NW_SUCCESS)    // Layout is about to be stale.
+    return(nwErr);
+
   if((temp = realloc(UnitList[dest]->InputUnits,(UnitList[dest]->NumInput + 1) * sizeof(unsigned long))) == NULL)
     return(NW_ERR_MEMORY);
   UnitList[dest]->InputUnits = (unsigned long *)temp;
@@ -598,6 +691,7 @@ NWErr Network::CreateConnection(unsigned long source,unsigned long dest)
 NWErr Network::DeleteConnection(unsigned long source,unsigned long dest)
 {
   unsigned long ix;
+  NWErr         nwErr;
 
   if(source >= NumUnits || dest >= NumUnits)  // Illegal unit id.
     return(NW_ERR_BADPARAM);
@@ -605,18 +699,225 @@ NWErr Network::DeleteConnection(unsigned long source,unsigned long dest)
   if((ix = ULongSearch(source,UnitList[dest]->NumInput,UnitList[dest]->InputUnits)) == (unsigned long)(-1))
     return(NW_ERR_NOTCONN);             // Units aren't connected.
 
+  if((nwErr = Thaw()) != NW_SUCCESS)    // Layout is about to be stale.
+    return(nwErr);
+
   memmove(&UnitList[dest]->InputUnits[ix],
           &UnitList[dest]->InputUnits[ix + 1],
-          --UnitList[dest]->NumInput - ix);
+          (--UnitList[dest]->NumInput - ix) * sizeof(unsigned long));
   UnitList[dest]->InputUnits = (unsigned long *)realloc(UnitList[dest]->InputUnits, UnitList[dest]->NumInput * sizeof(unsigned long));
   memmove(&UnitList[dest]->InputWgts[ix],
           &UnitList[dest]->InputWgts[ix + 1],
-          UnitList[dest]->NumInput - ix);
+          (UnitList[dest]->NumInput - ix) * sizeof(double));
   UnitList[dest]->InputWgts = (double *)realloc(UnitList[dest]->InputWgts, UnitList[dest]->NumInput * sizeof(double));
 
   return(NW_SUCCESS);                   // Successful operation.
 }
 
+struct NWWeak                           // Interconnection being ranked.
+{
+  double          Mag;                  // Magnitude of weight.
+  unsigned long   Pos;                  // Position in input list.
+};
+
+/*****************************************************************************
+  Function:   CompareMagnitudes()
+  Purpose:    This function compares two interconnections by the magnitude
+              of their weights, for qsort(), putting the weaker first.
+              Interconnections of equal magnitude are kept in order.
+  Parameters: const void *a             The first interconnection.
+              const void *b             The second.
+  Returns:    Less than, equal to, or greater than zero, as the first
+              interconnection comes before, with, or after the second.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int CompareMagnitudes(const void *a,const void *b)
+{
+  const NWWeak   *weak_a = (const NWWeak *)a;
+  const NWWeak   *weak_b = (const NWWeak *)b;
+
+  if(weak_a->Mag != weak_b->Mag)
+    return(weak_a->Mag < weak_b->Mag ? -1 : 1);
+  return(weak_a->Pos < weak_b->Pos ? -1 : weak_a->Pos > weak_b->Pos);
+}
+
+/*****************************************************************************
+  Function:   Network::Prune()
+  Purpose:    This function removes the network's weak interconnections:
+              those whose weights are smaller in magnitude than a
+              threshold, and, of each unit's interconnections, a given
+              fraction of the weakest.  Each unit's input list is compacted
+              in a single pass.  Internal units which are left feeding no
+              other unit, and so have no effect on the outputs, are then
+              removed, along with their own input lists, and the remaining
+              units are renumbered.  Input and output units are never
+              removed, and keep their order.  Bias weights are untouched.
+
+              Any training or execution state is released: SetupTrain() or
+              SetupExec() must be called again.
+  Parameters: double threshold          Weights smaller in magnitude than
+                                        this are removed (0 for none).
+              double fraction           Fraction (0 to 1) of each unit's
+                                        interconnections to be removed,
+                                        the weakest first (0 for none).
+              unsigned long *map        If not NULL, receives the new index
+                                        of each unit, by its old index, or
+                                        -1 if it was removed (NumUnits
+                                        entries, as NumUnits was before).
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::Prune(double threshold,double fraction,unsigned long *map)
+{
+  unsigned long   ix,jx,num,cut,head,tail,max_input,src;
+  unsigned long  *fanout;               // Units fed by each unit.
+  unsigned long  *renum;                // New index of each unit, or -1.
+  unsigned long  *dead;                 // Units removed, in order found.
+  NWWeak         *weak;                 // Input list being ranked.
+  char           *drop;                 // Inputs of a unit to be removed.
+  NWUnit         *cur;
+  NWErr           nwErr;
+
+  if(threshold < 0.0 || fraction < 0.0 || fraction > 1.0)
+    return(NW_ERR_BADPARAM);
+
+  if(NumUnits == 0)                     // No units in network.
+    return(NW_SUCCESS);
+
+  if((nwErr = Thaw()) != NW_SUCCESS)    // Layout is about to be stale.
+    return(nwErr);
+
+  for(ix = max_input = 0;ix < NumUnits;ix++)
+    if(UnitList[ix]->NumInput > max_input)
+      max_input = UnitList[ix]->NumInput;
+
+  fanout = renum = dead = NULL;
+  weak = NULL;
+  drop = NULL;
+  if((fanout = new unsigned long[NumUnits]) == NULL ||
+     (renum = new unsigned long[NumUnits]) == NULL ||
+     (dead = new unsigned long[NumUnits]) == NULL ||
+     (weak = new NWWeak[max_input + 1]) == NULL ||
+     (drop = new char[max_input + 1]) == NULL)
+  {
+    delete[] fanout;
+    delete[] renum;
+    delete[] dead;
+    delete[] weak;
+    delete[] drop;
+    return(NW_ERR_MEMORY);
+  }
+
+  EndTrain();                           // State is laid out by old lists.
+
+// Compact each unit's input list, dropping the interconnections below the
+//   threshold and the weakest fraction.  The list stays sorted.
+
+  for(ix = 0;ix < NumUnits;ix++)
+  {
+    cur = UnitList[ix];
+    if(cur->NumInput == 0)
+      continue;
+
+    for(jx = 0;jx < cur->NumInput;jx++)
+    {
+      weak[jx].Mag = fabs(cur->InputWgts[jx]);
+      weak[jx].Pos = jx;
+      drop[jx] = weak[jx].Mag < threshold;
+    }
+
+    cut = (unsigned long)(fraction * cur->NumInput);
+    if(cut > 0)
+    {
+      qsort(weak,cur->NumInput,sizeof(NWWeak),CompareMagnitudes);
+      for(jx = 0;jx < cut;jx++)
+        drop[weak[jx].Pos] = TRUE;
+    }
+
+    for(jx = num = 0;jx < cur->NumInput;jx++)
+      if(!drop[jx])
+      {
+        cur->InputUnits[num] = cur->InputUnits[jx];
+        cur->InputWgts[num]  = cur->InputWgts[jx];
+        num++;
+      }
+
+    cur->NumInput = num;
+    if(num == 0)                        // Nothing left.
+    {
+      free(cur->InputUnits);
+      free(cur->InputWgts);
+      cur->InputUnits = NULL;
+      cur->InputWgts  = NULL;
+    }
+  }
+
+// Find the internal units which feed no other unit.  Removing one may
+//   leave the units feeding it feeding nothing in turn.
+
+  memset(fanout,0,NumUnits * sizeof(unsigned long));
+  for(ix = 0;ix < NumUnits;ix++)
+    for(jx = 0;jx < UnitList[ix]->NumInput;jx++)
+      fanout[UnitList[ix]->InputUnits[jx]]++;
+
+  tail = 0;
+  for(ix = 0;ix < NumUnits;ix++)
+  {
+    renum[ix] = 0;
+    if(UnitList[ix]->Type == UNIT_INTERNAL && fanout[ix] == 0)
+      dead[tail++] = ix;
+  }
+
+  for(head = 0;head < tail;head++)
+  {
+    cur = UnitList[dead[head]];
+    renum[dead[head]] = (unsigned long)(-1);
+    for(jx = 0;jx < cur->NumInput;jx++)
+    {
+      src = cur->InputUnits[jx];
+      if(--fanout[src] == 0 && UnitList[src]->Type == UNIT_INTERNAL)
+        dead[tail++] = src;
+    }
+  }
+
+// Remove the dead units, and renumber the rest.  The numbering keeps the
+//   order of the units, so the input lists stay sorted.
+
+  for(ix = num = 0;ix < NumUnits;ix++)
+  {
+    cur = UnitList[ix];
+    if(renum[ix] == (unsigned long)(-1))
+    {
+      free(cur->InputUnits);
+      free(cur->InputWgts);
+      delete cur;
+      continue;
+    }
+
+    renum[ix] = num;
+    UnitList[num++] = cur;
+  }
+
+  for(ix = num;ix < NumUnits;ix++)
+    UnitList[ix] = NULL;
+
+  for(ix = 0;ix < num;ix++)
+    for(jx = 0;jx < UnitList[ix]->NumInput;jx++)
+      UnitList[ix]->InputUnits[jx] = renum[UnitList[ix]->InputUnits[jx]];
+
+  if(map != NULL)
+    memcpy(map,renum,NumUnits * sizeof(unsigned long));
+  NumUnits = num;
+
+  delete[] drop;
+  delete[] weak;
+  delete[] dead;
+  delete[] renum;
+  delete[] fanout;
+
+  return(NW_SUCCESS);                   // Successful operation.
+}
+
 /*****************************************************************************
   Function:   Network::SetupTrain()
   Purpose:    This function prepares the current network for training by
@@ -645,21 +946,26 @@ NWErr Network::SetupTrain(int accumulate,int momentum)
   if(accumulate && momentum)            // Can't accumulate *and* gain.
     return(NW_ERR_BADPARAM);
 
+  EndThreads();                         // Threads rely on Accum.
+
   if(Error != NULL)                     // Previously allocated; free it.
     delete[] Error;
   if(BackSeq != NULL)
     delete[] BackSeq;
+  Error = NULL;
+  BackSeq = NULL;
   if(Accum != NULL)
   {
-    for(ix = 0;ix < NumUnits;ix++)
-      delete[] Accum[ix];
+    delete[] Accum[0];
     delete[] Accum;
+    Accum = NULL;
   }
   if(Momentum != NULL)
   {
     for(ix = 0;ix < NumUnits;ix++)
       delete[] Momentum[ix];
     delete[] Momentum;
+    Momentum = NULL;
   }
 
   if((Error = new double[NumUnits]) == NULL)
@@ -667,34 +973,40 @@ NWErr Network::SetupTrain(int accumulate,int momentum)
   if((BackSeq = new unsigned long[NumUnits]) == NULL)
   {
     delete[] Error;
+    Error = NULL;
     return(NW_ERR_MEMORY);
   }
 
   if(accumulate)                        // Accumulate weights.
   {
+// The accumulated changes for all units are kept in a single block, each
+//   unit's followed by room for its bias weight's, so that the whole of it
+//   can be cleared, copied, or summed at once.
+
+    for(ix = num = 0;ix < NumUnits;ix++)
+      num += UnitList[ix]->NumInput + 1;
+
     if((Accum = new double *[NumUnits]) == NULL)
     {
       delete[] Error;
       delete[] BackSeq;
+      Error = NULL;
+      BackSeq = NULL;
       return(NW_ERR_MEMORY);
     }
-    for(ix = 0;ix < NumUnits;ix++)
+    if((Accum[0] = new double[num]) == NULL)
     {
-      num = UnitList[ix]->NumInput;
-      if(UnitList[ix]->Bias)            // Space for bias momentum.
-        num++;
-
-      if((Accum[ix] = new double[num]) == NULL)
-      {
-        delete[] Error;
-        delete[] BackSeq;
-        while(ix > 0)
-          delete[] Accum[--ix];
-        delete[] Accum;
-        return(NW_ERR_MEMORY);
-      }
-      memset(Accum[ix],0,num * sizeof(double));
+      delete[] Error;
+      delete[] BackSeq;
+      delete[] Accum;
+      Error = NULL;
+      BackSeq = NULL;
+      Accum = NULL;
+      return(NW_ERR_MEMORY);
     }
+    memset(Accum[0],0,num * sizeof(double));
+    for(ix = 1;ix < NumUnits;ix++)
+      Accum[ix] = Accum[ix - 1] + UnitList[ix - 1]->NumInput + 1;
   }
 
   else if(momentum)                     // Employ weight momentum.
@@ -703,6 +1015,8 @@ NWErr Network::SetupTrain(int accumulate,int momentum)
     {
       delete[] Error;
       delete[] BackSeq;
+      Error = NULL;
+      BackSeq = NULL;
       return(NW_ERR_MEMORY);
     }
     for(ix = 0;ix < NumUnits;ix++)
@@ -718,6 +1032,9 @@ NWErr Network::SetupTrain(int accumulate,int momentum)
         while(ix > 0)
           delete[] Momentum[--ix];
         delete[] Momentum;
+        Error = NULL;
+        BackSeq = NULL;
+        Momentum = NULL;
         return(NW_ERR_MEMORY);
       }
       memset(Momentum[ix],0,num * sizeof(double));
@@ -728,22 +1045,29 @@ NWErr Network::SetupTrain(int accumulate,int momentum)
   {
     delete[] Error;
     delete[] BackSeq;
+    Error = NULL;                       // Don't free them again.
+    BackSeq = NULL;
     if(accumulate)                      // Accumulate weights.
     {
-      for(ix = 0;ix < NumUnits;ix++)
-        delete[] Accum[ix];
+      delete[] Accum[0];
       delete[] Accum;
+      Accum = NULL;
     }
     else if(momentum)                   // Employ weight momentum.
     {
       for(ix = 0;ix < NumUnits;ix++)
         delete[] Momentum[ix];
       delete[] Momentum;
+      Momentum = NULL;
     }
 
     return(nwErr);
   }
 
+  if(ExecSeq != NULL)                   // Order was already computed.
+    for(ix = 0;ix < NumUnits;ix++)
+      BackSeq[NumUnits - 1 - ix] = ExecSeq[ix];
+
   return(NW_SUCCESS);
 }
 
@@ -759,6 +1083,8 @@ NWErr Network::EndTrain(void)
 {
   unsigned long ix;
 
+  EndThreads();                         // Stop training threads.
+
   if(Error != NULL)
   {
     delete[] Error;
@@ -772,8 +1098,7 @@ NWErr Network::EndTrain(void)
 
   if(Accum != NULL)                     // Free accumulated weight values.
   {
-    for(ix = 0;ix < NumUnits;ix++)
-      delete[] Accum[ix];
+    delete[] Accum[0];
     delete[] Accum;
     Accum = NULL;
   }
@@ -793,12 +1118,16 @@ NWErr Network::EndTrain(void)
 /*****************************************************************************
   Function:   Network::SetupExec()
   Purpose:    This function prepares the current network for execution.
+              Once prepared, the network may be run by several threads at
+              once through Execute(), each thread with its own NWContext.
   Parameters: None.
   Returns:    A NetWorks error value (0 on success).
 - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 NWErr Network::SetupExec(void)
 {
+  NWErr nwErr;
+
   if(NumUnits == 0)                     // No units in network.
     return(NW_SUCCESS);
 
@@ -806,6 +1135,7 @@ NWErr Network::SetupExec(void)
     delete[] Sum;
   if(ActLevel != NULL)
     delete[] ActLevel;
+  Sum = ActLevel = NULL;
 
   if((Sum = new double[NumUnits]) == NULL)
     return(NW_ERR_MEMORY);
@@ -813,10 +1143,23 @@ NWErr Network::SetupExec(void)
   if((ActLevel = new double[NumUnits]) == NULL)
   {
     delete[] Sum;
+    Sum = NULL;
     return(NW_ERR_MEMORY);
   }
   memset(ActLevel,0,NumUnits * sizeof(double));
 
+// Compute the processing order and compact layout now, rather than on the
+//   first forward pass.  A recursive network is not reported until
+//   ForwardPass() is called.
+
+  if((nwErr = Freeze()) == NW_ERR_MEMORY)
+  {
+    delete[] Sum;
+    delete[] ActLevel;
+    Sum = ActLevel = NULL;              // Don't free them again.
+    return(nwErr);
+  }
+
   return(NW_SUCCESS);                   // Successful operation.
 }
 
@@ -839,98 +1182,826 @@ NWErr Network::EndExec(void)
     delete[] ActLevel;
     ActLevel = NULL;
   }
+  FreeContext(&Batch);                  // Free batch state.
 
   return(NW_SUCCESS);
 }
 
 /*****************************************************************************
-  Function:   Network::SetInput()
-  Purpose:    This function sets the given input entry to the specified
-              value.
-  Parameters: unsigned long unit        The input unit to be set.
-              double value              The value to be applied.
+  Function:   Network::BuildPlan()
+  Purpose:    This function computes the order in which the units are to be
+              processed by a forward pass, so that every unit follows all of
+              the units from which it receives input.  Input units come
+              first, in order of their definition.  The order is kept until
+              the network's topology changes.
+
+              If BackSeq has been allocated, it is filled in with the same
+              order reversed, for use by the backward pass.
+  Parameters: None.
   Returns:    A NetWorks error value (0 on success).
 - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-NWErr Network::SetInput(unsigned long unit,double value)
+NWErr Network::BuildPlan(void)
 {
-  if(unit >= NumUnits)                  // Bad unit index.
-    return(NW_ERR_BADPARAM);
-  if(UnitList[unit]->Type != UNIT_INPUT)  // Not an input unit.
-    return(NW_ERR_NOTINPUT);
+  unsigned long   ix,jx,unit,head,tail,num_conn;
+  unsigned long  *pending;              // Unprocessed inputs of each unit.
+  unsigned long  *first;                // Start of each unit's dependents.
+  unsigned long  *next;                 // Dependents of each unit.
 
-// Truncate and scale input value.
+  DropPlan();                           // Discard any previous order.
 
-  if(value > UnitList[unit]->IODef->Max)
-    value = UnitList[unit]->IODef->Max;
-  else if(value < UnitList[unit]->IODef->Min)
-    value = UnitList[unit]->IODef->Min;
+  if(NumUnits == 0)                     // No units in network.
+    return(NW_SUCCESS);
 
-  value -= UnitList[unit]->IODef->Min;
-  value /= UnitList[unit]->IODef->Max - UnitList[unit]->IODef->Min;
+  for(ix = num_conn = 0;ix < NumUnits;ix++)
+    num_conn += UnitList[ix]->NumInput;
 
-  Sum[unit] = ActLevel[unit] = value;    // Apply input value.
+  if((ExecSeq = new unsigned long[NumUnits]) == NULL)
+    return(NW_ERR_MEMORY);
+  if((pending = new unsigned long[NumUnits]) == NULL)
+  {
+    DropPlan();
+    return(NW_ERR_MEMORY);
+  }
+  if((first = new unsigned long[NumUnits + 1]) == NULL)
+  {
+    delete[] pending;
+    DropPlan();
+    return(NW_ERR_MEMORY);
+  }
+  if((next = new unsigned long[num_conn + 1]) == NULL)
+  {
+    delete[] first;
+    delete[] pending;
+    DropPlan();
+    return(NW_ERR_MEMORY);
+  }
 
-  return(NW_SUCCESS);
-}
+// Invert the input lists, giving the units which depend upon each unit.
 
-/*****************************************************************************
-  Function:   Network::ReadOutput()
-  Purpose:    This function reads the given output entry.
-  Parameters: unsigned long unit        The output unit to be read.
-              double *value             The variable in which to store the
-                                        value.  The result will be correctly
-                                        scaled to the unit's output range.
-  Returns:    A NetWorks error value (0 on success).
-- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+  memset(first,0,(NumUnits + 1) * sizeof(unsigned long));
+  for(ix = 0;ix < NumUnits;ix++)
+    for(jx = 0;jx < UnitList[ix]->NumInput;jx++)
+      first[UnitList[ix]->InputUnits[jx] + 1]++;
+  for(ix = 0;ix < NumUnits;ix++)
+    first[ix + 1] += first[ix];
 
-NWErr Network::ReadOutput(unsigned long unit,double *value)
-{
-  if(unit >= NumUnits)                  // Bad unit index.
-    return(NW_ERR_BADPARAM);
-  if(UnitList[unit]->Type != UNIT_OUTPUT) // Not an output unit.
-    return(NW_ERR_NOTOUTPUT);
+  memcpy(pending,first,NumUnits * sizeof(unsigned long));
+  for(ix = 0;ix < NumUnits;ix++)
+    for(jx = 0;jx < UnitList[ix]->NumInput;jx++)
+      next[pending[UnitList[ix]->InputUnits[jx]]++] = ix;
 
-// Truncate and scale output value.
+// Seed the order with the input units, then with any other units which
+//   have no inputs.  Each unit is appended once its last input is placed.
 
-  *value = ActLevel[unit];
+  tail = 0;
+  for(ix = 0;ix < NumUnits;ix++)
+  {
+    pending[ix] = UnitList[ix]->NumInput;
+    if(UnitList[ix]->Type == UNIT_INPUT)
+      ExecSeq[tail++] = ix;
+  }
+  for(ix = 0;ix < NumUnits;ix++)
+    if(UnitList[ix]->Type != UNIT_INPUT && pending[ix] == 0)
+      ExecSeq[tail++] = ix;
 
-  if(!UnitList[unit]->Sigmoid)          // Does not use sigmoid fn.
-    *value += 0.5;
+  for(head = 0;head < tail;head++)
+  {
+    unit = ExecSeq[head];
+    for(jx = first[unit];jx < first[unit + 1];jx++)
+      if(--pending[next[jx]] == 0)      // All inputs of dependent placed.
+        ExecSeq[tail++] = next[jx];
+  }
 
-  *value *= UnitList[unit]->IODef->Max - UnitList[unit]->IODef->Min;
-  *value += UnitList[unit]->IODef->Min;
+  delete[] next;
+  delete[] first;
+  delete[] pending;
 
-  return(NW_SUCCESS);
+  if(tail < NumUnits)                   // Some units could not be placed.
+  {
+    DropPlan();
+    return(NW_ERR_RECURSIVE);           // Net has recursive unit chain.
+  }
+
+  if(BackSeq != NULL)                   // Store back-pass sequence.
+    for(ix = 0;ix < NumUnits;ix++)
+      BackSeq[NumUnits - 1 - ix] = ExecSeq[ix];
+
+  return(NW_SUCCESS);                   // Successful operation.
 }
 
 /*****************************************************************************
-  Function:   Network::ApplyTarget()
-  Purpose:    This function applies an output target value to the given unit,
-              thus setting the unit's error value.
-  Parameters: unsigned long unit        The output unit to be evaluated.
-              double target             The target value (in the range of
-                                        [Min, Max]) for the unit.
-  Returns:    A NetWorks error value (0 on success).
+  Function:   Network::DropPlan()
+  Purpose:    This function discards the unit processing order.  It is
+              called (by way of Thaw()) whenever units or interconnections
+              are added or removed.
+  Parameters: None.
+  Returns:    Nothing.
 - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-NWErr Network::ApplyTarget(unsigned long unit,double target)
+void Network::DropPlan(void)
 {
-  if(unit >= NumUnits)                  // Bad unit index.
-    return(NW_ERR_BADPARAM);
-  if(UnitList[unit]->Type != UNIT_OUTPUT) // Not an output unit.
-    return(NW_ERR_NOTOUTPUT);
+  if(!InImage(ExecSeq))                 // Mapped order is not freed.
+    delete[] ExecSeq;
+  ExecSeq = NULL;
+}
+
+struct NWInput                          // Interconnection being sorted.
+{
+  unsigned long   Src;                  // Source unit.
+  double          Wgt;                  // Interconnection weight.
+};
+
+/*****************************************************************************
+  Function:   CompareInputs()
+  Purpose:    This function compares two interconnections by source unit,
+              for qsort().
+  Parameters: const void *a             The first interconnection.
+              const void *b             The second.
+  Returns:    Less than, equal to, or greater than zero, as the first
+              interconnection's source is less than, equal to, or greater
+              than the second's.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int CompareInputs(const void *a,const void *b)
+{
+  unsigned long   src_a = ((const NWInput *)a)->Src;
+  unsigned long   src_b = ((const NWInput *)b)->Src;
+
+  return(src_a < src_b ? -1 : src_a > src_b);
+}
+
+/*****************************************************************************
+  Function:   Network::Reorder()
+  Purpose:    This function renumbers the units in the order in which they
+              are processed: the input units first, in order of their
+              definition, then the internal units, breadth first from the
+              inputs, so that each unit follows all of the units from which
+              it receives input, and the output units last, in order of
+              their definition.  Each unit's input list is renumbered to
+              match and sorted again.  The units a unit takes input from
+              then lie close together, and often in runs, so that the
+              passes gather their activation levels from a few cache lines
+              rather than from all over the network, and a fully
+              interconnected layer becomes a dense group (see FindLayers())
+              even if its units were not defined in order.  Saving the
+              network saves the new numbering.
+
+              The order in which the input and output units are defined is
+              kept, so that a program which addresses them through ExecSeq
+              and OutputUnits is not affected; one which keeps its own unit
+              indices must translate them through the map.  Any training or
+              execution state is released: SetupTrain() or SetupExec() must
+              be called again.
+  Parameters: unsigned long *map        If not NULL, receives the new index
+                                        of each unit, by its old index
+                                        (NumUnits entries).
+  Returns:    A NetWorks error value (0 on success).  NW_ERR_RECURSIVE is
+              returned, and the network left as it was, if the network
+              contains a recursive unit chain.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::Reorder(unsigned long *map)
+{
+  unsigned long   ix,jx,num,max_input;
+  unsigned long  *order;                // Old index of each unit, by new.
+  unsigned long  *renum;                // New index of each unit, by old.
+  NWUnit        **units;                // Units, by new index.
+  NWInput        *conn;                 // Input list being sorted.
+  NWUnit         *cur;
+  NWErr           nwErr;
+
+  if(NumUnits == 0)                     // No units in network.
+    return(NW_SUCCESS);
+
+  if((nwErr = Thaw()) != NW_SUCCESS ||  // Layout is about to be stale.
+     (nwErr = BuildPlan()) != NW_SUCCESS)
+    return(nwErr);
+
+  for(ix = max_input = 0;ix < NumUnits;ix++)
+    if(UnitList[ix]->NumInput > max_input)
+      max_input = UnitList[ix]->NumInput;
+
+  order = renum = NULL;
+  units = NULL;
+  conn  = NULL;
+  if((order = new unsigned long[NumUnits]) == NULL ||
+     (renum = new unsigned long[NumUnits]) == NULL ||
+     (units = new NWUnit *[NumUnits]) == NULL ||
+     (conn = new NWInput[max_input + 1]) == NULL)
+  {
+    delete[] order;
+    delete[] renum;
+    delete[] units;
+    DropPlan();
+    return(NW_ERR_MEMORY);
+  }
+
+// The processing order puts the input units first, in order of definition,
+//   and then places each unit as soon as its last input is placed.  Output
+//   units feed no other units, so moving them to the end keeps the order
+//   valid.
+
+  for(ix = num = 0;ix < NumUnits;ix++)
+    if(UnitList[ExecSeq[ix]]->Type != UNIT_OUTPUT)
+      order[num++] = ExecSeq[ix];
+  for(ix = 0;ix < NumUnits;ix++)
+    if(UnitList[ix]->Type == UNIT_OUTPUT)
+      order[num++] = ix;
+  for(ix = 0;ix < NumUnits;ix++)
+    renum[order[ix]] = ix;
+
+  EndTrain();                           // State is laid out by old index.
+  DropPlan();                           // So is the processing order.
+
+  for(ix = 0;ix < NumUnits;ix++)        // Renumber each unit's inputs.
+  {
+    cur = UnitList[ix];
+    for(jx = 0;jx < cur->NumInput;jx++)
+    {
+      conn[jx].Src = renum[cur->InputUnits[jx]];
+      conn[jx].Wgt = cur->InputWgts[jx];
+    }
+    qsort(conn,cur->NumInput,sizeof(NWInput),CompareInputs);
+    for(jx = 0;jx < cur->NumInput;jx++)
+    {
+      cur->InputUnits[jx] = conn[jx].Src;
+      cur->InputWgts[jx]  = conn[jx].Wgt;
+    }
+  }
+
+  for(ix = 0;ix < NumUnits;ix++)        // Renumber the units themselves.
+    units[ix] = UnitList[order[ix]];
+  memcpy(UnitList,units,NumUnits * sizeof(NWUnit *));
+
+  if(map != NULL)
+    memcpy(map,renum,NumUnits * sizeof(unsigned long));
+
+  delete[] conn;
+  delete[] units;
+  delete[] renum;
+  delete[] order;
+
+  return(NW_SUCCESS);                   // Successful operation.
+}
+
+/*****************************************************************************
+  Function:   Network::Freeze()
+  Purpose:    This function builds the network's compact layout: the input
+              lists and weights of all units are gathered into single
+              contiguous arrays (indexed through RowStart), and the unit
+              flags, bias weights, and input/output ranges are gathered into
+              arrays of their own.  The units' own input lists are released
+              and pointed into the compact arrays.  The processing order is
+              computed as well, if it is not current, and the output units
+              are listed in order of their definition (the input units lead
+              the processing order, in order of their definition).
+
+              The layout is released by Thaw(), which is done automatically
+              before units or interconnections are added or removed.
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::Freeze(void)
+{
+  unsigned long   ix,num_conn,num_out;
+  NWUnit         *cur;
+  NWErr           nwErr;
+
+  if(Frozen || NumUnits == 0)           // Nothing to do.
+    return(NW_SUCCESS);
+
+  if(ExecSeq == NULL && (nwErr = BuildPlan()) != NW_SUCCESS)
+    return(nwErr);
+
+  for(ix = num_conn = 0;ix < NumUnits;ix++)
+    num_conn += UnitList[ix]->NumInput;
+
+  if((RowStart = new unsigned long[NumUnits + 1]) == NULL ||
+     (SrcIdx = new unsigned long[num_conn]) == NULL ||
+     (Wgt = new double[num_conn]) == NULL ||
+     (BiasWgts = new double[NumUnits]) == NULL ||
+     (UnitFlags = new unsigned char[NumUnits]) == NULL ||
+     (IOMin = new double[NumUnits]) == NULL ||
+     (IOMax = new double[NumUnits]) == NULL ||
+     (OutputUnits = new unsigned long[NumOutput + 1]) == NULL)
+  {
+    FreeLayout();
+    return(NW_ERR_MEMORY);
+  }
+
+  RowStart[0] = 0;
+  for(ix = num_out = 0;ix < NumUnits;ix++)  // Gather each unit.
+  {
+    cur = UnitList[ix];
+    RowStart[ix + 1] = RowStart[ix] + cur->NumInput;
+
+    if(cur->NumInput)                   // Move input list into layout.
+    {
+      memcpy(&SrcIdx[RowStart[ix]],cur->InputUnits,cur->NumInput * sizeof(unsigned long));
+      memcpy(&Wgt[RowStart[ix]],cur->InputWgts,cur->NumInput * sizeof(double));
+      free(cur->InputUnits);
+      free(cur->InputWgts);
+    }
+    cur->InputUnits = &SrcIdx[RowStart[ix]];
+    cur->InputWgts  = &Wgt[RowStart[ix]];
+
+    BiasWgts[ix] = cur->BiasWgt;
+    GatherUnit(ix,&num_out);
+  }
+
+  Frozen = TRUE;
+
+  if((nwErr = FindLayers()) != NW_SUCCESS ||
+     (nwErr = SetPrecision(Precision)) != NW_SUCCESS)
+  {
+    Thaw();
+    return(nwErr);
+  }
+
+  return(NW_SUCCESS);                   // Successful operation.
+}
+
+/*****************************************************************************
+  Function:   Network::Thaw()
+  Purpose:    This function releases the network's compact layout, giving
+              each unit its own input list again and restoring the units'
+              bias weights.  The processing order is discarded.
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::Thaw(void)
+{
+  unsigned long   ix,jx;
+  NWUnit         *cur;
+
+  EndThreads();                         // Threads rely on the layout.
+  EndCheckpoint();                      // So does the checkpoint writer.
+  FreeWeightLog();                      // Weights change shape.
+  DropPlan();                           // Processing order is now stale.
+  FreeContext(&Batch);                  // Sized for the old network.
+
+  if(!Frozen)                           // No compact layout.
+    return(NW_SUCCESS);
+
+  for(ix = 0;ix < NumUnits;ix++)        // Scatter each unit.
+  {
+    cur = UnitList[ix];
+
+    if(cur->NumInput == 0)
+    {
+      cur->InputUnits = NULL;
+      cur->InputWgts  = NULL;
+      continue;
+    }
+
+    if((cur->InputUnits = (unsigned long *)malloc(cur->NumInput * sizeof(unsigned long))) == NULL ||
+       (cur->InputWgts = (double *)malloc(cur->NumInput * sizeof(double))) == NULL)
+    {
+      free(cur->InputUnits);
+      for(jx = 0;jx <= ix;jx++)         // Point back into the layout.
+      {
+        if(jx < ix && UnitList[jx]->NumInput)
+        {
+          free(UnitList[jx]->InputUnits);
+          free(UnitList[jx]->InputWgts);
+        }
+        UnitList[jx]->InputUnits = &SrcIdx[RowStart[jx]];
+        UnitList[jx]->InputWgts  = &Wgt[RowStart[jx]];
+      }
+      return(NW_ERR_MEMORY);
+    }
+
+    memcpy(cur->InputUnits,&SrcIdx[RowStart[ix]],cur->NumInput * sizeof(unsigned long));
+    memcpy(cur->InputWgts,&Wgt[RowStart[ix]],cur->NumInput * sizeof(double));
+  }
+
+  for(ix = 0;ix < NumUnits;ix++)        // Restore bias weights.
+    UnitList[ix]->BiasWgt = BiasWgts[ix];
+
+  FreeLayout();
+  Frozen = FALSE;
+  FreeImage();                          // Nothing points into it now.
+
+  return(NW_SUCCESS);                   // Successful operation.
+}
+
+/*****************************************************************************
+  Function:   Network::FreeLayout()
+  Purpose:    This function frees the arrays of the compact layout.  It does
+              not touch the units themselves.  Arrays within a mapped image
+              are left to FreeImage().
+  Parameters: None.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::FreeLayout(void)
+{
+  if(!InImage(RowStart))
+    delete[] RowStart;
+  if(!InImage(SrcIdx))
+    delete[] SrcIdx;
+  if(!InImage(Wgt))
+    delete[] Wgt;
+  if(!InImage(BiasWgts))
+    delete[] BiasWgts;
+  if(!InImage(WgtF))
+    delete[] WgtF;
+  if(!InImage(UnitFlags))
+    delete[] UnitFlags;
+  if(!InImage(IOMin))
+    delete[] IOMin;
+  if(!InImage(IOMax))
+    delete[] IOMax;
+  if(!InImage(OutputUnits))
+    delete[] OutputUnits;
+  FreeSlices();                         // Clears the groups' slices.
+  delete[] Layers;
+
+  RowStart = SrcIdx = NULL;
+  Wgt = BiasWgts = IOMin = IOMax = NULL;
+  WgtF = NULL;
+  UnitFlags = NULL;
+  Layers = NULL;
+  NumLayers = 0;
+  OutputUnits = NULL;
+}
+
+/*****************************************************************************
+  Function:   Network::SetPrecision()
+  Purpose:    This function chooses the precision of the network's
+              arithmetic.  In single or mixed precision the passes read the
+              interconnection weights from WgtF, a single-precision copy of
+              Wgt, which halves the memory traffic of a large network; in
+              single precision the weighted sums are formed in single
+              precision too, and in mixed precision in double precision.
+              Wgt itself stays the master copy: weight changes are made to
+              it, and carried over to WgtF as they are made.  The bias
+              weights, activation levels and error values stay double.
+              The precision is kept while the network is open, and an image
+              saved in single or mixed precision holds its weights in single
+              precision (see image.cpp).  A checkpoint still being written
+              is finished first.
+  Parameters: int prec                  The precision (PREC_xxx).
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::SetPrecision(int prec)
+{
+  if(prec != PREC_DOUBLE && prec != PREC_SINGLE && prec != PREC_MIXED)
+    return(NW_ERR_BADPARAM);
+
+  EndCheckpoint();                      // Its writer reads WgtF.
+  Precision = prec;
+  if(!Frozen)                           // Copy is made by Freeze().
+    return(NW_SUCCESS);
+
+  if(prec == PREC_DOUBLE)               // Copy no longer needed.
+  {
+    if(WgtF != NULL)
+    {
+      if(!InImage(WgtF))
+        delete[] WgtF;
+      WgtF = NULL;
+      return(SliceWeights());           // Slices held its values.
+    }
+  }
+  else if(WgtF == NULL)                 // Make the copy.
+  {
+    if((WgtF = new float[RowStart[NumUnits] + 1]) == NULL)
+      return(NW_ERR_MEMORY);
+    SyncWeights(0,RowStart[NumUnits]);
+    return(SliceWeights());             // Slices now take WgtF.
+  }
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::SyncWeights()
+  Purpose:    This function copies a run of the interconnection weights to
+              their single-precision copy, if there is one, and to the
+              slices of the sparse groups (see SyncSlices()).  It must be
+              called whenever weights in Wgt are changed other than by the
+              network's own training functions.
+  Parameters: unsigned long first       First weight (index into Wgt).
+              unsigned long num         Number of weights.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::SyncWeights(unsigned long first,unsigned long num)
+{
+  unsigned long   ix;
+
+  if(WgtF != NULL)                      // Single-precision copy.
+    for(ix = first;ix < first + num;ix++)
+      WgtF[ix] = (float)Wgt[ix];
+
+  SyncSlices(first,num);                // Slices take WgtF, if any.
+}
+
+/*****************************************************************************
+  Function:   Network::SetSigmoid()
+  Purpose:    This function chooses how the sigmoid function of the units'
+              weighted sums is computed (see NWSigmoid()): exactly, with
+              the C library, or by one of two faster approximations.  The
+              derivative used in training is taken from the activation
+              levels themselves, so it always matches the function used.
+              The choice is kept until it is changed again, even if another
+              network is opened.
+  Parameters: int mode                  How to compute it (SIG_xxx).
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::SetSigmoid(int mode)
+{
+  if(mode != SIG_EXACT && mode != SIG_POLY && mode != SIG_TABLE)
+    return(NW_ERR_BADPARAM);
+
+  SigmoidMode = mode;
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::GatherUnit()
+  Purpose:    This function fills in a unit's entries in the per-unit arrays
+              of the compact layout which are derived from the unit itself:
+              UnitFlags, IOMin and IOMax, and (for an output unit)
+              OutputUnits.  The unit's input list must already be in place.
+  Parameters: unsigned long unit        Index of unit.
+              unsigned long *num_out    Number of output units listed so
+                                        far; updated.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::GatherUnit(unsigned long unit,unsigned long *num_out)
+{
+  NWUnit         *cur = UnitList[unit];
+
+  UnitFlags[unit] = 0;
+  if(cur->Type == UNIT_INPUT)
+    UnitFlags[unit] |= UFLAG_INPUT;
+  else if(cur->Type == UNIT_OUTPUT)
+  {
+    OutputUnits[(*num_out)++] = unit;
+    UnitFlags[unit] |= UFLAG_OUTPUT;
+    if(!cur->Sigmoid)
+      UnitFlags[unit] |= UFLAG_LINEAR;
+  }
+  if(cur->Bias)
+    UnitFlags[unit] |= UFLAG_BIAS;
+  if(cur->Binary)
+    UnitFlags[unit] |= UFLAG_BINARY;
+  if(cur->NumInput &&                   // Inputs are sorted and distinct.
+     cur->InputUnits[cur->NumInput - 1] - cur->InputUnits[0] == cur->NumInput - 1)
+    UnitFlags[unit] |= UFLAG_DENSE;
+
+  if(cur->IODef != NULL)                // Input or output unit.
+  {
+    IOMin[unit] = cur->IODef->Min;
+    IOMax[unit] = cur->IODef->Max;
+  }
+  else
+    IOMin[unit] = IOMax[unit] = 0.0;
+}
+
+/*****************************************************************************
+  Function:   Network::UnitIO()
+  Purpose:    This function returns the flags and the input/output range of
+              a unit, from the compact layout if the network is frozen, and
+              otherwise from the unit itself.  SetInput(), ReadOutput() and
+              ApplyTarget() therefore work on a network which can't be
+              frozen (a recursive one), as they did before the layout.
+  Parameters: unsigned long unit        Index of unit.
+              double *min               Receives the least value.
+              double *max               Receives the greatest value.
+  Returns:    The unit's flags (only UFLAG_INPUT, UFLAG_OUTPUT and
+              UFLAG_LINEAR are certain to be set if the network isn't
+              frozen).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+int Network::UnitIO(unsigned long unit,double *min,double *max) const
+{
+  NWUnit         *cur;
+  int             flags = 0;
+
+  if(Frozen)
+  {
+    *min = IOMin[unit];
+    *max = IOMax[unit];
+    return(UnitFlags[unit]);
+  }
+
+  cur = UnitList[unit];
+  if(cur->Type == UNIT_INPUT)
+    flags |= UFLAG_INPUT;
+  else if(cur->Type == UNIT_OUTPUT)
+  {
+    flags |= UFLAG_OUTPUT;
+    if(!cur->Sigmoid)
+      flags |= UFLAG_LINEAR;
+  }
+
+  if(cur->IODef != NULL)                // Input or output unit.
+  {
+    *min = cur->IODef->Min;
+    *max = cur->IODef->Max;
+  }
+  else
+    *min = *max = 0.0;
+
+  return(flags);
+}
+
+/*****************************************************************************
+  Function:   Network::FindLayers()
+  Purpose:    This function divides the processing sequence into groups of
+              units.  A run of consecutive units which all take input from
+              the same run of units -- a fully interconnected layer -- forms
+              a dense group, whose weights are a row-major matrix within Wgt
+              and which can be processed with matrix kernels.  The remaining
+              units form sparse groups, processed one unit at a time or a
+              slice at a time (see BuildSlices()).  A sparse group only
+              holds units at the same level (distance from the inputs), so
+              no unit takes input from its own group.
+              The network must be frozen.
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::FindLayers(void)
+{
+  unsigned long   ix,jx,unit,num,src,cnt;
+  unsigned long  *level;                // Level of each unit.
+  NWLayer        *cur;
+
+  delete[] Layers;
+  NumLayers = 0;
+
+  if((Layers = new NWLayer[NumUnits - NumInput + 1]) == NULL)
+    return(NW_ERR_MEMORY);
+  if((level = new unsigned long[NumUnits]) == NULL)
+  {
+    delete[] Layers;
+    Layers = NULL;
+    return(NW_ERR_MEMORY);
+  }
+
+  for(ix = 0;ix < NumUnits;ix++)        // Each unit follows its inputs.
+  {
+    unit = ExecSeq[ix];
+    level[unit] = 0;
+    for(jx = RowStart[unit];jx < RowStart[unit + 1];jx++)
+      if(level[SrcIdx[jx]] >= level[unit])
+        level[unit] = level[SrcIdx[jx]] + 1;
+  }
+
+  for(ix = NumInput;ix < NumUnits;ix += cnt)
+  {
+    unit = ExecSeq[ix];
+    num  = RowStart[unit + 1] - RowStart[unit];
+    cnt  = 1;
+
+    if(UnitFlags[unit] & UFLAG_DENSE)   // Look for units sharing the inputs.
+    {
+      src = SrcIdx[RowStart[unit]];
+      while(ix + cnt < NumUnits && ExecSeq[ix + cnt] == unit + cnt &&
+            (UnitFlags[unit + cnt] & UFLAG_DENSE) &&
+            RowStart[unit + cnt + 1] - RowStart[unit + cnt] == num &&
+            SrcIdx[RowStart[unit + cnt]] == src)
+        cnt++;
+
+      if(cnt > 1)                       // A dense group.
+      {
+        cur = &Layers[NumLayers++];
+        cur->Seq    = ix;
+        cur->Num    = cnt;
+        cur->Src    = src;
+        cur->NumSrc = num;
+        cur->Dense  = TRUE;
+        cur->Slice  = cur->NumSlice = 0;
+        continue;
+      }
+    }
+
+    if(NumLayers && !Layers[NumLayers - 1].Dense &&
+       level[ExecSeq[ix - 1]] == level[unit])
+      Layers[NumLayers - 1].Num++;      // Extend the sparse group.
+    else
+    {
+      cur = &Layers[NumLayers++];
+      cur->Seq    = ix;
+      cur->Num    = 1;
+      cur->Src    = cur->NumSrc = 0;
+      cur->Dense  = FALSE;
+      cur->Slice  = cur->NumSlice = 0;
+    }
+  }
+
+  delete[] level;
+  return(BuildSlices());
+}
+
+/*****************************************************************************
+  Function:   Network::SetInput()
+  Purpose:    This function sets the given input entry to the specified
+              value.
+  Parameters: unsigned long unit        The input unit to be set.
+              double value              The value to be applied.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::SetInput(unsigned long unit,double value)
+{
+  double min,max;
+
+  if(unit >= NumUnits)                  // Bad unit index.
+    return(NW_ERR_BADPARAM);
+  if(!(UnitIO(unit,&min,&max) & UFLAG_INPUT)) // Not an input unit.
+    return(NW_ERR_NOTINPUT);
+
+// Truncate and scale input value.
+
+  if(value > max)
+    value = max;
+  else if(value < min)
+    value = min;
+
+  value -= min;
+  value /= max - min;
+
+  Sum[unit] = ActLevel[unit] = value;    // Apply input value.
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::ReadOutput()
+  Purpose:    This function reads the given output entry.
+  Parameters: unsigned long unit        The output unit to be read.
+              double *value             The variable in which to store the
+                                        value.  The result will be correctly
+                                        scaled to the unit's output range.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::ReadOutput(unsigned long unit,double *value)
+{
+  double min,max;
+  int    flags;
+
+  if(unit >= NumUnits)                  // Bad unit index.
+    return(NW_ERR_BADPARAM);
+  flags = UnitIO(unit,&min,&max);
+  if(!(flags & UFLAG_OUTPUT))           // Not an output unit.
+    return(NW_ERR_NOTOUTPUT);
+
+// Truncate and scale output value.
+
+  *value = ActLevel[unit];
+
+  if(flags & UFLAG_LINEAR)              // Does not use sigmoid fn.
+    *value += 0.5;
+
+  *value *= max - min;
+  *value += min;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::ApplyTarget()
+  Purpose:    This function applies an output target value to the given unit,
+              thus setting the unit's error value.
+  Parameters: unsigned long unit        The output unit to be evaluated.
+              double target             The target value (in the range of
+                                        [Min, Max]) for the unit.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::ApplyTarget(unsigned long unit,double target)
+{
+  double min,max;
+  int    flags;
+
+  if(unit >= NumUnits)                  // Bad unit index.
+    return(NW_ERR_BADPARAM);
+  flags = UnitIO(unit,&min,&max);
+  if(!(flags & UFLAG_OUTPUT))           // Not an output unit.
+    return(NW_ERR_NOTOUTPUT);
 
 // Truncate and scale target output value.
 
-  if(target > UnitList[unit]->IODef->Max)
-    target = UnitList[unit]->IODef->Max;
-  else if(target < UnitList[unit]->IODef->Min)
-    target = UnitList[unit]->IODef->Min;
-  target -= UnitList[unit]->IODef->Min;
-  target /= UnitList[unit]->IODef->Max - UnitList[unit]->IODef->Min;
+  if(target > max)
+    target = max;
+  else if(target < min)
+    target = min;
+  target -= min;
+  target /= max - min;
 
-  if(!UnitList[unit]->Sigmoid)          // Doesn't use the sigmoid function.
+  if(flags & UFLAG_LINEAR)              // Doesn't use the sigmoid function.
     target -= 0.5;
 
   Error[unit] = target - ActLevel[unit];  // Compute error value.
@@ -949,85 +2020,625 @@ NWErr Network::ApplyTarget(unsigned long unit,double target)
 
 NWErr Network::ForwardPass(void)
 {
-  unsigned long   ix,jx;
-  unsigned long   num_processed;        // Count of units done this iter.
-  unsigned long   tot_processed = 0;    // Total # of units processed.
+  NWErr           nwErr;
 
   if(NumUnits == 0)                     // No units.
     return(NW_SUCCESS);
 
-  for(ix = 0;ix < NumUnits;ix++)        // Reset "processed" flag.
+  if(!Frozen)                           // Topology changed; redo layout.
   {
-    if(UnitList[ix]->Type == UNIT_INPUT)  // Input unit.
+    if((nwErr = Freeze()) != NW_SUCCESS)
     {
-      UnitList[ix]->Flag1 = TRUE;       // It has been processed.
-      tot_processed++;
-      if(BackSeq != NULL)               // Store back-pass sequence.
-        BackSeq[ix] = NumUnits - tot_processed;
+      if(nwErr == NW_ERR_RECURSIVE)     // Net has recursive unit chain.
+      {
+        memset(Sum,0,NumUnits * sizeof(double));
+        memset(ActLevel,0,NumUnits * sizeof(double));
+      }
+      return(nwErr);
+    }
+  }
+
+  Propagate(Sum,ActLevel,1);
+
+  return(NW_SUCCESS);                   // Successful operation.
+}
+
+/*****************************************************************************
+  Function:   Network::ForwardBatch()
+  Purpose:    This function performs a forward pass on each of a number of
+              sets of input values, and reads the resulting output values.
+              The whole batch passes through the network at once, so each
+              unit's weights are loaded once per batch rather than once per
+              sample.  ForwardBatch() uses its own activation levels; Sum and
+              ActLevel are left alone, and SetupExec() need not be called.
+              It is Execute() with the network's own context, and so is
+              not to be called by more than one thread at once.
+  Parameters: unsigned long num         Number of samples.
+              const double *input       Input values; NumInput values for
+                                        each sample, in order of the input
+                                        units' definition, as for SetInput().
+              double *output            Receives the output values;
+                                        NumOutput values for each sample, in
+                                        order of the output units'
+                                        definition, as for ReadOutput().
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::ForwardBatch(unsigned long num,const double *input,
+                            double *output)
+{
+  NWErr           nwErr;
+
+  if(NumUnits == 0 || num == 0)         // Nothing to do.
+    return(NW_SUCCESS);
+
+  if(!Frozen && (nwErr = Freeze()) != NW_SUCCESS)
+    return(nwErr);
+
+  return(Execute(&Batch,num,input,output));
+}
+
+/*****************************************************************************
+  Function:   Network::Execute()
+  Purpose:    This function performs a forward pass on each of a number of
+              sets of input values, as ForwardBatch() does, but keeps the
+              activation levels in the given context.  The network itself
+              is only read, so any number of threads may run it at once,
+              each with a context of its own, provided that nothing changes
+              the network meanwhile.  The network must have been prepared
+              with SetupExec().
+  Parameters: NWContext *ctx            Context to work in; it is enlarged if
+                                        need be, and made afresh if units
+                                        have been added or deleted since it
+                                        was last used.
+              unsigned long num         Number of samples.
+              const double *input       Input values, as for ForwardBatch().
+              double *output            Receives the output values, as for
+                                        ForwardBatch().
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::Execute(NWContext *ctx,unsigned long num,const double *input,
+                       double *output) const
+{
+  NWErr           nwErr;
+
+  if(NumUnits == 0 || num == 0)         // Nothing to do.
+    return(NW_SUCCESS);
+  if(!Frozen)                           // Layout not built.
+    return(NW_ERR_NOTREADY);
+
+  if((nwErr = SetupContext(ctx,num,FALSE)) != NW_SUCCESS)
+    return(nwErr);
+
+  ScaleInput(ctx->Act,num,input);
+  Propagate(NULL,ctx->Act,num);
+  ScaleOutput(ctx->Act,num,output);
+
+  return(NW_SUCCESS);                   // Successful operation.
+}
+
+/*****************************************************************************
+  Function:   Network::TrainBatch()
+  Purpose:    This function trains the network on a batch of samples: the
+              whole batch is passed forward, the errors of every sample are
+              passed back, and the weight changes for all of the samples are
+              accumulated and then applied at once.  The network must have
+              been set up with SetupTrain(TRUE,FALSE).  Like ForwardBatch(),
+              TrainBatch() uses its own activation levels and error values.
+              If SetupThreads() has started a pool of threads, the batch is
+              split among them (see TrainParallel()).
+  Parameters: unsigned long num         Number of samples.
+              const double *input       Input values, as for ForwardBatch().
+              const double *target      Target output values; NumOutput
+                                        values for each sample, in order of
+                                        the output units' definition, as for
+                                        ApplyTarget().
+              const double *eta         Learning parameter for each sample.
+              double *sq_err            If not NULL, the sum of the squared
+                                        output errors of the batch (before
+                                        training) is added to it.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::TrainBatch(unsigned long num,const double *input,
+                          const double *target,const double *eta,
+                          double *sq_err)
+{
+  double  err;
+  NWErr   nwErr;
+
+  if(NumUnits == 0 || num == 0)         // Nothing to do.
+    return(NW_SUCCESS);
+  if(Accum == NULL)                     // Not accumulating.
+    return(NW_ERR_BADPARAM);
+
+  if(!Frozen && (nwErr = Freeze()) != NW_SUCCESS)
+    return(nwErr);
+  if(Pool != NULL)                      // Split among threads.
+    return(TrainParallel(num,input,target,eta,sq_err));
+  if((nwErr = SetupContext(&Batch,num,TRUE)) != NW_SUCCESS)
+    return(nwErr);
+
+  ScaleInput(Batch.Act,num,input);
+  Propagate(NULL,Batch.Act,num);
+  err = ApplyTargets(Batch.Act,Batch.Err,num,target);
+  BackPropagate(Batch.Act,Batch.Err,num,eta,Accum);
+
+  if(sq_err != NULL)
+    *sq_err += err;
+
+  return(ApplyAccum());
+}
+
+/*****************************************************************************
+  Function:   Network::ScaleInput()
+  Purpose:    This function truncates and scales the input values of a batch
+              of samples, as SetInput() does, and applies them to the input
+              units.  The network must be frozen.
+  Parameters: double *act               Activation levels; one row of
+                                        NumUnits values for each sample.
+              unsigned long num         Number of samples.
+              const double *input       Input values; NumInput values for
+                                        each sample.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::ScaleInput(double *act,unsigned long num,
+                         const double *input) const
+{
+  unsigned long   bx,ix,unit;
+  double          value;
+
+  for(bx = 0;bx < num;bx++,act += NumUnits,input += NumInput)
+  {
+    for(ix = 0;ix < NumInput;ix++)      // Input units lead the sequence.
+    {
+      unit  = ExecSeq[ix];
+      value = input[ix];
+
+      if(value > IOMax[unit])
+        value = IOMax[unit];
+      else if(value < IOMin[unit])
+        value = IOMin[unit];
+
+      act[unit] = (value - IOMin[unit]) / (IOMax[unit] - IOMin[unit]);
+    }
+  }
+}
+
+/*****************************************************************************
+  Function:   Network::ScaleOutput()
+  Purpose:    This function reads the output values of a batch of samples,
+              scaled to the output units' ranges as ReadOutput() does.
+              The network must be frozen.
+  Parameters: const double *act         Activation levels; one row of
+                                        NumUnits values for each sample.
+              unsigned long num         Number of samples.
+              double *output            Receives the output values;
+                                        NumOutput values for each sample.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::ScaleOutput(const double *act,unsigned long num,
+                          double *output) const
+{
+  unsigned long   bx,ix,unit;
+  double          value;
+
+  for(bx = 0;bx < num;bx++,act += NumUnits,output += NumOutput)
+  {
+    for(ix = 0;ix < NumOutput;ix++)
+    {
+      unit  = OutputUnits[ix];
+      value = act[unit];
+
+      if(UnitFlags[unit] & UFLAG_LINEAR)  // Does not use sigmoid fn.
+        value += 0.5;
+
+      output[ix] = value * (IOMax[unit] - IOMin[unit]) + IOMin[unit];
+    }
+  }
+}
+
+/*****************************************************************************
+  Function:   Activate()
+  Purpose:    This function computes a unit's activation level.
+  Parameters: unsigned char flags       The unit's flags (UFLAG_xxx).
+              double sum                The unit's weighted sum.
+              int mode                  How to compute the sigmoid function
+                                        (SIG_xxx).
+  Returns:    The activation level.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static inline double Activate(unsigned char flags,double sum,int mode)
+{
+  if(flags & UFLAG_BINARY)              // Unit is binary.
+    return(sum > 0.0 ? 1.0 : 0.0);
+  else if(flags & UFLAG_LINEAR)         // Linear output unit.
+    return(sum > 0.5 ? 0.5 : (sum < -0.5 ? -0.5 : sum));
+  else if(mode == SIG_EXACT)            // Normal unit, use sigmoid fnc.
+    return(1.0 / (1.0 + exp(-sum)));
+
+  NWSigmoid(1,&sum,&sum,mode);
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   Network::Propagate()
+  Purpose:    This function computes the activation levels of all units
+              other than the input units, for each of a number of samples.
+              The network must be frozen, and the input units' activation
+              levels must have been set.
+  Parameters: double *sum               If not NULL, receives the weighted
+                                        sums (for a single sample only).
+              double *act               Activation levels; one row of
+                                        NumUnits values for each sample.
+              unsigned long num         Number of samples.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::Propagate(double *sum,double *act,unsigned long num) const
+{
+  unsigned long   lx,ix,jx,bx,unit,first,row,end;
+  const NWLayer  *layer;
+  double         *cur,value;
+  float           fvalue;
+
+// Process all units other than the input units, which lead the sequence.
+//   Dense groups take their weighted sums with a single matrix product;
+//   sparse groups are summed a slice at a time (see PropagateSlices()),
+//   or, if they are small, a unit at a time.  Each unit's sum is built in
+//   place of its activation level.  Single-precision weights are used if
+//   there are any (see SetPrecision()).
+
+  for(lx = 0;lx < NumLayers;lx++)
+  {
+    layer = &Layers[lx];
+
+    if(layer->Dense)                    // Fully interconnected group.
+    {
+      first = ExecSeq[layer->Seq];
+      for(bx = 0;bx < num;bx++)
+      {
+        cur = &act[bx * NumUnits + first];
+        for(ix = 0;ix < layer->Num;ix++)
+          cur[ix] = (UnitFlags[first + ix] & UFLAG_BIAS) ? BiasWgts[first + ix] : 0.0;
+      }
+
+      if(WgtF != NULL)
+        NWGemmF(layer->Num,layer->NumSrc,&WgtF[RowStart[first]],num,
+                &act[layer->Src],NumUnits,&act[first],NumUnits,
+                Precision == PREC_SINGLE);
+      else
+        NWGemm(layer->Num,layer->NumSrc,&Wgt[RowStart[first]],num,
+               &act[layer->Src],NumUnits,&act[first],NumUnits);
+    }
+    else if(layer->NumSlice != 0)
+    {
+      PropagateSlices(layer,sum,act,num);
+      continue;
     }
     else
-      UnitList[ix]->Flag1 = FALSE;
+    {
+      for(ix = layer->Seq;ix < layer->Seq + layer->Num;ix++)
+      {
+        unit = ExecSeq[ix];
+        row  = RowStart[unit];
+        end  = RowStart[unit + 1];
+
+        for(bx = 0;bx < num;bx++)
+        {
+          cur = &act[bx * NumUnits];
+
+          if(UnitFlags[unit] & UFLAG_BIAS)  // Has bias input.
+            value = BiasWgts[unit];     // Apply bias input.
+          else                          // No bias input.
+            value = 0.0;                // Zero out the sum.
+
+          if(WgtF == NULL)              // Other inputs.
+            for(jx = row;jx < end;jx++)
+              value += cur[SrcIdx[jx]] * Wgt[jx];
+          else if(Precision == PREC_MIXED)
+            for(jx = row;jx < end;jx++)
+              value += cur[SrcIdx[jx]] * WgtF[jx];
+          else                          // Single precision.
+          {
+            for(jx = row,fvalue = 0.0f;jx < end;jx++)
+              fvalue += (float)cur[SrcIdx[jx]] * WgtF[jx];
+            value += fvalue;
+          }
+
+          cur[unit] = value;
+        }
+      }
+    }
+
+// Compute the activation level of each unit in the group.  Runs of
+//   sigmoid units with consecutive indices, such as a dense group, are
+//   passed to NWSigmoid() together, one sample at a time.
+
+    end = layer->Seq + layer->Num;
+    if(sum != NULL)
+      for(ix = layer->Seq;ix < end;ix++)
+        sum[ExecSeq[ix]] = act[ExecSeq[ix]];
+
+    for(ix = layer->Seq;ix < end;ix = jx)
+    {
+      unit = ExecSeq[ix];
+      jx   = ix + 1;
+
+      if(UnitFlags[unit] & (UFLAG_BINARY | UFLAG_LINEAR))
+      {
+        for(bx = 0,cur = act;bx < num;bx++,cur += NumUnits)
+          cur[unit] = Activate(UnitFlags[unit],cur[unit],SigmoidMode);
+        continue;
+      }
+
+      while(jx < end && ExecSeq[jx] == unit + (jx - ix) &&
+            !(UnitFlags[ExecSeq[jx]] & (UFLAG_BINARY | UFLAG_LINEAR)))
+        jx++;
+      for(bx = 0,cur = act;bx < num;bx++,cur += NumUnits)
+        NWSigmoid(jx - ix,&cur[unit],&cur[unit],SigmoidMode);
+    }
   }
+}
 
-// Process all units.
+/*****************************************************************************
+  Function:   Network::PropagateSlices()
+  Purpose:    This function computes the activation levels of the units of
+              a sparse group, for a batch of samples, a slice at a time (see
+              BuildSlices()).  The slice's units are summed side by side by
+              NWSell(), or by NWSellF() if the slices hold single-precision
+              weights, each in the order of its own input list, so that the
+              sums are those a unit at a time would give.  The units of a
+              group take no input from one another, so each slice's units
+              are activated at once.
+  Parameters: const NWLayer *layer      The sparse group.
+              double *sum               If not NULL, receives the first
+                                        sample's weighted sums.
+              double *act               Activation levels; one row of
+                                        NumUnits values per sample.
+              unsigned long num         Number of samples.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::PropagateSlices(const NWLayer *layer,double *sum,double *act,
+                              unsigned long num) const
+{
+  unsigned long   sx,bx,lane,unit;
+  const NWSlice  *slice;
+  double         *cur,y[SELL_LANES];
 
-  for(;;)                               // Do until all units processed.
+  for(sx = layer->Slice;sx < layer->Slice + layer->NumSlice;sx++)
   {
-    num_processed = 0;                  // None processed yet this iter.
+    slice = &Slices[sx];
 
-    for(ix = 0;ix < NumUnits;ix++)      // Scan for unprocessed units.
+    for(bx = 0,cur = act;bx < num;bx++,cur += NumUnits)
     {
-      if(!UnitList[ix]->Flag1)          // Not processed yet.
+      for(lane = 0;lane < SELL_LANES;lane++)
       {
-        for(jx = 0;jx < UnitList[ix]->NumInput;jx++)  // Check inp. units.
-          if(!UnitList[UnitList[ix]->InputUnits[jx]]->Flag1)
-            break;
-
-        if(jx < UnitList[ix]->NumInput) // Some inp. units not processed.
-          continue;
-
-        if(UnitList[ix]->Bias)          // Has bias input.
-          Sum[ix] = UnitList[ix]->BiasWgt;  // Apply bias input.
-        else                            // No bias input.
-          Sum[ix] = 0.0;                // Zero out the sum.
-
-        for(jx = 0;jx < UnitList[ix]->NumInput;jx++)  // Other inputs.
-          Sum[ix] += ActLevel[UnitList[ix]->InputUnits[jx]] * UnitList[ix]->InputWgts[jx];
-
-// Compute the activation level of this unit.
-
-        if(UnitList[ix]->Binary)        // Unit is binary.
-          ActLevel[ix] = Sum[ix] > 0.0 ? 1.0 : 0.0;
-        else if(UnitList[ix]->Type == UNIT_OUTPUT && !UnitList[ix]->Sigmoid)
-          ActLevel[ix] = (Sum[ix] > 0.5 ? 0.5 : (Sum[ix] < -0.5 ? -0.5 : Sum[ix]));
-        else                            // Normal unit, use sigmoid fnc.
-          ActLevel[ix] = 1.0 / (1.0 + exp(-Sum[ix]));
-
-        UnitList[ix]->Flag1 = TRUE;     // It has been processed.
-        num_processed++;                // One more activated this pass.
-        tot_processed++;
-        if(BackSeq != NULL)             // Store back-pass sequence.
-          BackSeq[ix] = NumUnits - tot_processed;
+        unit = slice->Unit[lane];
+        y[lane] = (UnitFlags[unit] & UFLAG_BIAS) ? BiasWgts[unit] : 0.0;
       }
+
+      if(SellWgtF != NULL)
+        NWSellF(slice->Len,&SellIdx[slice->Entry],&SellWgtF[slice->Entry],
+                cur,y,Precision == PREC_SINGLE);
+      else
+        NWSell(slice->Len,&SellIdx[slice->Entry],&SellWgt[slice->Entry],cur,y);
+
+      if(sum != NULL && bx == 0)
+        for(lane = 0;lane < slice->Num;lane++)
+          sum[slice->Unit[lane]] = y[lane];
+
+      if(slice->Sigmoid)                // Activate the slice at once.
+        NWSigmoid(slice->Num,y,y,SigmoidMode);
+      else
+        for(lane = 0;lane < slice->Num;lane++)
+          y[lane] = Activate(UnitFlags[slice->Unit[lane]],y[lane],SigmoidMode);
+
+      for(lane = 0;lane < slice->Num;lane++)
+        cur[slice->Unit[lane]] = y[lane];
     }
+  }
+}
 
-    if(tot_processed == NumUnits)       // All units processed.
-      break;
-    else if(num_processed == 0)         // Some left, but 0 done this iter.
+/*****************************************************************************
+  Function:   Network::ApplyTargets()
+  Purpose:    This function computes the output units' error values for a
+              batch of samples, from their target output values, as
+              ApplyTarget() does.  The other units' error values are cleared.
+              The network must be frozen.
+  Parameters: const double *act         Activation levels; one row of
+                                        NumUnits values for each sample.
+              double *err               Receives the error values, laid out
+                                        as act.
+              unsigned long num         Number of samples.
+              const double *target      Target output values; NumOutput
+                                        values for each sample.
+  Returns:    The sum of the squares of the output errors.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+double Network::ApplyTargets(const double *act,double *err,unsigned long num,
+                             const double *target) const
+{
+  unsigned long   bx,ix,unit;
+  double          value,sq_err = 0.0;
+
+  memset(err,0,num * NumUnits * sizeof(double));
+
+  for(bx = 0;bx < num;bx++,act += NumUnits,err += NumUnits,target += NumOutput)
+  {
+    for(ix = 0;ix < NumOutput;ix++)
     {
-      for(ix = 0;ix < NumUnits;ix++)    // Reset activated flags.
-        UnitList[ix]->Flag1 = FALSE;
-      memset(Sum,0,NumUnits * sizeof(double));
-      memset(ActLevel,0,NumUnits * sizeof(double));
+      unit  = OutputUnits[ix];
+      value = target[ix];
+
+      if(value > IOMax[unit])
+        value = IOMax[unit];
+      else if(value < IOMin[unit])
+        value = IOMin[unit];
+      value = (value - IOMin[unit]) / (IOMax[unit] - IOMin[unit]);
+
+      if(UnitFlags[unit] & UFLAG_LINEAR)  // Doesn't use the sigmoid fn.
+        value -= 0.5;
 
-      return(NW_ERR_RECURSIVE);         // Net has recursive unit chain.
+      err[unit] = value - act[unit];
+      sq_err   += err[unit] * err[unit];
     }
   }
 
-  for(ix = 0;ix < NumUnits;ix++)        // Reset activated flags.
-    UnitList[ix]->Flag1 = FALSE;
+  return(sq_err);
+}
 
-  return(NW_SUCCESS);                   // Successful operation.
+/*****************************************************************************
+  Function:   Network::BackPropagate()
+  Purpose:    This function passes the error values of a batch of samples
+              back through the network, and accumulates the resulting
+              weight changes for all of the samples; the weights themselves
+              are not changed.  The groups of units are visited in reverse
+              processing order, and each unit's weights (and its row of
+              changes) are run through every sample of the batch in turn.
+              The input units' bias weights, which play no part in the
+              network's output, are left alone.  The network must be frozen.
+              If accum is NULL, the changes are made to the weights directly
+              instead, as BackwardPass() makes them; this is meant for a
+              single sample (see TrainHogwild()).
+  Parameters: const double *act         Activation levels; one row of
+                                        NumUnits values for each sample.
+              double *err               Error values, laid out as act; the
+                                        output units' must have been set, and
+                                        the others cleared.
+              unsigned long num         Number of samples.
+              const double *eta         Learning parameter for each sample.
+              double **accum            Accumulated weight changes, laid out
+                                        as Accum, or NULL.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::BackPropagate(const double *act,double *err,unsigned long num,
+                            const double *eta,double **accum)
+{
+  unsigned long   lx,ix,jx,bx,unit,row,cnt,src;
+  NWLayer        *layer;
+  const double   *cur;
+  double         *cur_err,*change,*bias,basic_err;
+
+  for(lx = NumLayers;lx-- > 0;)
+  {
+    layer = &Layers[lx];
+
+    for(ix = layer->Seq + layer->Num;ix-- > layer->Seq;)
+    {
+      unit = ExecSeq[ix];
+      row  = RowStart[unit];
+      cnt  = RowStart[unit + 1] - row;
+
+      if(accum != NULL)                 // Accumulate the changes.
+      {
+        change = accum[unit];
+        bias   = &accum[unit][cnt];
+      }
+      else                              // Change the weights themselves.
+      {
+        change = &Wgt[row];
+        bias   = &BiasWgts[unit];
+      }
+
+      for(bx = 0;bx < num;bx++)
+      {
+        cur     = &act[bx * NumUnits];
+        cur_err = &err[bx * NumUnits];
+
+// Compute the 'basic' delta-weight value for this unit and sample.
+
+        if(UnitFlags[unit] & (UFLAG_BINARY | UFLAG_LINEAR))
+          basic_err = eta[bx] * cur_err[unit];
+        else                            // Normal unit, use derivative.
+          basic_err = eta[bx] * cur_err[unit] * (cur[unit] * (1 - cur[unit]));
+
+        if(UnitFlags[unit] & UFLAG_BIAS)
+          *bias += basic_err;
+
+        if(UnitFlags[unit] & UFLAG_DENSE) // Inputs are a contiguous run.
+        {
+          src = SrcIdx[row];
+          if(WgtF != NULL)
+            NWAxpyF(cnt,cur_err[unit],&WgtF[row],&cur_err[src]);
+          else
+            NWAxpy(cnt,cur_err[unit],&Wgt[row],&cur_err[src]);
+          NWAxpy(cnt,basic_err,&cur[src],change);
+        }
+        else
+        {
+          for(jx = 0;jx < cnt;jx++)
+          {
+            src = SrcIdx[row + jx];
+            cur_err[src] += cur_err[unit] *
+                            (WgtF != NULL ? WgtF[row + jx] : Wgt[row + jx]);
+            change[jx]   += basic_err * cur[src];
+          }
+        }
+      }
+
+      if(accum == NULL)                 // Weights were changed.
+        SyncWeights(row,cnt);
+    }
+  }
+}
+
+/*****************************************************************************
+  Function:   Network::SetupContext()
+  Purpose:    This function makes sure that a context has room for the given
+              number of samples.  A context made for a different number of
+              units (before the network was changed) is made afresh.
+  Parameters: NWContext *ctx            The context.
+              unsigned long num         Number of samples.
+              int train                 If TRUE, room for error values is
+                                        made as well.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::SetupContext(NWContext *ctx,unsigned long num,int train) const
+{
+  if(ctx->Units == NumUnits && ctx->Space >= num &&
+     (!train || ctx->Err != NULL))
+    return(NW_SUCCESS);                 // Already big enough.
+
+  if(ctx->Units == NumUnits && ctx->Space > num)
+    num = ctx->Space;                   // Keep the larger size.
+  train = train || ctx->Err != NULL;
+  FreeContext(ctx);
+
+  if((ctx->Act = new double[num * NumUnits]) == NULL)
+    return(NW_ERR_MEMORY);
+  memset(ctx->Act,0,num * NumUnits * sizeof(double));
+
+  if(train && (ctx->Err = new double[num * NumUnits]) == NULL)
+  {
+    FreeContext(ctx);
+    return(NW_ERR_MEMORY);
+  }
+  ctx->Space = num;
+  ctx->Units = NumUnits;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::FreeContext()
+  Purpose:    This function releases the memory held by a context.
+  Parameters: NWContext *ctx            The context.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::FreeContext(NWContext *ctx) const
+{
+  delete[] ctx->Act;
+  delete[] ctx->Err;
+  ctx->Act = ctx->Err = NULL;
+  ctx->Space = ctx->Units = 0;
 }
 
 /*****************************************************************************
@@ -1042,83 +2653,89 @@ NWErr Network::ForwardPass(void)
 
 NWErr Network::BackwardPass(double eta,double momentum_coeff)
 {
-  unsigned long ix,jx,idx;
+  unsigned long ix,jx,unit,src,num;
+  NWErr         nwErr;
   double        basic_err,change;
 
   if(NumUnits == 0)                     // No units.
     return(NW_SUCCESS);
 
+  if(!Frozen && (nwErr = Freeze()) != NW_SUCCESS)
+    return(nwErr);                      // Topology changed; redo layout.
+
   for(ix = 0;ix < NumUnits;ix++)        // Reset error values.
-    if(UnitList[ix]->Type != UNIT_OUTPUT)  // Not an output unit.
+    if(!(UnitFlags[ix] & UFLAG_OUTPUT)) // Not an output unit.
       Error[ix] = 0.0;
 
-// Propagate error values backwards.
+// Visit the units in reverse processing order.  By the time a unit is
+//   reached, every unit it feeds has passed back its error, so the unit's
+//   error is complete; it is passed back to the unit's inputs through the
+//   old weights, and then the unit's own weights are updated.
 
-  for(idx = 0;;)                        // Keep doing it 'til we're done.
+  for(ix = 0;ix < NumUnits;ix++)
   {
-    for(ix = NumUnits - 1;;ix--)        // Scan for unprocessed units.
-    {
-      if(BackSeq[ix] == idx)            // Next unit to be processed.
-      {
-        for(jx = 0;jx < UnitList[ix]->NumInput;jx++)
-        {
-          Error[UnitList[ix]->InputUnits[jx]] +=
-            Error[ix] * UnitList[ix]->InputWgts[jx];
-        }
-
-        idx++;                          // Increment sequence index.
-      }
-
-      if(ix == 0)                       // Just processed first unit.
-        break;                          // Start again @ end.
-    }
-
-    if(idx == NumUnits)                 // All units processed.
-      break;
-  }
-
-// Error values have now been propagated backwards; now we must update
-//   the weights for each interconnection.
+    unit = BackSeq[ix];
+    num  = RowStart[unit + 1] - RowStart[unit];  // Number of inputs.
 
-  for(ix = 0;ix < NumUnits;ix++)        // Perform for each unit.
-  {
 // Pre-compute the 'basic' delta-weight value for this unit.
 
-    if(UnitList[ix]->Binary ||          // Unit is binary, or linear output.
-       (UnitList[ix]->Type == UNIT_OUTPUT && !UnitList[ix]->Sigmoid))
-      basic_err = eta * Error[ix];
+    if(UnitFlags[unit] & (UFLAG_BINARY | UFLAG_LINEAR))
+      basic_err = eta * Error[unit];    // Binary unit, or linear output.
     else                                // Normal unit, use derivative.
-      basic_err = eta * Error[ix] * (ActLevel[ix] * (1 - ActLevel[ix]));
+      basic_err = eta * Error[unit] * (ActLevel[unit] * (1 - ActLevel[unit]));
 
-    if(UnitList[ix]->Bias)              // Update bias weight.
+    if(UnitFlags[unit] & UFLAG_BIAS)    // Update bias weight.
     {
       if(Momentum != NULL)              // Implementing weight momentum.
       {
-        change = basic_err + momentum_coeff * Momentum[ix][UnitList[ix]->NumInput];
-        UnitList[ix]->BiasWgt += change;
-        Momentum[ix][UnitList[ix]->NumInput] = change;
+        change = basic_err + momentum_coeff * Momentum[unit][num];
+        BiasWgts[unit] += change;
+        Momentum[unit][num] = change;
       }
       else if(Accum != NULL)            // Implementing weight accumulation.
-        Accum[ix][UnitList[ix]->NumInput] += basic_err;
+        Accum[unit][num] += basic_err;
       else                              // Normal update strategy.
-        UnitList[ix]->BiasWgt += basic_err;
+        BiasWgts[unit] += basic_err;
     }
 
-    for(jx = 0;jx < UnitList[ix]->NumInput;jx++)  // Update each weight.
+    if((UnitFlags[unit] & UFLAG_DENSE) && Momentum == NULL)
+    {                                   // Inputs are a contiguous run.
+      src = SrcIdx[RowStart[unit]];
+      if(WgtF != NULL)
+        NWAxpyF(num,Error[unit],&WgtF[RowStart[unit]],&Error[src]);
+      else
+        NWAxpy(num,Error[unit],&Wgt[RowStart[unit]],&Error[src]);
+      if(Accum != NULL)                 // Implementing weight accumulation.
+        NWAxpy(num,basic_err,&ActLevel[src],Accum[unit]);
+      else                              // Normal update strategy.
+      {
+        NWAxpy(num,basic_err,&ActLevel[src],&Wgt[RowStart[unit]]);
+        SyncWeights(RowStart[unit],num);
+      }
+      continue;
+    }
+
+    for(jx = 0;jx < num;jx++)           // Propagate error, update weight.
     {
-      change = basic_err * ActLevel[UnitList[ix]->InputUnits[jx]];
+      src = SrcIdx[RowStart[unit] + jx];
+      Error[src] += Error[unit] * (WgtF != NULL ? WgtF[RowStart[unit] + jx]
+                                                : Wgt[RowStart[unit] + jx]);
+      change = basic_err * ActLevel[src];
 
       if(Momentum != NULL)              // Implementing weight momentum.
       {
-        change += momentum_coeff * Momentum[ix][jx];
-        UnitList[ix]->InputWgts[jx] += change;
-        Momentum[ix][jx] = change;
+        change += momentum_coeff * Momentum[unit][jx];
+        Wgt[RowStart[unit] + jx] += change;
+        Momentum[unit][jx] = change;
       }
       else if(Accum != NULL)            // Implementing weight accumulation.
-        Accum[ix][jx] += change;
+        Accum[unit][jx] += change;
       else                              // Normal update strategy.
-        UnitList[ix]->InputWgts[jx] += change;
+        Wgt[RowStart[unit] + jx] += change;
     }
+
+    if(Accum == NULL)                   // Weights were changed.
+      SyncWeights(RowStart[unit],num);
   }
 
   return(NW_SUCCESS);                   // Successful operation.
@@ -1134,23 +2751,30 @@ NWErr Network::BackwardPass(double eta,double momentum_coeff)
 
 NWErr Network::ApplyAccum(void)
 {
-  unsigned long ix,jx;
+  unsigned long ix,jx,num;
+  NWErr         nwErr;
 
   if(Accum == NULL)                     // Not accumulating.
     return(NW_SUCCESS);
 
+  if(!Frozen && (nwErr = Freeze()) != NW_SUCCESS)
+    return(nwErr);
+
   for(ix = 0;ix < NumUnits;ix++)
   {
-    for(jx = 0;jx < UnitList[ix]->NumInput;jx++)
+    num = RowStart[ix + 1] - RowStart[ix];
+
+    for(jx = 0;jx < num;jx++)
     {
-      UnitList[ix]->InputWgts[jx] += Accum[ix][jx];
+      Wgt[RowStart[ix] + jx] += Accum[ix][jx];
       Accum[ix][jx] = 0;
     }
+    SyncWeights(RowStart[ix],num);
 
-    if(UnitList[ix]->Bias)              // Apply weight change to bias wgt.
+    if(UnitFlags[ix] & UFLAG_BIAS)      // Apply weight change to bias wgt.
     {
-      UnitList[ix]->BiasWgt += Accum[ix][UnitList[ix]->NumInput];
-      Accum[ix][UnitList[ix]->NumInput] = 0;
+      BiasWgts[ix] += Accum[ix][num];
+      Accum[ix][num] = 0;
     }
   }
 
@@ -19,6 +19,60 @@
 #define   UNIT_INTERNAL 1               // Internal unit.
 #define   UNIT_OUTPUT   2               // Output unit.
 
+// Kinds of checkpoint (Checkpoint()).
+
+#define   CKPT_IMAGE    0               // Whole network, as an image.
+#define   CKPT_WEIGHTS  1               // All weights, to a weight file.
+#define   CKPT_DELTA    2               // Weights changed since the last
+                                        //   weight checkpoint, appended.
+
+// Precisions of a network's arithmetic (SetPrecision()).
+
+#define   PREC_DOUBLE   0               // Double-precision weights and sums.
+#define   PREC_SINGLE   1               // Single-precision weights and sums.
+#define   PREC_MIXED    2               // Single-precision weights, double-
+                                        //   precision sums.
+
+// Ways of computing the sigmoid function (SetSigmoid(), NWSigmoid()).
+
+#define   SIG_EXACT     0               // With the C library's exp().
+#define   SIG_POLY      1               // Vectorized polynomial; to 1e-15.
+#define   SIG_TABLE     2               // Interpolated table; to 3e-6.
+
+// Sets of numeric kernels (NWSetKernels()).  In strict mode every set gives
+//   the same results as the scalar set; otherwise the wider sets may fuse
+//   multiplies with adds, which rounds differently.
+
+#define   KERN_SCALAR   0               // One element at a time, in C.
+#define   KERN_SSE2     1               // 128-bit vectors (the baseline).
+#define   KERN_AVX2     2               // 256-bit vectors.
+#define   KERN_AVX512   3               // 512-bit vectors.
+
+// Units per slice of a sparse group (see sparse.cpp).
+
+#define   SELL_LANES    8
+
+// Conversion between the byte order of files (little-endian) and that of
+//   this machine.  NW_LSBFIRST is defined where the two are the same.
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define   NW_LE32(x)    __builtin_bswap32(x)
+#define   NW_LE64(x)    __builtin_bswap64(x)
+#else
+#define   NW_LE32(x)    (x)
+#define   NW_LE64(x)    (x)
+#define   NW_LSBFIRST
+#endif
+
+// Unit flags, as kept in the compact (frozen) network layout.
+
+#define   UFLAG_INPUT   0x01            // Input unit.
+#define   UFLAG_OUTPUT  0x02            // Output unit.
+#define   UFLAG_BIAS    0x04            // Unit has bias input.
+#define   UFLAG_BINARY  0x08            // Unit is binary.
+#define   UFLAG_LINEAR  0x10            // Output unit without sigmoid fn.
+#define   UFLAG_DENSE   0x20            // Inputs are a contiguous run.
+
 enum NWErr                              // NetWorks error values.
 {
   NW_SUCCESS = 0,                       // No error; successful operation.
@@ -40,11 +94,14 @@ enum NWErr                              // NetWorks error values.
   NW_ERR_IOCONN,                        // Improper input/output unit conn.
   NW_ERR_NOUNITS,                       // No network units.
   NW_ERR_NOTINPUT,                      // Unit is not an input unit.
-  NW_ERR_NOTOUTPUT                      // Unit is not an output unit.
+  NW_ERR_NOTOUTPUT,                     // Unit is not an output unit.
+  NW_ERR_NOTREADY                       // Network not set up for execution.
 };
 
-struct NWFileHdr                        // Header for a Network file.
-{
+struct NWFileHdr                        // Header for a Network file in the
+{                                       //   original format.  (Such files
+                                        //   are still read, but networks are
+                                        //   saved as images; see image.cpp.)
   short           MagicNum;             // Magic number ("NW" -- 0x574E).
   unsigned long   NumUnits;             // Number of processing units.
   char            _Rsvd[250];           // Reserved -- set to 0.
@@ -85,20 +142,92 @@ struct NWUnit                           // Network processing unit.
   unsigned int    Binary  : 1;          // If TRUE, unit is binary.
   unsigned int    Bias    : 1;          // If TRUE, unit has bias input.
   unsigned int    Sigmoid : 1;          // If output unit & TRUE, uses sigmoid.
-  unsigned int    Flag1   : 1;          // First binary flag.
-  unsigned int    Flag2   : 1;          // Second binary flag.
-  unsigned int    Flag3   : 1;          // Third binary flag.
   double          BiasWgt;              // Bias interconnection weight.
   NWIODef        *IODef;                // I/O def'n (if input or output unit).
   unsigned long  *InputUnits;           // List of input interconnections.
   double         *InputWgts;            // Input interconnection weights.
 };
 
+struct NWLayer                          // Group of units processed together.
+{
+  unsigned long   Seq;                  // Position in ExecSeq.
+  unsigned long   Num;                  // Number of units.
+  unsigned long   Src;                  // If dense, first input unit.
+  unsigned long   NumSrc;               // If dense, number of input units.
+  int             Dense;                // If TRUE, units are consecutive and
+                                        //   all take input from the same
+                                        //   run of units.
+  unsigned long   Slice;                // If sparse, first slice.
+  unsigned long   NumSlice;             // If sparse, number of slices (0 if
+                                        //   done a unit at a time).
+};
+
+struct NWSlice                          // Units of a sparse group whose
+{                                       //   inputs are interleaved, so that
+                                        //   they are summed side by side.
+  unsigned long   Entry;                // First entry in SellIdx, etc.
+  unsigned long   Len;                  // Entries per unit.
+  unsigned long   Num;                  // Number of units.
+  int             Sigmoid;              // If TRUE, all use sigmoid function.
+  unsigned long   Unit[SELL_LANES];     // Units, by lane.
+};
+
+struct NWContext                        // Execution state for a batch.
+{                                       //   Each thread running a network
+                                        //   needs one of its own.  It may
+                                        //   be kept across changes to the
+                                        //   network; see SetupContext().
+  unsigned long   Space;                // Number of samples there's room for.
+  unsigned long   Units;                // Number of units it was made for.
+  double         *Act;                  // Activation levels; one row of
+                                        //   NumUnits values per sample.
+  double         *Err;                  // Error values, laid out as Act
+                                        //   (if set up for training).
+
+  NWContext()
+  {
+    Space = Units = 0;
+    Act = Err = NULL;
+  };
+};
+
+struct NWKernelSet                      // One implementation of the numeric
+{                                       //   kernels (see dispatch.cpp).
+  double (*Dot)(const double *x,const double *y,unsigned long n);
+  void   (*Axpy)(unsigned long n,double a,const double *x,double *y);
+  void   (*Gemv)(unsigned long rows,unsigned long cols,const double *w,
+                 const double *x,double *y);
+  void   (*Gemm)(unsigned long rows,unsigned long cols,const double *w,
+                 unsigned long num,const double *x,unsigned long ldx,
+                 double *y,unsigned long ldy);
+  double (*DotF)(const float *w,const double *x,unsigned long n,int single);
+  void   (*AxpyF)(unsigned long n,double a,const float *x,double *y);
+  void   (*GemmF)(unsigned long rows,unsigned long cols,const float *w,
+                  unsigned long num,const double *x,unsigned long ldx,
+                  double *y,unsigned long ldy,int single);
+  long   (*DotQ)(const signed char *x,const signed char *y,unsigned long n);
+  void   (*Sigmoid)(unsigned long n,const double *x,double *y,int mode);
+  void   (*Sell)(unsigned long len,const unsigned int *idx,const double *w,
+                 const double *x,double *y);
+  void   (*SellF)(unsigned long len,const unsigned int *idx,const float *w,
+                  const double *x,double *y,int single);
+};
+
+struct NWPool;                          // Pool of training threads.
+struct NWCheckpoint;                    // Checkpoint being written.
+struct NWWeightLog;                     // Weights last written to a file.
+struct NWStream;                        // Data set being streamed.
+struct NWQuantUnit;                     // Unit of a quantized network.
+
 class Network                           // Network object.
 {
 public:
   char            Path[PATH_MAX + 1];   // Network filename.
   FILE           *Handle;               // Handle for network file.
+  char           *Image;                // Image file's contents, if any.
+  unsigned long   ImageSize;            // Size of image.
+  int             ImageMapped;          // If TRUE, image is mapped (rather
+                                        //   than read into memory).
   unsigned long   NumUnits;             // Number of processing units.
   unsigned long   UnitSpace;            // Number of units there's room for.
   unsigned long   NumInput;             // Number of input units.
@@ -108,21 +237,79 @@ public:
   double         *ActLevel;             // List of unit activation levels.
   double         *Error;                // List of unit error values.
   unsigned long  *BackSeq;              // Back-pass processing sequence.
+  unsigned long  *ExecSeq;              // Forward-pass processing sequence.
+
+// Compact layout, built by Freeze().  While the network is frozen, each
+//   unit's InputUnits and InputWgts point into SrcIdx and Wgt, and the
+//   bias weights in BiasWgts take the place of the units' BiasWgt fields.
+
+  int             Frozen;               // If TRUE, compact layout is built.
+  unsigned long  *RowStart;             // Start of each unit's inputs.
+  unsigned long  *SrcIdx;               // Input units of all units.
+  double         *Wgt;                  // Input weights of all units.
+  double         *BiasWgts;             // Bias weights.
+  float          *WgtF;                 // Single-precision copy of Wgt,
+                                        //   which the passes use in its
+                                        //   place (unless PREC_DOUBLE).
+  unsigned char  *UnitFlags;            // Unit flags (UFLAG_xxx).
+  double         *IOMin;                // Input/output range minimums.
+  double         *IOMax;                // Input/output range maximums.
+  NWLayer        *Layers;               // Groups of units, in proc. order.
+  unsigned long   NumLayers;            // Number of groups.
+  NWSlice        *Slices;               // Slices of the sparse groups.
+  unsigned long   NumSlices;            // Number of slices.
+  unsigned int   *SellIdx;              // Input units of the slices.
+  double         *SellWgt;              // Slices' weights, from Wgt, or
+  float          *SellWgtF;             //   from WgtF if there is one.
+  unsigned long  *SellStart;            // Each unit's first entry in the
+                                        //   slices, or -1 if none.
+  unsigned long  *OutputUnits;          // Output units, in order of def'n.
+  NWContext       Batch;                // State for ForwardBatch().
   double        **Accum;                // Accumulated weight changes.
   double        **Momentum;             // Last weight change.
+  NWPool         *Pool;                 // Training threads, if any.
+  NWCheckpoint   *Ckpt;                 // Checkpoint writer, if any.
+  NWWeightLog    *WLog;                 // Last weight file written, if any.
+  int             Precision;            // Precision of arithmetic
+                                        //   (PREC_xxx).
+  int             SigmoidMode;          // How to compute the sigmoid
+                                        //   function (SIG_xxx).
 
   Network()
   {
     strcpy(Path,"");
     Handle = NULL;
+    Image = NULL;
+    ImageSize = 0;
+    ImageMapped = FALSE;
     NumUnits = UnitSpace = NumInput = NumOutput = 0;
     UnitList = NULL;
     Sum = NULL;
     ActLevel = NULL;
     Error = NULL;
     BackSeq = NULL;
+    ExecSeq = NULL;
+    Frozen = FALSE;
+    RowStart = SrcIdx = NULL;
+    Wgt = BiasWgts = IOMin = IOMax = NULL;
+    WgtF = NULL;
+    UnitFlags = NULL;
+    Layers = NULL;
+    NumLayers = 0;
+    Slices = NULL;
+    NumSlices = 0;
+    SellIdx = NULL;
+    SellWgt = NULL;
+    SellWgtF = NULL;
+    SellStart = NULL;
+    OutputUnits = NULL;
     Accum = NULL;
     Momentum = NULL;
+    Pool = NULL;
+    Ckpt = NULL;
+    WLog = NULL;
+    Precision = PREC_DOUBLE;
+    SigmoidMode = SIG_EXACT;
   };
 
   char *ErrMsg(NWErr error);            // Get message for an error.
@@ -130,8 +317,25 @@ public:
                   unsigned long key,unsigned long num,unsigned long *list);
 
   NWErr Open(const char *file);         // Open a network file.
+  NWErr OpenImage(FILE *handle);        // Open an image file.
   NWErr Close(void);                    // Close cur net, create new one.
   NWErr Save(const char *file);         // Save network to file.
+  NWErr WriteAtomic(const char *file,   // Write and rename over a file.
+                    const double *wgt,const double *bias,FILE **keep);
+  NWErr WriteImage(FILE *handle,        // Write network as an image.
+                   const double *wgt,const double *bias);
+  NWErr SaveWeights(const char *file,   // Save weights to a weight file.
+                    int delta);
+  NWErr WriteWeights(const char *file,  // Write weights to a weight file.
+                     const double *wgt,const double *bias,int delta);
+  NWErr LoadWeights(const char *file);  // Load weights from a weight file.
+  void  FreeWeightLog(void);            // Forget last weights written.
+  NWErr Checkpoint(const char *file,    // Save network in the background.
+                   int kind);
+  NWErr EndCheckpoint(void);            // Wait for checkpoint to be saved.
+  void  FreeCheckpoint(void);           // Release checkpoint snapshot.
+  int   InImage(const void *ptr);       // Does pointer lie in the image?
+  void  FreeImage(void);                // Release the image.
 
   NWErr CreateUnit(unsigned long x,     // Create a processing unit.
                    unsigned long y,int type,int binary,int bias,int sigmoid,
@@ -142,11 +346,35 @@ public:
                          unsigned long dest);
   NWErr DeleteConnection(unsigned long source,  // Delete an interconnection.
                          unsigned long dest);
+  NWErr Prune(double threshold,         // Remove weak interconnections.
+              double fraction,unsigned long *map);
 
   NWErr SetupTrain(int accumulate,      // Prepare for training.
                    int momentum);
   NWErr SetupExec(void);                // Prepare for execution.
+  NWErr BuildPlan(void);                // Compute unit processing order.
+  void  DropPlan(void);                 // Discard unit processing order.
+  NWErr Reorder(unsigned long *map);    // Renumber units in proc. order.
+  NWErr Freeze(void);                   // Build compact layout.
+  NWErr Thaw(void);                     // Release compact layout.
+  void  FreeLayout(void);               // Free compact layout arrays.
+  NWErr SetPrecision(int prec);         // Choose precision of arithmetic.
+  NWErr SetSigmoid(int mode);           // Choose how sigmoid is computed.
+  void  SyncWeights(unsigned long first,// Copy weights to WgtF.
+                    unsigned long num);
+  void  GatherUnit(unsigned long unit,  // Fill in a unit's flags, etc.
+                   unsigned long *num_out);
+  int   UnitIO(unsigned long unit,      // Get a unit's flags and range.
+               double *min,double *max) const;
+  NWErr FindLayers(void);               // Group units for processing.
+  NWErr BuildSlices(void);              // Lay out the sparse groups.
+  void  FreeSlices(void);               // Free sparse group layout.
+  NWErr SliceWeights(void);             // Lay out the slices' weights.
+  void  SyncSlices(unsigned long first, // Copy weights to the slices.
+                   unsigned long num);
   NWErr EndTrain(void);                 // Release training resources.
+  NWErr SetupThreads(int num);          // Start training threads.
+  NWErr EndThreads(void);               // Stop training threads.
   NWErr EndExec(void);                  // Release execution resources.
 
   NWErr SetInput(unsigned long unit,    // Set input value.
@@ -157,14 +385,218 @@ public:
                     double target);
 
   NWErr ForwardPass(void);              // Perform forward pass on network.
+  NWErr ForwardBatch(unsigned long num, // Perform forward pass on a batch.
+                     const double *input,double *output);
+  NWErr Execute(NWContext *ctx,         // Forward pass in a given context.
+                unsigned long num,const double *input,double *output) const;
+  NWErr TrainBatch(unsigned long num,   // Train on a batch.
+                   const double *input,const double *target,
+                   const double *eta,double *sq_err);
+  NWErr TrainParallel(unsigned long num,// Train on a batch using threads.
+                      const double *input,const double *target,
+                      const double *eta,double *sq_err);
+  NWErr TrainHogwild(unsigned long num, // Train on a batch asynchronously.
+                     const double *input,const double *target,
+                     const double *eta,double *sq_err);
+  void  ScaleInput(double *act,         // Apply input values to a batch.
+                   unsigned long num,const double *input) const;
+  void  ScaleOutput(const double *act,  // Read output values of a batch.
+                    unsigned long num,double *output) const;
+  void  Propagate(double *sum,          // Compute activations of a batch.
+                  double *act,unsigned long num) const;
+  void  PropagateSlices(                // Compute activations of a sparse
+                  const NWLayer *layer, //   group by slices.
+                  double *sum,double *act,unsigned long num) const;
+  double ApplyTargets(const double *act,// Compute output errors of a batch.
+                      double *err,unsigned long num,
+                      const double *target) const;
+  void  BackPropagate(const double *act,// Accumulate changes for a batch.
+                      double *err,unsigned long num,const double *eta,
+                      double **accum);
+  NWErr SetupContext(NWContext *ctx,    // Make room in a context.
+                     unsigned long num,int train) const;
+  void  FreeContext(NWContext *ctx) const;  // Release a context.
   NWErr BackwardPass(double eta,        // Perform backward pass on network.
                      double momentum_coeff);
 
   NWErr ApplyAccum(void);               // Apply accumulated weight changes.
 };
 
+class NWDataset                         // Training data set (see
+{                                       //   dataset.cpp).
+public:
+  unsigned long   NumRows;              // Number of samples.
+  unsigned long   NumInput;             // Input values per sample.
+  unsigned long   NumOutput;            // Target values per sample.
+  unsigned long   BlockRows;            // Samples per block.
+  char           *Data;                 // File's contents, if open.
+  unsigned long   Size;                 // Size of file.
+  int             Mapped;               // If TRUE, file is mapped (rather
+                                        //   than read into memory).
+  const double   *Rows;                 // Blocks in memory, if any.
+  unsigned long   FirstBlock;           // Number of first block in memory.
+  NWStream       *Stream;               // Chunk reader, if streaming.
+  FILE           *Handle;               // File being written, if any.
+  char            Path[PATH_MAX + 1];   // Name of file being written.
+  double         *Block;                // Block being filled.
+  unsigned long   Fill;                 // Samples in block being filled.
+
+  NWDataset()
+  {
+    NumRows = NumInput = NumOutput = BlockRows = 0;
+    Data = NULL;
+    Size = 0;
+    Mapped = FALSE;
+    Rows = NULL;
+    FirstBlock = 0;
+    Stream = NULL;
+    Handle = NULL;
+    strcpy(Path,"");
+    Block = NULL;
+    Fill = 0;
+  };
+  ~NWDataset()
+  {
+    Close();
+  };
+
+  NWErr Open(const char *file);         // Open a data set file.
+  NWErr OpenStream(const char *file,    // Open a data set file to be read
+                   unsigned long window,//   a chunk at a time.
+                   unsigned long *num_chunks);
+  NWErr Fetch(unsigned long chunk);     // Begin reading a chunk.
+  NWErr NextChunk(unsigned long *first, // Wait for the chunk being read.
+                  unsigned long *num);
+  NWErr Create(const char *file,        // Begin writing a data set file.
+               unsigned long num_in,unsigned long num_out);
+  NWErr Append(double eta,              // Add a sample to the file.
+               const double *input,const double *target);
+  NWErr Finish(void);                   // Complete the file being written.
+  void  Close(void);                    // Release the data set.
+
+  const double *Row(unsigned long row,  // Find a sample's values.
+                    const double **input,const double **target) const;
+};
+
+class NWQuantNet                        // Network quantized to 8-bit weights,
+{                                       //   for execution only (see
+public:                                 //   quant.cpp).
+  unsigned long   NumUnits;             // Number of processing units.
+  unsigned long   NumInput;             // Number of input units.
+  unsigned long   NumOutput;            // Number of output units.
+  unsigned long   NumConn;              // Number of interconnections.
+  char           *Data;                 // Model's contents, if any.
+  unsigned long   Size;                 // Size of model.
+  int             Mapped;               // If TRUE, model is a mapped file
+                                        //   (rather than in memory).
+  const NWQuantUnit  *Units;            // Unit records.
+  const unsigned int *ExecSeq;          // Processing sequence.
+  const unsigned int *SrcIdx;           // Input units of sparse units.
+  const signed char  *Wgt;              // Input weights of all units.
+  unsigned long  *OutputUnits;          // Output units, in order of def'n.
+  double         *ActLevel;             // List of unit activation levels.
+  signed char    *ActQ;                 // Activation levels, quantized.
+  int             SigmoidMode;          // How to compute the sigmoid
+                                        //   function (SIG_xxx).
+
+  NWQuantNet()
+  {
+    NumUnits = NumInput = NumOutput = NumConn = 0;
+    Data = NULL;
+    Size = 0;
+    Mapped = FALSE;
+    Units = NULL;
+    ExecSeq = SrcIdx = NULL;
+    Wgt = NULL;
+    OutputUnits = NULL;
+    ActLevel = NULL;
+    ActQ = NULL;
+    SigmoidMode = SIG_EXACT;
+  };
+  ~NWQuantNet()
+  {
+    Close();
+  };
+
+  NWErr Quantize(Network *net);         // Quantize a network.
+  NWErr Open(const char *file);         // Open a quantized network file.
+  NWErr Save(const char *file);         // Save to a quantized network file.
+  NWErr Attach(void);                   // Set up from Data.
+  void  Close(void);                    // Release the network.
+
+  NWErr SetInput(unsigned long unit,    // Set input value.
+                 double value);
+  NWErr SetSigmoid(int mode);           // Choose how sigmoid is computed.
+  NWErr ForwardPass(void);              // Perform forward pass on network.
+  NWErr ReadOutput(unsigned long unit,  // Read an output value.
+                   double *value);
+  NWErr Execute(unsigned long num,      // Perform forward pass on a batch.
+                const double *input,double *output);
+};
+
 // Random-number routines.
 
 void  Randomize32(unsigned long seed);  // Initialize random number sequence.
 unsigned long   Rand32(void);           // Generate random number.
+void  RandPermute(unsigned long *list,  // Generate random permutation.
+                  unsigned long num);
+
+// Reading numbers from text.
+
+const char *NWParseReal(const char *ptr,// Read a number.
+                        const char *end,double *value);
+int   NWParseLine(const char *ptr,      // Read a row of numbers from a line.
+                  const char *end,unsigned long width,double *out);
+NWErr NWParseText(const char *text,     // Read rows of numbers from text.
+                  size_t len,unsigned long width,int threads,double **rows,
+                  unsigned long *num_rows,unsigned long *line);
+NWErr NWReadText(FILE *handle,          // Read rows of numbers from a file.
+                 unsigned long width,int threads,double **rows,
+                 unsigned long *num_rows,unsigned long *line);
+
+// Writing files.
+
+NWErr NWReplaceFile(FILE *handle,       // Commit a file over another.
+                    const char *temp,const char *file);
+
+// Numeric kernels.
+
+double NWDot(const double *x,           // Dot product.
+             const double *y,unsigned long n);
+void   NWAxpy(unsigned long n,double a, // y += a * x.
+              const double *x,double *y);
+void   NWGemv(unsigned long rows,       // y += W * x.
+              unsigned long cols,const double *w,const double *x,double *y);
+void   NWGemm(unsigned long rows,       // y[b] += W * x[b].
+              unsigned long cols,const double *w,unsigned long num,
+              const double *x,unsigned long ldx,double *y,unsigned long ldy);
+double NWDotF(const float *w,           // Dot product, float weights.
+              const double *x,unsigned long n,int single);
+void   NWAxpyF(unsigned long n,double a,// y += a * x, float x.
+               const float *x,double *y);
+long   NWDotQ(const signed char *x,     // Dot product, 8-bit integers.
+              const signed char *y,unsigned long n);
+void   NWGemmF(unsigned long rows,      // y[b] += W * x[b], float W.
+               unsigned long cols,const float *w,unsigned long num,
+               const double *x,unsigned long ldx,double *y,unsigned long ldy,
+               int single);
+void   NWSigmoid(unsigned long n,       // y = 1 / (1 + e^-x).
+                 const double *x,double *y,int mode);
+void   NWSell(unsigned long len,        // Weighted sums of a slice.
+              const unsigned int *idx,const double *w,const double *x,
+              double *y);
+void   NWSellF(unsigned long len,       // Weighted sums, float weights.
+               const unsigned int *idx,const float *w,const double *x,
+               double *y,int single);
+
+NWErr  NWSetKernels(int set,int strict);// Choose the numeric kernels.
+int    NWGetKernels(int *strict);       // Which kernels are in use?
+const char *NWKernelName(int set);      // Name of a set of kernels.
+
+extern const NWKernelSet NWKernelsScalar;     // The sets of kernels, built
+extern const NWKernelSet NWKernelsSse2;       //   from scalar.cpp and
+extern const NWKernelSet NWKernelsAvx2;       //   kernel.cpp (F: multiply-
+extern const NWKernelSet NWKernelsAvx2F;      //   adds fused).
+extern const NWKernelSet NWKernelsAvx512;
+extern const NWKernelSet NWKernelsAvx512F;
 
@@ -0,0 +1,203 @@
+// Prune - remove a network's weakest connections.
+//
+// Usage: prune [-t threshold] [-p percent] [-d data-file] infile outfile
+//
+//   -t  Remove every connection whose weight is smaller in magnitude than
+//       the threshold.
+//   -p  Remove the given percentage of each unit's connections, the
+//       weakest first.
+//   -d  Measure the network on the samples of the given data set file
+//       (written by dsconv), rather than on random inputs.
+//
+// Both -t and -p may be given.  Internal units left feeding no other unit
+// are removed too (see Network::Prune()), and the pruned network is written
+// to the output file as an image.  The connections and units removed, and
+// the time per sample of a batched forward pass before and after, are
+// written to stdout, along with the drift of the pruned network's outputs
+// from the original's, in the output units' own ranges.  With -d, the RMS
+// error of each against the targets is written too.
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nwclass.h"
+
+#define BATCH     64                    // Samples per forward pass.
+#define RANDOM    4096                  // Random samples, without -d.
+
+// Return a monotonic time in seconds.
+
+static double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+// Count the network's connections.
+
+static unsigned long Connections(Network *net)
+{
+  unsigned long ix, conn = 0;
+
+  for(ix = 0; ix < net->NumUnits; ix++)
+    conn += net->UnitList[ix]->NumInput;
+  return(conn);
+}
+
+// Run every sample through the network, a batch at a time, and return the
+// time taken per sample.
+
+static double Run(Network *net, const double *input, unsigned long num_rows,
+                  double *output)
+{
+  unsigned long i, num;
+  double        start;
+  NWErr         nwErr;
+
+  start = Now();
+  for(i = 0; i < num_rows; i += num)
+  {
+    num = num_rows - i < BATCH ? num_rows - i : BATCH;
+    if((nwErr = net->ForwardBatch(num, &input[i * net->NumInput],
+                                  &output[i * net->NumOutput])) != NW_SUCCESS)
+      { fprintf(stderr, "%s\n", net->ErrMsg(nwErr)); exit(1); }
+  }
+  return((Now() - start) / num_rows);
+}
+
+int main(int argc, char *argv[])
+{
+  char     *data_file = NULL;
+  int       opt;
+  unsigned long num_rows, num_out, conn, units, i, k, unit;
+  double    threshold = 0, percent = 0, time, ptime;
+  double   *input, *target = NULL, *out, *pout;
+  double    diff, max_diff = 0, sq_diff = 0, sq_err = 0, sq_perr = 0;
+  const double *s_in, *s_out;
+  Network   net;
+  NWDataset data;
+  NWErr     nwErr;
+
+  while((opt = getopt(argc, argv, "t:p:d:")) != -1)
+  {
+    if(opt == 't')
+    {
+      threshold = atof(optarg);
+      continue;
+    }
+    if(opt == 'p')
+    {
+      percent = atof(optarg);
+      continue;
+    }
+    if(opt == 'd')
+    {
+      data_file = optarg;
+      continue;
+    }
+    optind = argc + 1;
+    break;
+  }
+
+  if(optind != argc - 2 || threshold < 0 || percent < 0 || percent > 100)
+  {
+    fprintf(stderr, "Usage: %s [-t threshold] [-p percent] [-d data-file] "
+            "infile outfile\n", argv[0]);
+    exit(1);
+  }
+
+  if((nwErr = net.Open(argv[optind])) != NW_SUCCESS ||
+     (nwErr = net.SetupExec()) != NW_SUCCESS)
+    { fprintf(stderr, "%s: %s\n", argv[optind], net.ErrMsg(nwErr)); exit(1); }
+
+  // Gather the samples' inputs (and targets) into rows for ForwardBatch().
+
+  if(data_file != NULL)
+  {
+    if((nwErr = data.Open(data_file)) != NW_SUCCESS)
+      { fprintf(stderr, "%s: %s\n", data_file, net.ErrMsg(nwErr)); exit(1); }
+    if(data.NumInput != net.NumInput || data.NumOutput != net.NumOutput)
+      { fprintf(stderr, "Data set does not fit network.\n"); exit(1); }
+    num_rows = data.NumRows;
+  }
+  else
+    num_rows = RANDOM;
+  if(num_rows == 0)
+    { fprintf(stderr, "No samples.\n"); exit(1); }
+
+  input = (double *)malloc(num_rows * net.NumInput * sizeof(double));
+  out = (double *)malloc(num_rows * net.NumOutput * sizeof(double));
+  pout = (double *)malloc(num_rows * net.NumOutput * sizeof(double));
+  if(data_file != NULL)
+    target = (double *)malloc(num_rows * net.NumOutput * sizeof(double));
+
+  for(i = 0; i < num_rows; i++)
+  {
+    if(data_file != NULL)
+    {
+      data.Row(i, &s_in, &s_out);
+      memcpy(&input[i * net.NumInput], s_in, net.NumInput * sizeof(double));
+      memcpy(&target[i * net.NumOutput], s_out,
+             net.NumOutput * sizeof(double));
+      continue;
+    }
+
+    for(k = 0; k < net.NumInput; k++)   // Anywhere in the unit's range.
+    {
+      unit = net.ExecSeq[k];
+      input[i * net.NumInput + k] = net.IOMin[unit] +
+        (net.IOMax[unit] - net.IOMin[unit]) * (Rand32() / 4294967296.0);
+    }
+  }
+
+  conn = Connections(&net);
+  units = net.NumUnits;
+  time = Run(&net, input, num_rows, out);
+
+  if((nwErr = net.Prune(threshold, percent / 100, NULL)) != NW_SUCCESS ||
+     (nwErr = net.SetupExec()) != NW_SUCCESS)
+    { fprintf(stderr, "%s: %s\n", argv[optind], net.ErrMsg(nwErr)); exit(1); }
+  if((nwErr = net.Save(argv[optind + 1])) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind + 1], net.ErrMsg(nwErr));
+    exit(1);
+  }
+
+  ptime = Run(&net, input, num_rows, pout);
+
+  num_out = num_rows * net.NumOutput;
+  for(i = 0; i < num_out; i++)
+  {
+    diff = fabs(pout[i] - out[i]);
+    if(diff > max_diff)
+      max_diff = diff;
+    sq_diff += diff * diff;
+    if(target != NULL)
+    {
+      sq_err += (out[i] - target[i]) * (out[i] - target[i]);
+      sq_perr += (pout[i] - target[i]) * (pout[i] - target[i]);
+    }
+  }
+
+  printf("Connections: %lu of %lu removed (%.1f%% sparser); %lu left.\n",
+         conn - Connections(&net), conn,
+         conn ? 100.0 * (conn - Connections(&net)) / conn : 0.0,
+         Connections(&net));
+  printf("Units: %lu of %lu removed.\n", units - net.NumUnits, units);
+  printf("Time per sample: %.3f us before, %.3f us after (%.2fx).\n",
+         time * 1e6, ptime * 1e6, ptime > 0 ? time / ptime : 0.0);
+  printf("Drift: max %g, RMS %g over %lu outputs.\n", max_diff,
+         sqrt(sq_diff / num_out), num_out);
+  if(target != NULL)
+    printf("RMS error: before %g, after %g.\n", sqrt(sq_err / num_out),
+           sqrt(sq_perr / num_out));
+
+  return(0);
+}
@@ -0,0 +1,166 @@
+// Qconv - quantize a network to 8-bit weights, for execution only.
+//
+// Usage: qconv [-d data-file | -s] network quantized-file
+//
+//   -d  Check the quantized network against the network on the samples of
+//       the given data set file (written by dsconv).
+//   -s  Check it against the samples read from stdin instead, one to a
+//       line, as train reads them: the learning coefficient (ignored), then
+//       the input values, then the target values, whitespace-separated.
+//
+// The network is quantized and written to the quantized file.  With -d or
+// -s, both are then run on every sample, and the drift of the quantized
+// network's outputs from the network's is written to stdout: the largest
+// and RMS differences, in the output units' own ranges, and the RMS error
+// of each against the targets.  The size of each network's weights and
+// connection lists, and the time each takes per sample, are written too.
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nwclass.h"
+
+// Return a monotonic time in seconds.
+
+static double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+int main(int argc, char *argv[])
+{
+  char     *data_file = NULL;
+  int       opt, check = FALSE;
+  unsigned long num_rows = 0, num_out, line, width, conn, i, k;
+  double   *text = NULL, *out, *qout;
+  const double *s_in, *s_out;
+  double    diff, max_diff = 0, sq_diff = 0, sq_err = 0, sq_qerr = 0;
+  double    start, time = 0, qtime = 0;
+  Network   net;
+  NWQuantNet qnet;
+  NWDataset data;
+  NWErr     nwErr;
+
+  while((opt = getopt(argc, argv, "d:s")) != -1)
+  {
+    if(opt == 'd')
+    {
+      data_file = optarg;
+      continue;
+    }
+    if(opt == 's')
+    {
+      check = TRUE;
+      continue;
+    }
+    optind = argc + 1;
+    break;
+  }
+
+  if(optind != argc - 2 || (check && data_file != NULL))
+  {
+    fprintf(stderr, "Usage: %s [-d data-file | -s] network quantized-file\n",
+            argv[0]);
+    exit(1);
+  }
+
+  if((nwErr = net.Open(argv[optind])) != NW_SUCCESS ||
+     (nwErr = net.SetupExec()) != NW_SUCCESS ||
+     (nwErr = qnet.Quantize(&net)) != NW_SUCCESS)
+    { fprintf(stderr, "%s: %s\n", argv[optind], net.ErrMsg(nwErr)); exit(1); }
+  if((nwErr = qnet.Save(argv[optind + 1])) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind + 1], net.ErrMsg(nwErr));
+    exit(1);
+  }
+
+  conn = net.RowStart[net.NumUnits];
+  printf("Network: %lu units, %lu connections; %lu bytes of weights and "
+         "connections.\n", net.NumUnits, conn,
+         (net.NumUnits * 2 + 1) * sizeof(double) +
+         conn * (sizeof(unsigned long) + sizeof(double)));
+  printf("Quantized: %lu bytes.\n", qnet.Size);
+
+  width = net.NumInput + net.NumOutput + 1;
+  if(data_file != NULL)
+  {
+    if((nwErr = data.Open(data_file)) != NW_SUCCESS)
+      { fprintf(stderr, "%s: %s\n", data_file, net.ErrMsg(nwErr)); exit(1); }
+    if(data.NumInput != net.NumInput || data.NumOutput != net.NumOutput)
+      { fprintf(stderr, "Data set does not fit network.\n"); exit(1); }
+    num_rows = data.NumRows;
+  }
+  else if(check)
+  {
+    nwErr = NWReadText(stdin, width, 0, &text, &num_rows, &line);
+    if(nwErr == NW_ERR_BADFILE)
+      fprintf(stderr, "Badly formatted input at line %lu.\n", line);
+    else if(nwErr != NW_SUCCESS)
+      fprintf(stderr, "%s\n", net.ErrMsg(nwErr));
+    if(nwErr != NW_SUCCESS)
+      exit(1);
+  }
+  if(num_rows == 0)
+    return(0);
+
+  out = (double *)malloc(net.NumOutput * sizeof(double));
+  qout = (double *)malloc(net.NumOutput * sizeof(double));
+
+  // Run each sample through both networks, a unit at a time, as a program
+  // using them would.
+
+  for(i = 0; i < num_rows; i++)
+  {
+    if(data_file != NULL)
+      data.Row(i, &s_in, &s_out);
+    else
+    {
+      s_in = &text[i * width + 1];
+      s_out = s_in + net.NumInput;
+    }
+
+    start = Now();
+    for(k = 0; k < net.NumInput; k++)
+      net.SetInput(net.ExecSeq[k], s_in[k]);
+    net.ForwardPass();
+    for(k = 0; k < net.NumOutput; k++)
+      net.ReadOutput(net.OutputUnits[k], &out[k]);
+    time += Now() - start;
+
+    start = Now();
+    for(k = 0; k < qnet.NumInput; k++)
+      qnet.SetInput(qnet.ExecSeq[k], s_in[k]);
+    qnet.ForwardPass();
+    for(k = 0; k < qnet.NumOutput; k++)
+      qnet.ReadOutput(qnet.OutputUnits[k], &qout[k]);
+    qtime += Now() - start;
+
+    for(k = 0; k < net.NumOutput; k++)
+    {
+      diff = fabs(qout[k] - out[k]);
+      if(diff > max_diff)
+        max_diff = diff;
+      sq_diff += diff * diff;
+      sq_err += (out[k] - s_out[k]) * (out[k] - s_out[k]);
+      sq_qerr += (qout[k] - s_out[k]) * (qout[k] - s_out[k]);
+    }
+  }
+
+  num_out = num_rows * net.NumOutput;
+  printf("Drift: max %g, RMS %g over %lu outputs.\n", max_diff,
+         sqrt(sq_diff / num_out), num_out);
+  printf("RMS error: network %g, quantized %g.\n", sqrt(sq_err / num_out),
+         sqrt(sq_qerr / num_out));
+  printf("Time per sample: network %.3f us, quantized %.3f us.\n",
+         time * 1e6 / num_rows, qtime * 1e6 / num_rows);
+
+  return(0);
+}
@@ -0,0 +1,667 @@
+/*****************************************************************************
+  File:     quant.cpp
+
+  Purpose:  This file contains the code for quantized networks: copies of
+            trained networks whose weights are 8-bit integers, for
+            execution only.  Each weight takes a byte, rather than the
+            eight of a double, and units are executed in integer
+            arithmetic.
+
+  Each unit's weights are scaled by a factor of their own, so that the
+  largest of them becomes 127, and rounded to integers.  Activation levels,
+  which lie between -0.5 and 1, are scaled by QUANT_ACT and rounded in the
+  same way as each unit's is computed.  A unit's weighted sum is then the
+  integer dot product of its weights with its inputs' levels, scaled back
+  by the product of the two factors, plus its bias weight (which is kept
+  as a float, there being only one per unit).  The activation levels
+  themselves are computed from the sums as Network computes them, and the
+  output units' are read unrounded.
+
+  A quantized network file is the same on every machine: values are
+  little-endian, and reals are IEEE singles or doubles.  The file begins
+  with a header (NWQuantHdr), and its sections follow, each aligned to
+  QUANT_ALIGN bytes; their sizes, and so their offsets, follow from the
+  header:
+
+    Units         NWQuantUnit[NumUnits]     Flags, range, scale, bias, and
+                                            where the unit's inputs lie.
+    ExecSeq       integer[NumUnits]         32 bits; input units first, in
+                                            order of their definition.
+    SrcIdx        integer[NumSparse]        32 bits; the input units of the
+                                            units whose inputs are not a
+                                            contiguous run.
+    Wgt           signed byte[NumConn]
+
+  The units whose inputs are a contiguous run (UFLAG_DENSE) -- most units,
+  in a layered network -- list only the first of them.  On a little-endian
+  machine the file is mapped read-only, and the sections are used where
+  they lie; on any other machine it is read into memory and converted.  As
+  with images, the connection lists are trusted.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nwclass.h"
+
+#define QUANT_VERSION 1                 // Version of the file format.
+#define QUANT_ALIGN   64                // Alignment of sections.
+#define QUANT_ACT     127.0             // Scale of activation levels.
+
+#define ALIGN(n)    (((n) + QUANT_ALIGN - 1) & ~(uint64_t)(QUANT_ALIGN - 1))
+
+struct NWQuantHdr                       // Header of a quantized network
+{                                       //   file (64 bytes).
+  char            Magic[4];             // Magic number ("NWQ8").
+  uint32_t        Version;              // Format version (QUANT_VERSION).
+  uint32_t        Flags;                // Reserved -- set to 0.
+  uint32_t        _Pad;                 // Reserved -- set to 0.
+  uint64_t        NumUnits;             // Number of processing units.
+  uint64_t        NumConn;              // Number of interconnections.
+  uint64_t        NumSparse;            // Number of entries in SrcIdx.
+  uint64_t        NumInput;             // Number of input units.
+  uint64_t        NumOutput;            // Number of output units.
+  uint64_t        Size;                 // Size of file.
+};
+
+struct NWQuantUnit                      // Unit record (48 bytes).
+{
+  double          Min,Max;              // Input/output range.
+  uint64_t        Row;                  // First weight, within Wgt.
+  uint64_t        Src;                  // If UFLAG_DENSE, first input unit;
+                                        //   otherwise, first entry in
+                                        //   SrcIdx.
+  uint32_t        NumInput;             // Number of input connections.
+  float           Scale;                // Weight scale times act. scale.
+  float           Bias;                 // Bias weight (0 if no bias).
+  uint8_t         Flags;                // Unit flags (UFLAG_xxx).
+  uint8_t         _Pad[3];              // Reserved -- set to 0.
+};
+
+struct NWQuantLayout                    // Offsets of a file's sections.
+{
+  uint64_t        Units;
+  uint64_t        ExecSeq;
+  uint64_t        SrcIdx;
+  uint64_t        Wgt;
+  uint64_t        Size;                 // Size of the whole file.
+};
+
+/*****************************************************************************
+  Function:   SwapHdr()
+  Purpose:    This function converts the fields of a header between the
+              byte order of the file and that of this machine.
+  Parameters: NWQuantHdr *hdr           The header.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void SwapHdr(NWQuantHdr *hdr)
+{
+  hdr->Version   = NW_LE32(hdr->Version);
+  hdr->Flags     = NW_LE32(hdr->Flags);
+  hdr->NumUnits  = NW_LE64(hdr->NumUnits);
+  hdr->NumConn   = NW_LE64(hdr->NumConn);
+  hdr->NumSparse = NW_LE64(hdr->NumSparse);
+  hdr->NumInput  = NW_LE64(hdr->NumInput);
+  hdr->NumOutput = NW_LE64(hdr->NumOutput);
+  hdr->Size      = NW_LE64(hdr->Size);
+}
+
+/*****************************************************************************
+  Function:   Layout()
+  Purpose:    This function works out where the sections of a file lie.
+  Parameters: const NWQuantHdr *hdr     The file's header (in this
+                                        machine's byte order).
+              NWQuantLayout *lay        Receives the offsets.
+  Returns:    TRUE if the counts in the header are sound.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int Layout(const NWQuantHdr *hdr,NWQuantLayout *lay)
+{
+  if(hdr->NumUnits > UINT32_MAX || hdr->NumConn > (uint64_t)1 << 56 ||
+     hdr->NumSparse > hdr->NumConn || hdr->NumInput > hdr->NumUnits ||
+     hdr->NumOutput > hdr->NumUnits)
+    return(FALSE);
+
+  lay->Units   = ALIGN(sizeof(NWQuantHdr));
+  lay->ExecSeq = ALIGN(lay->Units + hdr->NumUnits * sizeof(NWQuantUnit));
+  lay->SrcIdx  = ALIGN(lay->ExecSeq + hdr->NumUnits * sizeof(uint32_t));
+  lay->Wgt     = ALIGN(lay->SrcIdx + hdr->NumSparse * sizeof(uint32_t));
+  lay->Size    = lay->Wgt + hdr->NumConn;
+
+  return(TRUE);
+}
+
+#ifndef NW_LSBFIRST
+/*****************************************************************************
+  Function:   Swap()
+  Purpose:    This function converts the sections of a file between the
+              byte order of the file and that of this machine, in place.
+              The weights, being bytes, need no conversion.
+  Parameters: char *base                The file's contents.
+              const NWQuantHdr *hdr     Its header, in this machine's order.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Swap(char *base,const NWQuantHdr *hdr)
+{
+  NWQuantLayout   lay;
+  NWQuantUnit    *rec;
+  uint32_t       *word;
+  uint64_t        ix,bits;
+
+  Layout(hdr,&lay);
+  rec = (NWQuantUnit *)(base + lay.Units);
+  for(ix = 0;ix < hdr->NumUnits;ix++)
+  {
+    memcpy(&bits,&rec[ix].Min,sizeof(bits));
+    bits = NW_LE64(bits);
+    memcpy(&rec[ix].Min,&bits,sizeof(bits));
+    memcpy(&bits,&rec[ix].Max,sizeof(bits));
+    bits = NW_LE64(bits);
+    memcpy(&rec[ix].Max,&bits,sizeof(bits));
+    rec[ix].Row      = NW_LE64(rec[ix].Row);
+    rec[ix].Src      = NW_LE64(rec[ix].Src);
+    rec[ix].NumInput = NW_LE32(rec[ix].NumInput);
+    word    = (uint32_t *)&rec[ix].Scale;
+    word[0] = NW_LE32(word[0]);
+    word    = (uint32_t *)&rec[ix].Bias;
+    word[0] = NW_LE32(word[0]);
+  }
+
+  word = (uint32_t *)(base + lay.ExecSeq);
+  for(ix = 0;ix < hdr->NumUnits;ix++)
+    word[ix] = NW_LE32(word[ix]);
+  word = (uint32_t *)(base + lay.SrcIdx);
+  for(ix = 0;ix < hdr->NumSparse;ix++)
+    word[ix] = NW_LE32(word[ix]);
+}
+#endif
+
+/*****************************************************************************
+  Function:   Activate()
+  Purpose:    This function computes a unit's activation level, as
+              Network does.
+  Parameters: unsigned char flags       The unit's flags (UFLAG_xxx).
+              double sum                The unit's weighted sum.
+              int mode                  How to compute the sigmoid function
+                                        (SIG_xxx).
+  Returns:    The activation level.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static inline double Activate(unsigned char flags,double sum,int mode)
+{
+  if(flags & UFLAG_BINARY)              // Unit is binary.
+    return(sum > 0.0 ? 1.0 : 0.0);
+  else if(flags & UFLAG_LINEAR)         // Linear output unit.
+    return(sum > 0.5 ? 0.5 : (sum < -0.5 ? -0.5 : sum));
+  else if(mode == SIG_EXACT)            // Normal unit, use sigmoid fnc.
+    return(1.0 / (1.0 + exp(-sum)));
+
+  NWSigmoid(1,&sum,&sum,mode);
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::Quantize()
+  Purpose:    This function sets the quantized network up as a copy of a
+              network, with its weights quantized.  The network is frozen
+              first, if it is not already.
+  Parameters: Network *net              The network.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::Quantize(Network *net)
+{
+  NWQuantHdr     *hdr;
+  NWQuantHdr      count;
+  NWQuantLayout   lay;
+  NWQuantUnit    *rec;
+  uint32_t       *seq,*src;
+  signed char    *wgt;
+  unsigned long   ix,jx,row,num,pos;
+  double          big,scale;
+  char           *base;
+  NWErr           nwErr;
+
+  if(Data != NULL)                      // Already in use.
+    return(NW_ERR_NETOPEN);
+  if(net->NumUnits == 0)                // No units in network.
+    return(NW_ERR_NOUNITS);
+  if((nwErr = net->Freeze()) != NW_SUCCESS)
+    return(nwErr);
+
+  memset(&count,0,sizeof(NWQuantHdr));
+  memcpy(count.Magic,"NWQ8",4);
+  count.Version   = QUANT_VERSION;
+  count.NumUnits  = net->NumUnits;
+  count.NumConn   = net->RowStart[net->NumUnits];
+  count.NumInput  = net->NumInput;
+  count.NumOutput = net->NumOutput;
+  for(ix = 0;ix < net->NumUnits;ix++)
+    if(!(net->UnitFlags[ix] & UFLAG_DENSE))
+      count.NumSparse += net->RowStart[ix + 1] - net->RowStart[ix];
+  if(!Layout(&count,&lay))              // Too many units.
+    return(NW_ERR_BADPARAM);
+  count.Size = lay.Size;
+
+  if(lay.Size > (size_t)-1 || (base = (char *)malloc(lay.Size)) == NULL)
+    return(NW_ERR_MEMORY);
+  memset(base,0,lay.Size);
+
+  hdr  = (NWQuantHdr *)base;
+  *hdr = count;
+  rec  = (NWQuantUnit *)(base + lay.Units);
+  seq  = (uint32_t *)(base + lay.ExecSeq);
+  src  = (uint32_t *)(base + lay.SrcIdx);
+  wgt  = (signed char *)(base + lay.Wgt);
+
+  for(ix = pos = 0;ix < net->NumUnits;ix++)
+  {
+    row = net->RowStart[ix];
+    num = net->RowStart[ix + 1] - row;
+
+    rec[ix].Min      = net->IOMin[ix];
+    rec[ix].Max      = net->IOMax[ix];
+    rec[ix].Row      = row;
+    rec[ix].NumInput = num;
+    rec[ix].Flags    = net->UnitFlags[ix];
+    if(net->UnitFlags[ix] & UFLAG_BIAS)
+      rec[ix].Bias   = net->BiasWgts[ix];
+
+    if(net->UnitFlags[ix] & UFLAG_DENSE)  // Inputs are a contiguous run.
+      rec[ix].Src = net->SrcIdx[row];
+    else
+    {
+      rec[ix].Src = pos;
+      for(jx = 0;jx < num;jx++)
+        src[pos++] = net->SrcIdx[row + jx];
+    }
+
+// Scale the weights so that the largest becomes 127.
+
+    for(jx = 0,big = 0.0;jx < num;jx++)
+      if(fabs(net->Wgt[row + jx]) > big)
+        big = fabs(net->Wgt[row + jx]);
+    if(big == 0.0)                      // No weights, or all zero.
+      continue;
+
+    scale = big / 127.0;
+    for(jx = 0;jx < num;jx++)
+      wgt[row + jx] = (signed char)lrint(net->Wgt[row + jx] / scale);
+    rec[ix].Scale = scale / QUANT_ACT;
+  }
+
+  for(ix = 0;ix < net->NumUnits;ix++)
+    seq[ix] = net->ExecSeq[ix];
+
+  Data   = base;
+  Size   = lay.Size;
+  Mapped = FALSE;
+  if((nwErr = Attach()) != NW_SUCCESS)
+    Close();
+
+  return(nwErr);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::Open()
+  Purpose:    This function opens a quantized network file.
+  Parameters: char *file                Name of file.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::Open(const char *file)
+{
+  struct stat     st;
+  NWQuantHdr      hdr;
+  NWQuantLayout   lay;
+  FILE           *handle;
+  char           *base;
+  NWErr           nwErr;
+
+  if(Data != NULL)                      // Already in use.
+    return(NW_ERR_NETOPEN);
+
+  if((handle = fopen(file,"rb")) == NULL)
+    return(NW_ERR_OPENING);
+
+  if(fread(&hdr,1,sizeof(NWQuantHdr),handle) < sizeof(NWQuantHdr) ||
+     fstat(fileno(handle),&st) != 0)
+  {
+    fclose(handle);
+    return(NW_ERR_READING);
+  }
+  SwapHdr(&hdr);
+
+  if(memcmp(hdr.Magic,"NWQ8",4) != 0 || hdr.Version != QUANT_VERSION ||
+     hdr.Flags != 0 || !Layout(&hdr,&lay) || hdr.Size != lay.Size ||
+     (uint64_t)st.st_size != lay.Size || lay.Size > (size_t)-1)
+  {
+    fclose(handle);
+    return(NW_ERR_BADFILE);
+  }
+
+#ifdef NW_LSBFIRST
+  base = (char *)mmap(NULL,lay.Size,PROT_READ,MAP_SHARED,fileno(handle),0);
+  fclose(handle);
+  if(base == (char *)MAP_FAILED)
+    return(NW_ERR_READING);
+  Mapped = TRUE;
+#else
+  if((base = (char *)malloc(lay.Size)) == NULL)
+  {
+    fclose(handle);
+    return(NW_ERR_MEMORY);
+  }
+  rewind(handle);
+  if(fread(base,1,lay.Size,handle) < lay.Size)
+  {
+    fclose(handle);
+    free(base);
+    return(NW_ERR_READING);
+  }
+  fclose(handle);
+  *(NWQuantHdr *)base = hdr;
+  Swap(base,&hdr);
+  Mapped = FALSE;
+#endif
+
+  Data = base;
+  Size = lay.Size;
+  if((nwErr = Attach()) != NW_SUCCESS)
+    Close();
+
+  return(nwErr);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::Attach()
+  Purpose:    This function sets the quantized network up from its contents
+              (Data, in this machine's byte order), checking the unit-level
+              structure, and makes room for the activation levels.
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::Attach(void)
+{
+  const NWQuantHdr *hdr = (const NWQuantHdr *)Data;
+  NWQuantLayout   lay;
+  const NWQuantUnit *rec;
+  unsigned long   ix,num_in = 0,num_out = 0;
+
+  Layout(hdr,&lay);
+  NumUnits  = hdr->NumUnits;
+  NumInput  = hdr->NumInput;
+  NumOutput = hdr->NumOutput;
+  NumConn   = hdr->NumConn;
+  Units     = (const NWQuantUnit *)(Data + lay.Units);
+  ExecSeq   = (const unsigned int *)(Data + lay.ExecSeq);
+  SrcIdx    = (const unsigned int *)(Data + lay.SrcIdx);
+  Wgt       = (const signed char *)(Data + lay.Wgt);
+
+  for(ix = 0;ix < NumUnits;ix++)        // Check where the inputs lie.
+  {
+    rec = &Units[ix];
+    if(rec->NumInput > NumConn || rec->Row > NumConn - rec->NumInput ||
+       ((rec->Flags & UFLAG_DENSE) ?
+        rec->NumInput > NumUnits || rec->Src > NumUnits - rec->NumInput :
+        rec->NumInput > hdr->NumSparse ||
+        rec->Src > hdr->NumSparse - rec->NumInput) ||
+       ExecSeq[ix] >= NumUnits ||
+       (ix < NumInput) != !!(Units[ExecSeq[ix]].Flags & UFLAG_INPUT))
+      return(NW_ERR_BADFILE);
+    if(rec->Flags & UFLAG_INPUT)
+      num_in++;
+    if(rec->Flags & UFLAG_OUTPUT)
+      num_out++;
+  }
+  if(num_in != NumInput || num_out != NumOutput)
+    return(NW_ERR_BADFILE);
+
+  if((OutputUnits = new unsigned long[NumOutput + 1]) == NULL ||
+     (ActLevel = new double[NumUnits]) == NULL ||
+     (ActQ = new signed char[NumUnits]) == NULL)
+    return(NW_ERR_MEMORY);
+  memset(ActLevel,0,NumUnits * sizeof(double));
+  memset(ActQ,0,NumUnits);
+
+  for(ix = num_out = 0;ix < NumUnits;ix++)
+    if(Units[ix].Flags & UFLAG_OUTPUT)
+      OutputUnits[num_out++] = ix;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::Save()
+  Purpose:    This function saves the quantized network to a file.  It is
+              written to a new file beside the target, which is then renamed
+              over it once it is safely on disk.
+  Parameters: char *file                Name of file.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::Save(const char *file)
+{
+  char            temp[PATH_MAX + 8];
+  FILE           *handle;
+  char           *out = Data;
+  int             ok;
+
+  if(Data == NULL)                      // Nothing to save.
+    return(NW_ERR_NONETOPEN);
+  if(strlen(file) > PATH_MAX)
+    return(NW_ERR_BADPARAM);
+
+#ifndef NW_LSBFIRST                     // Convert a copy.
+  if((out = (char *)malloc(Size)) == NULL)
+    return(NW_ERR_MEMORY);
+  memcpy(out,Data,Size);
+  Swap(out,(const NWQuantHdr *)Data);
+  SwapHdr((NWQuantHdr *)out);
+#endif
+
+  sprintf(temp,"%s.tmp",file);
+  if((handle = fopen(temp,"wb")) == NULL)
+  {
+    if(out != Data)
+      free(out);
+    return(NW_ERR_CREATING);
+  }
+
+  ok = fwrite(out,1,Size,handle) == Size &&
+       NWReplaceFile(handle,temp,file) == NW_SUCCESS;
+  ok = fclose(handle) == 0 && ok;
+  if(!ok)
+    remove(temp);
+  if(out != Data)
+    free(out);
+
+  return(ok ? NW_SUCCESS : NW_ERR_WRITING);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::Close()
+  Purpose:    This function releases the quantized network.
+  Parameters: None.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void NWQuantNet::Close(void)
+{
+  if(Data != NULL && Mapped)
+    munmap(Data,Size);
+  else if(Data != NULL)
+    free(Data);
+  delete[] OutputUnits;
+  delete[] ActLevel;
+  delete[] ActQ;
+
+  NumUnits = NumInput = NumOutput = NumConn = 0;
+  Data = NULL;
+  Size = 0;
+  Mapped = FALSE;
+  Units = NULL;
+  ExecSeq = SrcIdx = NULL;
+  Wgt = NULL;
+  OutputUnits = NULL;
+  ActLevel = NULL;
+  ActQ = NULL;
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::SetInput()
+  Purpose:    This function sets the value of an input unit, as
+              Network::SetInput() does.
+  Parameters: unsigned long unit        Index of input unit.
+              double value              Value.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::SetInput(unsigned long unit,double value)
+{
+  const NWQuantUnit *rec;
+
+  if(unit >= NumUnits)                  // Bad unit index.
+    return(NW_ERR_BADPARAM);
+  rec = &Units[unit];
+  if(!(rec->Flags & UFLAG_INPUT))       // Not an input unit.
+    return(NW_ERR_NOTINPUT);
+
+  if(value > rec->Max)                  // Truncate and scale input value.
+    value = rec->Max;
+  else if(value < rec->Min)
+    value = rec->Min;
+
+  ActLevel[unit] = (value - rec->Min) / (rec->Max - rec->Min);
+  ActQ[unit]     = (signed char)lrint(ActLevel[unit] * QUANT_ACT);
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::SetSigmoid()
+  Purpose:    This function chooses how the sigmoid function is computed,
+              as Network::SetSigmoid() does.  The quantized activation
+              levels are coarser than any of the approximations' errors.
+  Parameters: int mode                  How to compute it (SIG_xxx).
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::SetSigmoid(int mode)
+{
+  if(mode != SIG_EXACT && mode != SIG_POLY && mode != SIG_TABLE)
+    return(NW_ERR_BADPARAM);
+
+  SigmoidMode = mode;
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::ForwardPass()
+  Purpose:    This function performs a forward pass on the quantized
+              network.  The input units' values must have been set.
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::ForwardPass(void)
+{
+  const NWQuantUnit  *rec;
+  const unsigned int *src;
+  const signed char  *wgt;
+  unsigned long   ix,jx,unit;
+  long            dot;
+
+  if(Data == NULL)                      // No network.
+    return(NW_ERR_NONETOPEN);
+
+  for(ix = NumInput;ix < NumUnits;ix++) // Input units lead the sequence.
+  {
+    unit = ExecSeq[ix];
+    rec  = &Units[unit];
+    wgt  = &Wgt[rec->Row];
+
+    if(rec->Flags & UFLAG_DENSE)        // Inputs are a contiguous run.
+      dot = NWDotQ(wgt,&ActQ[rec->Src],rec->NumInput);
+    else
+    {
+      src = &SrcIdx[rec->Src];
+      for(jx = 0,dot = 0;jx < rec->NumInput;jx++)
+        dot += wgt[jx] * ActQ[src[jx]];
+    }
+
+    ActLevel[unit] = Activate(rec->Flags,rec->Bias + (double)rec->Scale * dot,
+                              SigmoidMode);
+    ActQ[unit]     = (signed char)lrint(ActLevel[unit] * QUANT_ACT);
+  }
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::ReadOutput()
+  Purpose:    This function reads the value of an output unit, as
+              Network::ReadOutput() does.
+  Parameters: unsigned long unit        Index of output unit.
+              double *value             Receives the value.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::ReadOutput(unsigned long unit,double *value)
+{
+  const NWQuantUnit *rec;
+
+  if(unit >= NumUnits)                  // Bad unit index.
+    return(NW_ERR_BADPARAM);
+  rec = &Units[unit];
+  if(!(rec->Flags & UFLAG_OUTPUT))      // Not an output unit.
+    return(NW_ERR_NOTOUTPUT);
+
+  *value = ActLevel[unit];
+  if(rec->Flags & UFLAG_LINEAR)         // Does not use sigmoid fn.
+    *value += 0.5;
+  *value = *value * (rec->Max - rec->Min) + rec->Min;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWQuantNet::Execute()
+  Purpose:    This function performs forward passes on a batch of samples,
+              as Network::ForwardBatch() does.
+  Parameters: unsigned long num         Number of samples.
+              const double *input       Input values; NumInput values (in
+                                        order of the input units'
+                                        definition) for each sample.
+              double *output            Receives the output values;
+                                        NumOutput values for each sample.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWQuantNet::Execute(unsigned long num,const double *input,
+                          double *output)
+{
+  unsigned long   bx,ix;
+  NWErr           nwErr;
+
+  for(bx = 0;bx < num;bx++,input += NumInput,output += NumOutput)
+  {
+    for(ix = 0;ix < NumInput;ix++)
+      SetInput(ExecSeq[ix],input[ix]);
+    if((nwErr = ForwardPass()) != NW_SUCCESS)
+      return(nwErr);
+    for(ix = 0;ix < NumOutput;ix++)
+      ReadOutput(OutputUnits[ix],&output[ix]);
+  }
+
+  return(NW_SUCCESS);
+}
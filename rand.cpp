@@ -112,3 +112,27 @@ unsigned long Rand32(void)
   return(result);
 }
 
+
+/*****************************************************************************
+  Function:   RandPermute()
+  Purpose:    This function fills a list with the numbers 0 to num - 1 in a
+              random order, every order being equally likely (an "inside-
+              out" Fisher-Yates shuffle).  It takes time in proportion to
+              num.
+  Parameters: unsigned long *list       List to fill.
+              unsigned long num         Number of entries in the list.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void RandPermute(unsigned long *list,unsigned long num)
+{
+  unsigned long ix,pick;
+
+  for(ix = 0;ix < num;ix++)
+  {
+    pick = Rand32() % (ix + 1);         // Entry to move out of the way.
+    if(pick != ix)
+      list[ix] = list[pick];
+    list[pick] = ix;
+  }
+}
@@ -0,0 +1,81 @@
+// Reorder - renumber a network's units in the order they are processed.
+//
+// Usage: reorder infile outfile
+//
+// The units are renumbered so that each follows the units it takes input
+// from -- the input units first, then the internal units, breadth first,
+// then the output units -- and each unit's inputs are sorted to match (see
+// Network::Reorder()).  A unit's inputs then lie close together, often in
+// runs, so the passes read them from a few cache lines rather than from all
+// over the network, and layers whose units were defined out of order can be
+// processed as dense groups.  The input and output units keep their order,
+// so the network is run with the same data as before.
+//
+// The network is written to the output file as an image.  The share of
+// the connections read in runs, and the number of units processed in dense
+// groups, are written to stdout before and after.
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nwclass.h"
+
+// Describe how the frozen network's inputs are laid out.
+
+static void Report(const char *when, Network *net)
+{
+  unsigned long unit, ix, conn = 0, runs = 0, dense = 0;
+
+  for(unit = 0; unit < net->NumUnits; unit++)
+    for(ix = net->RowStart[unit] + 1; ix < net->RowStart[unit + 1]; ix++)
+      if(net->SrcIdx[ix] == net->SrcIdx[ix - 1] + 1)
+        runs++;
+  conn = net->RowStart[net->NumUnits];
+
+  for(ix = 0; ix < net->NumLayers; ix++)
+    if(net->Layers[ix].Dense)
+      dense += net->Layers[ix].Num;
+
+  printf("%s: %lu of %lu connections in runs; %lu of %lu units in dense "
+         "groups.\n", when, runs, conn, dense, net->NumUnits - net->NumInput);
+}
+
+int main(int argc, char *argv[])
+{
+  Network   net;
+  NWErr     nwErr;
+
+  if(argc != 3)
+  {
+    fprintf(stderr, "Usage: %s infile outfile\n", argv[0]);
+    exit(1);
+  }
+
+  if((nwErr = net.Open(argv[1])) != NW_SUCCESS ||
+     (nwErr = net.SetupExec()) != NW_SUCCESS ||
+     (nwErr = net.Freeze()) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[1], net.ErrMsg(nwErr));
+    exit(1);
+  }
+  Report("Before", &net);
+
+  if((nwErr = net.Reorder(NULL)) != NW_SUCCESS ||
+     (nwErr = net.SetupExec()) != NW_SUCCESS ||
+     (nwErr = net.Freeze()) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[1], net.ErrMsg(nwErr));
+    exit(1);
+  }
+  Report("After", &net);
+
+  if((nwErr = net.Save(argv[2])) != NW_SUCCESS)
+  {
+    fprintf(stderr, "%s: %s\n", argv[2], net.ErrMsg(nwErr));
+    exit(1);
+  }
+
+  return(0);
+}
@@ -0,0 +1,419 @@
+/*****************************************************************************
+  File:     scalar.cpp
+
+  Purpose:  This file contains the scalar set of numeric kernels: plain C
+            versions of the kernels in kernel.cpp, one element at a time.
+            They are the fallback for CPUs without any of the vector sets,
+            and the reference the vector sets are held to.
+
+  Each kernel here computes the same operations, in the same order, as the
+  vector kernels do (see kernel.cpp): a dot product is split into four
+  interleaved partial sums, combined as (s0 + s1) + (s2 + s3), and the
+  remaining elements are then added in order.  Without fused multiply-adds
+  every set therefore gives exactly these results.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "nwclass.h"
+
+#define SIG_POLY_MAX  700.0             // As in kernel.cpp.
+#define SIG_TABLE_MAX 16
+#define SIG_TABLE_RES 64
+#define SIG_TABLE_LEN (2 * SIG_TABLE_MAX * SIG_TABLE_RES + 1)
+
+/*****************************************************************************
+  Function:   Dot()
+  Purpose:    This function computes the dot product of two vectors.
+  Parameters: const double *x           First vector.
+              const double *y           Second vector.
+              unsigned long n           Number of elements.
+  Returns:    The dot product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static double Dot(const double *x,const double *y,unsigned long n)
+{
+  unsigned long ix,n4 = n & ~3UL;
+  double        s0 = 0.0,s1 = 0.0,s2 = 0.0,s3 = 0.0,sum;
+
+  for(ix = 0;ix < n4;ix += 4)
+  {
+    s0 += x[ix] * y[ix];
+    s1 += x[ix + 1] * y[ix + 1];
+    s2 += x[ix + 2] * y[ix + 2];
+    s3 += x[ix + 3] * y[ix + 3];
+  }
+
+  sum = (s0 + s1) + (s2 + s3);
+  for(;ix < n;ix++)
+    sum += x[ix] * y[ix];
+
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   Axpy()
+  Purpose:    This function adds a multiple of one vector to another
+              (y += a * x).
+  Parameters: unsigned long n           Number of elements.
+              double a                  Multiplier.
+              const double *x           Vector to be scaled and added.
+              double *y                 Vector to be updated.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Axpy(unsigned long n,double a,const double *x,double *y)
+{
+  unsigned long ix;
+
+  for(ix = 0;ix < n;ix++)
+    y[ix] += a * x[ix];
+}
+
+/*****************************************************************************
+  Function:   Gemv()
+  Purpose:    This function multiplies a row-major matrix by a vector, adding
+              the result to another vector (y += W * x).
+  Parameters: unsigned long rows        Number of rows in W.
+              unsigned long cols        Number of columns in W (and
+                                        elements in x).
+              const double *w           The matrix; rows follow each other
+                                        with no gaps.
+              const double *x           Vector to be multiplied.
+              double *y                 Vector to receive the result.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Gemv(unsigned long rows,unsigned long cols,const double *w,
+                 const double *x,double *y)
+{
+  unsigned long ix;
+
+  for(ix = 0;ix < rows;ix++)
+    y[ix] += Dot(w + ix * cols,x,cols);
+}
+
+/*****************************************************************************
+  Function:   Gemm()
+  Purpose:    This function multiplies a row-major matrix by each of a
+              number of vectors, adding the results to a second set of
+              vectors (y[b] += W * x[b]).
+  Parameters: unsigned long rows        Number of rows in W.
+              unsigned long cols        Number of columns in W (and
+                                        elements in each x).
+              const double *w           The matrix; rows follow each other
+                                        with no gaps.
+              unsigned long num         Number of vectors.
+              const double *x           First vector to be multiplied.
+              unsigned long ldx         Distance between vectors in x.
+              double *y                 First vector to receive a result.
+              unsigned long ldy         Distance between vectors in y.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Gemm(unsigned long rows,unsigned long cols,const double *w,
+                 unsigned long num,const double *x,unsigned long ldx,
+                 double *y,unsigned long ldy)
+{
+  unsigned long bx;
+
+  for(bx = 0;bx < num;bx++)
+    Gemv(rows,cols,w,x + bx * ldx,y + bx * ldy);
+}
+
+/*****************************************************************************
+  Function:   DotFT()
+  Purpose:    This function computes the dot product of a vector of
+              single-precision weights with a vector of doubles, in the
+              arithmetic of T (float or double).
+  Parameters: const float *w            Weights.
+              const double *x           Vector.
+              unsigned long n           Number of elements.
+  Returns:    The dot product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+template <class T>
+static T DotFT(const float *w,const double *x,unsigned long n)
+{
+  unsigned long ix,n4 = n & ~3UL;
+  T             s0 = 0,s1 = 0,s2 = 0,s3 = 0,sum;
+
+  for(ix = 0;ix < n4;ix += 4)
+  {
+    s0 += (T)w[ix] * (T)x[ix];
+    s1 += (T)w[ix + 1] * (T)x[ix + 1];
+    s2 += (T)w[ix + 2] * (T)x[ix + 2];
+    s3 += (T)w[ix + 3] * (T)x[ix + 3];
+  }
+
+  sum = (s0 + s1) + (s2 + s3);
+  for(;ix < n;ix++)
+    sum += (T)w[ix] * (T)x[ix];
+
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   DotF()
+  Purpose:    This function computes the dot product of a vector of
+              single-precision weights with a vector of doubles.
+  Parameters: const float *w            Weights.
+              const double *x           Vector.
+              unsigned long n           Number of elements.
+              int single                If TRUE, the products are formed and
+                                        summed in single precision; if
+                                        FALSE, in double precision.
+  Returns:    The dot product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static double DotF(const float *w,const double *x,unsigned long n,
+                   int single)
+{
+  if(single)
+    return(DotFT<float>(w,x,n));
+  return(DotFT<double>(w,x,n));
+}
+
+/*****************************************************************************
+  Function:   AxpyF()
+  Purpose:    This function adds a multiple of a vector of single-precision
+              weights to a vector of doubles (y += a * x), in double
+              precision.
+  Parameters: unsigned long n           Number of elements.
+              double a                  Multiplier.
+              const float *x            Vector to be scaled and added.
+              double *y                 Vector to be updated.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void AxpyF(unsigned long n,double a,const float *x,double *y)
+{
+  unsigned long ix;
+
+  for(ix = 0;ix < n;ix++)
+    y[ix] += a * x[ix];
+}
+
+/*****************************************************************************
+  Function:   GemmF()
+  Purpose:    This function is Gemm() for a matrix of single-precision
+              weights.
+  Parameters: As Gemm(), and:
+              int single                If TRUE, the products are formed and
+                                        summed in single precision; if
+                                        FALSE, in double precision.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void GemmF(unsigned long rows,unsigned long cols,const float *w,
+                  unsigned long num,const double *x,unsigned long ldx,
+                  double *y,unsigned long ldy,int single)
+{
+  unsigned long bx,ix;
+
+  for(bx = 0;bx < num;bx++)
+    for(ix = 0;ix < rows;ix++)
+      y[bx * ldy + ix] += DotF(w + ix * cols,x + bx * ldx,cols,single);
+}
+
+/*****************************************************************************
+  Function:   DotQ()
+  Purpose:    This function computes the dot product of two vectors of
+              8-bit integers, exactly.
+  Parameters: const signed char *x      First vector.
+              const signed char *y      Second vector.
+              unsigned long n           Number of elements.
+  Returns:    The dot product.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static long DotQ(const signed char *x,const signed char *y,unsigned long n)
+{
+  unsigned long ix;
+  long          sum = 0;
+
+  for(ix = 0;ix < n;ix++)
+    sum += x[ix] * y[ix];
+
+  return(sum);
+}
+
+/*****************************************************************************
+  Function:   SigmoidPoly()
+  Purpose:    This function computes the sigmoid function of a value by way
+              of the polynomial approximation of exp() that kernel.cpp's
+              SigmoidPoly() uses, step for step.
+  Parameters: double x                  The value.
+  Returns:    The sigmoid function of the value.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static double SigmoidPoly(double x)
+{
+  const double shift = 6755399441055744.0;      // 1.5 * 2^52.
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+  double       t,k,r,p,scale;
+  long long    bits,base;
+
+  t = -x;
+  if(t > SIG_POLY_MAX)
+    t = SIG_POLY_MAX;
+  if(t < -SIG_POLY_MAX)
+    t = -SIG_POLY_MAX;
+
+  k = t * M_LOG2E + shift;
+  memcpy(&bits,&k,sizeof(bits));
+  memcpy(&base,&shift,sizeof(base));
+  bits -= base;
+  k -= shift;
+  r = (t - k * ln2_hi) - k * ln2_lo;
+
+  p = r * (1.0 / 479001600.0) + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+
+  bits = (bits + 1023) << 52;           // 2^k.
+  memcpy(&scale,&bits,sizeof(scale));
+  return(1.0 / (1.0 + p * scale));
+}
+
+/*****************************************************************************
+  Function:   BuildSigmoidTable()
+  Purpose:    This function builds the table of the sigmoid function used
+              by SIG_TABLE, as kernel.cpp's does.
+  Parameters: None.
+  Returns:    The table.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static const double *BuildSigmoidTable(void)
+{
+  static double table[SIG_TABLE_LEN + 1];
+  unsigned long ix;
+
+  for(ix = 0;ix < SIG_TABLE_LEN;ix++)
+    table[ix] = 1.0 / (1.0 + exp(SIG_TABLE_MAX - (double)ix / SIG_TABLE_RES));
+  table[SIG_TABLE_LEN] = table[SIG_TABLE_LEN - 1];
+
+  return(table);
+}
+
+/*****************************************************************************
+  Function:   Sigmoid()
+  Purpose:    This function computes the sigmoid function, 1 / (1 + e^-x),
+              of each of a vector of values (see kernel.cpp's Sigmoid()).
+  Parameters: unsigned long n           Number of values.
+              const double *x           Values.
+              double *y                 Receives the results; may be x.
+              int mode                  How to compute them (SIG_xxx).
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Sigmoid(unsigned long n,const double *x,double *y,int mode)
+{
+  unsigned long ix;
+  double        pos,frac;
+  long          entry;
+
+  if(mode == SIG_POLY)
+  {
+    for(ix = 0;ix < n;ix++)
+      y[ix] = SigmoidPoly(x[ix]);
+  }
+  else if(mode == SIG_TABLE)
+  {
+    static const double *table = BuildSigmoidTable();  // Built once.
+
+    for(ix = 0;ix < n;ix++)
+    {
+      pos = (x[ix] + SIG_TABLE_MAX) * SIG_TABLE_RES;
+      pos = pos > 0.0 ? pos : 0.0;      // Also takes NaN to 0.
+      pos = pos < SIG_TABLE_LEN - 1 ? pos : SIG_TABLE_LEN - 1;
+      entry = (long)pos;
+      frac  = pos - entry;
+      y[ix] = table[entry] + frac * (table[entry + 1] - table[entry]);
+    }
+  }
+  else                                  // SIG_EXACT.
+  {
+    for(ix = 0;ix < n;ix++)
+      y[ix] = 1.0 / (1.0 + exp(-x[ix]));
+  }
+}
+
+/*****************************************************************************
+  Function:   Sell()
+  Purpose:    This function forms the weighted sums of a slice of a sparse
+              group (see sparse.cpp), adding them to y.
+  Parameters: unsigned long len         Entries per unit.
+              const unsigned int *idx   Input units of the entries.
+              const double *w           Weights of the entries.
+              const double *x           Activation levels.
+              double *y                 The SELL_LANES sums; updated.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Sell(unsigned long len,const unsigned int *idx,const double *w,
+                 const double *x,double *y)
+{
+  unsigned long ix,lane;
+
+  for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+    for(lane = 0;lane < SELL_LANES;lane++)
+      y[lane] += x[idx[lane]] * w[lane];
+}
+
+/*****************************************************************************
+  Function:   SellF()
+  Purpose:    This function is Sell() for a slice of single-precision
+              weights.
+  Parameters: As Sell(), and:
+              const float *w            Weights of the entries.
+              int single                If TRUE, the products are formed and
+                                        summed in single precision, from
+                                        zero, and each sum is then added to
+                                        y; if FALSE, they are formed in
+                                        double precision and added to y.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void SellF(unsigned long len,const unsigned int *idx,const float *w,
+                  const double *x,double *y,int single)
+{
+  unsigned long ix,lane;
+  float         f[SELL_LANES];
+
+  if(!single)
+  {
+    for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+      for(lane = 0;lane < SELL_LANES;lane++)
+        y[lane] += x[idx[lane]] * w[lane];
+    return;
+  }
+
+  for(lane = 0;lane < SELL_LANES;lane++)
+    f[lane] = 0.0f;
+  for(ix = 0;ix < len;ix++,idx += SELL_LANES,w += SELL_LANES)
+    for(lane = 0;lane < SELL_LANES;lane++)
+      f[lane] += (float)x[idx[lane]] * w[lane];
+  for(lane = 0;lane < SELL_LANES;lane++)
+    y[lane] += f[lane];
+}
+
+/*****************************************************************************
+  The scalar set of kernels.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+const NWKernelSet NWKernelsScalar =
+{
+  Dot,Axpy,Gemv,Gemm,DotF,AxpyF,GemmF,DotQ,Sigmoid,Sell,SellF
+};
@@ -0,0 +1,308 @@
+/*****************************************************************************
+  File:     sparse.cpp
+
+  Purpose:  This file contains the code which lays out the sparse groups of
+            a network's units (see Network::FindLayers()) for the sparse
+            kernel, NWSell().
+
+  The units of a sparse group lie on one level of the network, so none of
+  them takes input from another, and they can be summed side by side.  They
+  are taken in slices of SELL_LANES units, and the input lists of a slice's
+  units are interleaved: entry k of the unit in lane l is at entry
+  k * SELL_LANES + l of the slice, in SellIdx (the input unit) and SellWgt
+  or SellWgtF (the weight).  A slice is as long as the longest input list
+  in it, the shorter lists being padded with zero weights; to keep the
+  padding down, the units of a group are sorted by the lengths of their
+  input lists, the longest first, before they are sliced.  This is the
+  sliced ELLPACK (SELL) layout.  The sparse kernel then reads one entry for
+  each of a slice's units at a time, gathering the activation levels they
+  name into a vector.
+
+  The slices' weights are a copy of those in Wgt, held in SellWgt, unless
+  the network has a single-precision copy of its weights, WgtF (see
+  Network::SetPrecision()); they are then a copy of WgtF, held in SellWgtF
+  at half the size, and only one copy is kept.  SyncWeights() keeps them up
+  to date.  Each unit's sum is formed in the order of its input list, as it
+  would be a unit at a time, so the slices give the same results.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nwclass.h"
+
+#define SELL_MIN      4                 // Fewest units worth slicing.
+
+struct NWRow                            // Unit being sliced.
+{
+  unsigned long   Len;                  // Length of its input list.
+  unsigned long   Unit;                 // The unit.
+};
+
+/*****************************************************************************
+  Function:   CompareRows()
+  Purpose:    This function compares two units by the lengths of their
+              input lists, for qsort(), putting the longer first.  Units of
+              equal length are kept in order.
+  Parameters: const void *a             The first unit.
+              const void *b             The second.
+  Returns:    Less than, equal to, or greater than zero, as the first unit
+              comes before, with, or after the second.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int CompareRows(const void *a,const void *b)
+{
+  const NWRow    *row_a = (const NWRow *)a;
+  const NWRow    *row_b = (const NWRow *)b;
+
+  if(row_a->Len != row_b->Len)
+    return(row_a->Len > row_b->Len ? -1 : 1);
+  return(row_a->Unit < row_b->Unit ? -1 : row_a->Unit > row_b->Unit);
+}
+
+/*****************************************************************************
+  Function:   Network::BuildSlices()
+  Purpose:    This function lays out the sparse groups in slices (see
+              above).  A group of fewer than SELL_MIN units is left to be
+              processed a unit at a time, as are all groups of a network
+              too large for the kernel's 32-bit indices.  It is called by
+              FindLayers().
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::BuildSlices(void)
+{
+  unsigned long   lx,ix,jx,lane,entry,num,row,len,pos,src;
+  NWLayer        *layer;
+  NWSlice        *slice;
+  NWRow          *rows;
+
+  FreeSlices();
+
+  if(NumUnits > INT_MAX)                // Too large to gather.
+    return(NW_SUCCESS);
+
+  if((rows = new NWRow[NumUnits]) == NULL)
+    return(NW_ERR_MEMORY);
+
+// Sort the units of each group, and count the slices and their entries.
+//   A group's units are sorted in place in rows, at their positions in
+//   ExecSeq.
+
+  NumSlices = entry = 0;
+  for(lx = 0;lx < NumLayers;lx++)
+  {
+    layer = &Layers[lx];
+    if(layer->Dense || layer->Num < SELL_MIN)
+      continue;
+
+    for(ix = layer->Seq;ix < layer->Seq + layer->Num;ix++)
+    {
+      rows[ix].Unit = ExecSeq[ix];
+      rows[ix].Len  = RowStart[ExecSeq[ix] + 1] - RowStart[ExecSeq[ix]];
+    }
+    qsort(&rows[layer->Seq],layer->Num,sizeof(NWRow),CompareRows);
+
+    layer->Slice    = NumSlices;
+    layer->NumSlice = (layer->Num + SELL_LANES - 1) / SELL_LANES;
+    NumSlices += layer->NumSlice;
+    for(ix = layer->Seq;ix < layer->Seq + layer->Num;ix += SELL_LANES)
+      entry += rows[ix].Len * SELL_LANES;
+  }
+
+  if(NumSlices == 0)                    // Nothing to slice.
+  {
+    delete[] rows;
+    return(NW_SUCCESS);
+  }
+
+  if((Slices = new NWSlice[NumSlices]) == NULL ||
+     (SellIdx = new unsigned int[entry + 1]) == NULL ||
+     (SellStart = new unsigned long[NumUnits]) == NULL)
+  {
+    delete[] rows;
+    FreeSlices();
+    return(NW_ERR_MEMORY);
+  }
+  for(ix = 0;ix < NumUnits;ix++)
+    SellStart[ix] = (unsigned long)(-1);
+
+// Fill in the slices.  A short input list is padded with its own last
+//   input (or unit 0), so that padding reads nothing out of the way.
+
+  entry = 0;
+  for(lx = 0;lx < NumLayers;lx++)
+  {
+    layer = &Layers[lx];
+    for(ix = 0;ix < layer->NumSlice;ix++)
+    {
+      slice = &Slices[layer->Slice + ix];
+      pos   = layer->Seq + ix * SELL_LANES;
+      num   = layer->Num - ix * SELL_LANES;
+
+      slice->Entry   = entry;
+      slice->Len     = rows[pos].Len;
+      slice->Num     = num < SELL_LANES ? num : SELL_LANES;
+      slice->Sigmoid = TRUE;
+
+      for(lane = 0;lane < SELL_LANES;lane++)
+      {
+        if(lane >= slice->Num)          // Unused lane.
+        {
+          slice->Unit[lane] = slice->Unit[0];
+          for(jx = 0;jx < slice->Len;jx++)
+            SellIdx[entry + jx * SELL_LANES + lane] = 0;
+          continue;
+        }
+
+        slice->Unit[lane] = rows[pos + lane].Unit;
+        if(UnitFlags[slice->Unit[lane]] & (UFLAG_BINARY | UFLAG_LINEAR))
+          slice->Sigmoid = FALSE;
+
+        row = RowStart[slice->Unit[lane]];
+        len = rows[pos + lane].Len;
+        src = len ? SrcIdx[row + len - 1] : 0;
+        SellStart[slice->Unit[lane]] = entry + lane;
+        for(jx = 0;jx < slice->Len;jx++)
+          SellIdx[entry + jx * SELL_LANES + lane] =
+            jx < len ? SrcIdx[row + jx] : src;
+      }
+
+      entry += slice->Len * SELL_LANES;
+    }
+  }
+
+  delete[] rows;
+  return(SliceWeights());
+}
+
+/*****************************************************************************
+  Function:   Network::SliceWeights()
+  Purpose:    This function lays out the weights of the slices (see above):
+              in SellWgtF if the network has a single-precision copy of its
+              weights, and otherwise in SellWgt.  The padding is given zero
+              weights.  It is called by BuildSlices(), and by SetPrecision()
+              when the single-precision copy is made or released.  If there
+              is not enough memory the slices are freed, and the sparse
+              groups are processed a unit at a time.
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::SliceWeights(void)
+{
+  unsigned long   entry;
+  const NWSlice  *last;
+
+  delete[] SellWgt;
+  delete[] SellWgtF;
+  SellWgt  = NULL;
+  SellWgtF = NULL;
+
+  if(NumSlices == 0)                    // Nothing sliced.
+    return(NW_SUCCESS);
+
+  last  = &Slices[NumSlices - 1];
+  entry = last->Entry + last->Len * SELL_LANES;
+
+  if(WgtF != NULL)                      // Follow the single-precision copy.
+  {
+    if((SellWgtF = new float[entry + 1]) == NULL)
+    {
+      FreeSlices();
+      return(NW_ERR_MEMORY);
+    }
+    memset(SellWgtF,0,(entry + 1) * sizeof(float));
+  }
+  else
+  {
+    if((SellWgt = new double[entry + 1]) == NULL)
+    {
+      FreeSlices();
+      return(NW_ERR_MEMORY);
+    }
+    memset(SellWgt,0,(entry + 1) * sizeof(double));
+  }
+
+  SyncSlices(0,RowStart[NumUnits]);
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::FreeSlices()
+  Purpose:    This function frees the slices of the sparse groups.  The
+              groups are left to be processed a unit at a time.
+  Parameters: None.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::FreeSlices(void)
+{
+  unsigned long   lx;
+
+  delete[] Slices;
+  delete[] SellIdx;
+  delete[] SellWgt;
+  delete[] SellWgtF;
+  delete[] SellStart;
+
+  Slices = NULL;
+  NumSlices = 0;
+  SellIdx = NULL;
+  SellWgt = NULL;
+  SellWgtF = NULL;
+  SellStart = NULL;
+
+  for(lx = 0;lx < NumLayers;lx++)
+    Layers[lx].Slice = Layers[lx].NumSlice = 0;
+}
+
+/*****************************************************************************
+  Function:   Network::SyncSlices()
+  Purpose:    This function copies a run of the interconnection weights to
+              the slices: from WgtF to SellWgtF, or from Wgt to SellWgt,
+              whichever the slices hold.  It is called by SyncWeights().
+  Parameters: unsigned long first       First weight (index into Wgt).
+              unsigned long num         Number of weights.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void Network::SyncSlices(unsigned long first,unsigned long num)
+{
+  unsigned long   unit,cnt,half,end,stop,base,ix;
+
+  if(SellStart == NULL || num == 0)     // No slices.
+    return;
+
+  for(unit = 0,cnt = NumUnits;cnt > 0;) // Find the unit holding the first.
+  {
+    half = cnt >> 1;
+    if(RowStart[unit + half + 1] <= first)
+    {
+      unit += half + 1;
+      cnt  -= half + 1;
+    }
+    else
+      cnt = half;
+  }
+
+  for(end = first + num;first < end;unit++,first = stop)
+  {
+    stop = RowStart[unit + 1] < end ? RowStart[unit + 1] : end;
+    if(SellStart[unit] == (unsigned long)(-1))
+      continue;                         // Unit is not in a slice.
+
+// Weight ix of the unit lies at base + ix * SELL_LANES.  base alone may
+//   wrap around, but the sum comes out right.
+
+    base = SellStart[unit] - RowStart[unit] * SELL_LANES;
+    if(SellWgtF != NULL)
+      for(ix = first;ix < stop;ix++)
+        SellWgtF[base + ix * SELL_LANES] = WgtF[ix];
+    else
+      for(ix = first;ix < stop;ix++)
+        SellWgt[base + ix * SELL_LANES] = Wgt[ix];
+  }
+}
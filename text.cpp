@@ -0,0 +1,509 @@
+/*****************************************************************************
+  File:     text.cpp
+
+  Purpose:  This file contains the code for reading numbers from text: the
+            training data read by train, the records served by exec, and
+            the text converted by dsconv.
+
+  Text is read a line at a time, each line holding a row of numbers
+  separated by spaces or tabs.  There is no limit on the length of a line.
+
+  Numbers are read without regard to the locale (the decimal point is
+  always '.').  Most numbers -- those with no more than 19 significant
+  digits and a power of ten no larger than 10^22 -- are read directly, the
+  digits being gathered into an integer which is then multiplied or divided
+  by an exact power of ten; this gives the correctly rounded result, as
+  both operands are exact.  Anything else (very long or very large or small
+  numbers, infinities and NaNs) is handed to the C library's strtod() in
+  the "C" locale, so that the result is always the same as strtod()'s.
+
+  A block of text is parsed by several threads at once.  It is split at
+  line boundaries into a piece per thread; each thread first counts the
+  rows in its piece, so that each piece's rows can be given their place
+  in the result, and then parses them straight into it.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <locale.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nwclass.h"
+
+#define TEXT_MAXDIGITS  19              // Most digits read directly.
+#define TEXT_PIECE      (1 << 18)       // Least text worth a thread.
+#define TEXT_READ       (1 << 20)       // Least read from a stream.
+
+static const double Pow10[] =           // Exact powers of ten.
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static locale_t         CLocale;        // The "C" locale, for strtod_l().
+static pthread_once_t   CLocaleOnce = PTHREAD_ONCE_INIT;
+
+struct NWTextPiece                      // Part of a block of text, parsed by
+{                                       //   a thread of its own.
+  const char     *Start,*End;           // The text.
+  unsigned long   Width;                // Numbers per row.
+  unsigned long   Lines;                // Lines in the text.
+  unsigned long   Rows;                 // Rows (non-blank lines) in it.
+  double         *Out;                  // Where its rows go.
+  unsigned long   Bad;                  // First bad line (from 1), or 0.
+  pthread_t       Thread;               // Thread working on the piece.
+  int             Started;              // If TRUE, thread has been started.
+};
+
+/*****************************************************************************
+  Function:   MakeCLocale()
+  Purpose:    This function creates the "C" locale, once.
+  Parameters: None.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void MakeCLocale(void)
+{
+  CLocale = newlocale(LC_ALL_MASK,"C",(locale_t)0);
+}
+
+/*****************************************************************************
+  Function:   IsSpace()
+  Purpose:    This function checks for a character that separates numbers.
+  Parameters: char ch                   The character.
+  Returns:    TRUE if it is a space, tab, or carriage return.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static inline int IsSpace(char ch)
+{
+  return(ch == ' ' || ch == '\t' || ch == '\r');
+}
+
+/*****************************************************************************
+  Function:   NWParseReal()
+  Purpose:    This function reads a number from text.  The number must be
+              followed by a space, tab, carriage return, newline, or the end
+              of the text.
+  Parameters: const char *ptr           Start of the number.
+              const char *end           End of the text.
+              double *value             Receives the number.
+  Returns:    A pointer to the character following the number, or NULL if
+              there is no number there.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+const char *NWParseReal(const char *ptr,const char *end,double *value)
+{
+  const char     *start = ptr,*stop;
+  char            buf[128],*copy,*last;
+  uint64_t        mant = 0;
+  int             neg = FALSE,digits = 0,any = FALSE,exp10 = 0,exp = 0;
+  int             eneg = FALSE;
+  size_t          len;
+
+  if(ptr < end && (*ptr == '-' || *ptr == '+'))
+    neg = *ptr++ == '-';
+
+  while(ptr < end && *ptr == '0')       // Leading zeros.
+  {
+    ptr++;
+    any = TRUE;
+  }
+  for(;ptr < end && *ptr >= '0' && *ptr <= '9';ptr++,any = TRUE)
+  {
+    if(digits++ < TEXT_MAXDIGITS)
+      mant = mant * 10 + (*ptr - '0');
+    else
+      exp10++;
+  }
+  if(ptr < end && *ptr == '.')
+  {
+    ptr++;
+    if(digits == 0)                     // Zeros after the point.
+      for(;ptr < end && *ptr == '0';ptr++,any = TRUE)
+        exp10--;
+    for(;ptr < end && *ptr >= '0' && *ptr <= '9';ptr++,any = TRUE)
+      if(digits++ < TEXT_MAXDIGITS)
+      {
+        mant = mant * 10 + (*ptr - '0');
+        exp10--;
+      }
+  }
+  if(any && ptr < end && (*ptr == 'e' || *ptr == 'E'))
+  {
+    stop = ptr++;
+    if(ptr < end && (*ptr == '-' || *ptr == '+'))
+      eneg = *ptr++ == '-';
+    if(ptr == end || *ptr < '0' || *ptr > '9')
+      ptr = stop;                       // Not an exponent after all.
+    else
+      for(;ptr < end && *ptr >= '0' && *ptr <= '9';ptr++)
+        if(exp < 100000)
+          exp = exp * 10 + (*ptr - '0');
+  }
+  exp10 += eneg ? -exp : exp;
+
+  if(any && (ptr == end || IsSpace(*ptr) || *ptr == '\n') &&
+     digits <= TEXT_MAXDIGITS && mant <= (uint64_t)1 << 53 &&
+     exp10 >= -22 && exp10 <= 22)
+  {
+    *value = exp10 < 0 ? (double)mant / Pow10[-exp10]
+                       : (double)mant * Pow10[exp10];
+    if(neg)
+      *value = -*value;
+    return(ptr);
+  }
+
+// Leave anything else to strtod(), giving it a copy of the number (the
+//   text need not be terminated).
+
+  for(stop = start;stop < end && !IsSpace(*stop) && *stop != '\n';stop++)
+    ;
+  if((len = stop - start) == 0)
+    return(NULL);
+  if(len < sizeof(buf))
+    copy = buf;
+  else if((copy = (char *)malloc(len + 1)) == NULL)
+    return(NULL);
+  memcpy(copy,start,len);
+  copy[len] = '\0';
+
+  pthread_once(&CLocaleOnce,MakeCLocale);
+  if(CLocale != (locale_t)0)
+    *value = strtod_l(copy,&last,CLocale);
+  else
+    *value = strtod(copy,&last);
+  len = last - copy;
+  if(copy != buf)
+    free(copy);
+
+  return(start + len == stop ? stop : NULL);
+}
+
+/*****************************************************************************
+  Function:   ParseRow()
+  Purpose:    This function reads a row of numbers from a line of text.
+  Parameters: const char *ptr           Start of the line.
+              const char *end           End of the line (not including
+                                        the newline).
+              unsigned long width       Numbers in the row.
+              double *out               Receives the numbers.  If NULL, the
+                                        line is only checked for being blank.
+  Returns:    1 if the row was read, 0 if it was badly formatted, or -1 if
+              the line is blank.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static int ParseRow(const char *ptr,const char *end,unsigned long width,
+                    double *out)
+{
+  unsigned long   ix;
+
+  while(ptr < end && IsSpace(*ptr))
+    ptr++;
+  if(ptr == end)
+    return(-1);
+  if(out == NULL)
+    return(1);
+
+  for(ix = 0;ix < width;ix++)
+  {
+    while(ptr < end && IsSpace(*ptr))
+      ptr++;
+    if((ptr = NWParseReal(ptr,end,&out[ix])) == NULL)
+      return(0);
+  }
+
+  while(ptr < end && IsSpace(*ptr))
+    ptr++;
+  return(ptr == end);
+}
+
+/*****************************************************************************
+  Function:   NWParseLine()
+  Purpose:    This function reads a row of numbers from a line of text.
+  Parameters: const char *ptr           Start of the line.
+              const char *end           End of the line.
+              unsigned long width       Numbers in the row.
+              double *out               Receives the numbers.
+  Returns:    1 if the row was read, 0 if it was badly formatted (it does
+              not hold just width numbers), or -1 if the line is blank.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+int NWParseLine(const char *ptr,const char *end,unsigned long width,
+                double *out)
+{
+  if(end > ptr && end[-1] == '\n')
+    end--;
+  return(ParseRow(ptr,end,width,out));
+}
+
+/*****************************************************************************
+  Function:   CountMain()
+  Purpose:    This function counts the lines and rows in a piece of text.
+              It is the main function of the threads of the first pass of
+              NWParseText().
+  Parameters: void *arg                 The piece (NWTextPiece *).
+  Returns:    NULL.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void *CountMain(void *arg)
+{
+  NWTextPiece    *piece = (NWTextPiece *)arg;
+  const char     *ptr,*eol;
+
+  piece->Lines = piece->Rows = 0;
+  for(ptr = piece->Start;ptr < piece->End;ptr = eol + 1)
+  {
+    if((eol = (const char *)memchr(ptr,'\n',piece->End - ptr)) == NULL)
+      eol = piece->End;
+    piece->Lines++;
+    if(ParseRow(ptr,eol,piece->Width,NULL) > 0)
+      piece->Rows++;
+  }
+  return(NULL);
+}
+
+/*****************************************************************************
+  Function:   ParseMain()
+  Purpose:    This function parses the rows in a piece of text.  It is the
+              main function of the threads of the second pass of
+              NWParseText().
+  Parameters: void *arg                 The piece (NWTextPiece *).
+  Returns:    NULL.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void *ParseMain(void *arg)
+{
+  NWTextPiece    *piece = (NWTextPiece *)arg;
+  const char     *ptr,*eol;
+  unsigned long   line = 0;
+  double         *out = piece->Out;
+  int             k;
+
+  piece->Bad = 0;
+  for(ptr = piece->Start;ptr < piece->End;ptr = eol + 1)
+  {
+    if((eol = (const char *)memchr(ptr,'\n',piece->End - ptr)) == NULL)
+      eol = piece->End;
+    line++;
+    if((k = ParseRow(ptr,eol,piece->Width,out)) == 0)
+    {
+      piece->Bad = line;
+      break;
+    }
+    if(k > 0)
+      out += piece->Width;
+  }
+  return(NULL);
+}
+
+/*****************************************************************************
+  Function:   RunPieces()
+  Purpose:    This function runs a function on each piece of text, each in a
+              thread of its own (the last in the calling thread).
+  Parameters: NWTextPiece *pieces       The pieces.
+              int num                   Number of pieces.
+              void *(*func)(void *)     The function.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void RunPieces(NWTextPiece *pieces,int num,void *(*func)(void *))
+{
+  int             ix;
+
+  for(ix = 0;ix < num - 1;ix++)
+  {
+    pieces[ix].Started =
+      pthread_create(&pieces[ix].Thread,NULL,func,&pieces[ix]) == 0;
+    if(!pieces[ix].Started)             // Do it here instead.
+      func(&pieces[ix]);
+  }
+  func(&pieces[num - 1]);
+
+  for(ix = 0;ix < num - 1;ix++)
+    if(pieces[ix].Started)
+      pthread_join(pieces[ix].Thread,NULL);
+}
+
+/*****************************************************************************
+  Function:   NWParseText()
+  Purpose:    This function reads rows of numbers from a block of text, a
+              row per line; blank lines are skipped.
+  Parameters: const char *text          The text.  (It need not be
+                                        terminated.)
+              size_t len                Length of the text.
+              unsigned long width       Numbers in each row.
+              int threads               Most threads to use.  If 0, one per
+                                        processor.
+              double **rows             Receives the rows, width numbers
+                                        each, one after another, in an array
+                                        allocated by malloc() (or NULL if
+                                        there are none).
+              unsigned long *num_rows   Receives the number of rows.
+              unsigned long *line       If a line is badly formatted (does
+                                        not hold just width numbers),
+                                        receives its number (from 1).
+  Returns:    A NetWorks error value (0 on success).  If a line is badly
+              formatted, NW_ERR_BADFILE.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWParseText(const char *text,size_t len,unsigned long width,
+                  int threads,double **rows,unsigned long *num_rows,
+                  unsigned long *line)
+{
+  NWTextPiece    *pieces;
+  const char     *ptr,*split;
+  unsigned long   total = 0,lines = 0;
+  double         *out;
+  int             num,ix;
+
+  *rows = NULL;
+  *num_rows = 0;
+
+  if(threads <= 0 && (threads = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+    threads = 1;
+  if((size_t)threads > len / TEXT_PIECE)
+    threads = len / TEXT_PIECE > 0 ? len / TEXT_PIECE : 1;
+  if((pieces = new NWTextPiece[threads]) == NULL)
+    return(NW_ERR_MEMORY);
+
+// Split the text into pieces of about the same size, at line boundaries.
+
+  for(num = 0,ptr = text;num < threads && ptr < text + len;num++)
+  {
+    split = text + len / threads * (num + 1);
+    if(num == threads - 1 || split <= ptr)
+      split = text + len;
+    else if((split = (const char *)memchr(split,'\n',text + len - split))
+            == NULL)
+      split = text + len;
+    else
+      split++;
+
+    pieces[num].Start = ptr;
+    pieces[num].End   = split;
+    pieces[num].Width = width;
+    ptr = split;
+  }
+  if(num == 0)
+  {
+    delete[] pieces;
+    return(NW_SUCCESS);
+  }
+
+  RunPieces(pieces,num,CountMain);
+
+  for(ix = 0;ix < num;ix++)
+    total += pieces[ix].Rows;
+  if(total == 0)                        // No rows.
+  {
+    delete[] pieces;
+    return(NW_SUCCESS);
+  }
+  if((out = (double *)malloc(total * width * sizeof(double) + 1)) == NULL)
+  {
+    delete[] pieces;
+    return(NW_ERR_MEMORY);
+  }
+
+  for(ix = 0,total = 0;ix < num;ix++)   // Give each piece its place.
+  {
+    pieces[ix].Out = out + total * width;
+    total += pieces[ix].Rows;
+  }
+
+  RunPieces(pieces,num,ParseMain);
+
+  for(ix = 0;ix < num;ix++)
+  {
+    if(pieces[ix].Bad != 0)
+    {
+      *line = lines + pieces[ix].Bad;
+      free(out);
+      delete[] pieces;
+      return(NW_ERR_BADFILE);
+    }
+    lines += pieces[ix].Lines;
+  }
+
+  delete[] pieces;
+  *rows = out;
+  *num_rows = total;
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   NWReadText()
+  Purpose:    This function reads rows of numbers from the rest of a file
+              (see NWParseText()).  A regular file is mapped; anything else
+              is read in large blocks.
+  Parameters: FILE *handle              The file.
+              unsigned long width       Numbers in each row.
+              int threads               Most threads to use.  If 0, one per
+                                        processor.
+              double **rows             Receives the rows.
+              unsigned long *num_rows   Receives the number of rows.
+              unsigned long *line       If a line is badly formatted,
+                                        receives its number (from 1,
+                                        counting from the file's current
+                                        position).
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr NWReadText(FILE *handle,unsigned long width,int threads,
+                 double **rows,unsigned long *num_rows,unsigned long *line)
+{
+  struct stat     st;
+  char           *text = NULL,*temp;
+  off_t           pos;
+  size_t          len = 0,space = 0,got;
+  NWErr           nwErr;
+
+  pos = ftello(handle);
+  if(fstat(fileno(handle),&st) == 0 && S_ISREG(st.st_mode) && pos >= 0 &&
+     pos < st.st_size)
+  {
+    text = (char *)mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,
+                        fileno(handle),0);
+    if(text != (char *)MAP_FAILED)
+    {
+      madvise(text,st.st_size,MADV_SEQUENTIAL);
+      nwErr = NWParseText(text + pos,st.st_size - pos,width,threads,rows,
+                          num_rows,line);
+      munmap(text,st.st_size);
+      fseeko(handle,0,SEEK_END);
+      return(nwErr);
+    }
+    text = NULL;
+  }
+
+  for(;;)                               // Read it all, growing the buffer
+  {                                     //   geometrically.
+    if(space - len < TEXT_READ)
+    {
+      space = space * 2 + TEXT_READ;
+      if((temp = (char *)realloc(text,space)) == NULL)
+      {
+        free(text);
+        return(NW_ERR_MEMORY);
+      }
+      text = temp;
+    }
+    if((got = fread(text + len,1,space - len,handle)) == 0)
+      break;
+    len += got;
+  }
+  if(ferror(handle))
+  {
+    free(text);
+    return(NW_ERR_READING);
+  }
+
+  nwErr = NWParseText(text,len,width,threads,rows,num_rows,line);
+  free(text);
+  return(nwErr);
+}
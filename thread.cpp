@@ -0,0 +1,472 @@
+/*****************************************************************************
+  File:     thread.cpp
+
+  Purpose:  This file contains the network object's parallel training code.
+
+  A pool of threads trains on the shards of each batch of samples.  The
+  thread which calls TrainBatch() does the first shard itself, and the
+  pool's other threads do the rest; each has its own activation levels,
+  error values, and block of accumulated weight changes (laid out as the
+  network's Accum, which serves as the first thread's block).  Once every
+  shard has been done, the blocks are summed pairwise, as a tree: at each
+  level, every thread whose partner is still live adds the partner's block
+  into its own and clears the partner's.  The sum ends up in Accum and is
+  applied as usual.  Shards, and the order of the sums, depend only on the
+  number of threads, so a given thread count always gives the same result.
+
+  The pool can instead train asynchronously, Hogwild-style (TrainHogwild()):
+  each thread runs through its shard a sample at a time, passing it forward
+  and back and changing the shared weights at once, with no locking.  The
+  threads read weights that others are changing, and an update now and then
+  overwrites another thread's; for networks whose units have few inputs
+  each, such collisions are rare enough that SGD converges regardless, and
+  the threads never wait on each other within a batch.  The results depend
+  on how the threads happen to be scheduled.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "nwclass.h"
+
+struct NWWorker                         // Training thread.
+{
+  NWPool         *Pool;                 // Pool the thread belongs to.
+  int             Index;                // Thread's position in the pool.
+  pthread_t       Thread;               // Thread handle (unless first).
+  NWContext       Ctx;                  // Activation levels, error values.
+  double        **Accum;                // Accumulated weight changes.
+  double          SqErr;                // Sum of squared output errors.
+};
+
+struct NWPool                           // Pool of training threads.
+{
+  Network        *Net;                  // Network being trained.
+  int             Num;                  // Number of threads.
+  int             Running;              // If TRUE, threads have started.
+  int             Quit;                 // If TRUE, threads are to exit.
+  int             Hogwild;              // If TRUE, batch is asynchronous.
+  unsigned long   Size;                 // Doubles in each block of changes.
+  NWWorker       *Workers;              // The threads.
+  pthread_mutex_t Lock;                 // Held while threads are started.
+  pthread_barrier_t Barrier;            // Keeps the threads in step.
+
+// The batch currently being trained on.
+
+  unsigned long   Count;                // Number of samples.
+  const double   *Input;                // Input values.
+  const double   *Target;               // Target output values.
+  const double   *Eta;                  // Learning parameters.
+};
+
+/*****************************************************************************
+  Function:   RunShard()
+  Purpose:    This function trains a thread's shard of the current batch,
+              accumulating the weight changes in the thread's own block.
+  Parameters: NWWorker *worker          The thread.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void RunShard(NWWorker *worker)
+{
+  NWPool         *pool = worker->Pool;
+  Network        *net = pool->Net;
+  unsigned long   first,num;
+
+  first = pool->Count * worker->Index / pool->Num;
+  num   = pool->Count * (worker->Index + 1) / pool->Num - first;
+
+  worker->SqErr = 0.0;
+  if(num == 0)                          // Empty shard.
+    return;
+
+  net->ScaleInput(worker->Ctx.Act,num,pool->Input + first * net->NumInput);
+  net->Propagate(NULL,worker->Ctx.Act,num);
+  worker->SqErr = net->ApplyTargets(worker->Ctx.Act,worker->Ctx.Err,num,
+                                    pool->Target + first * net->NumOutput);
+  net->BackPropagate(worker->Ctx.Act,worker->Ctx.Err,num,pool->Eta + first,
+                     worker->Accum);
+}
+
+/*****************************************************************************
+  Function:   TrainSamples()
+  Purpose:    This function trains the network on a run of samples, one at a
+              time, changing the weights after each.  The network must be
+              frozen, and not be accumulating weight changes.
+  Parameters: Network *net              The network.
+              NWContext *ctx            State for one sample.
+              unsigned long num         Number of samples.
+              const double *input       Input values.
+              const double *target      Target output values.
+              const double *eta         Learning parameter for each sample.
+  Returns:    The sum of the squared output errors.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static double TrainSamples(Network *net,NWContext *ctx,unsigned long num,
+                           const double *input,const double *target,
+                           const double *eta)
+{
+  unsigned long   bx;
+  double          sq_err = 0.0;
+
+  for(bx = 0;bx < num;bx++)
+  {
+    net->ScaleInput(ctx->Act,1,input + bx * net->NumInput);
+    net->Propagate(NULL,ctx->Act,1);
+    sq_err += net->ApplyTargets(ctx->Act,ctx->Err,1,
+                                target + bx * net->NumOutput);
+    net->BackPropagate(ctx->Act,ctx->Err,1,&eta[bx],NULL);
+  }
+
+  return(sq_err);
+}
+
+/*****************************************************************************
+  Function:   RunHogwild()
+  Purpose:    This function trains a thread's shard of the current batch
+              asynchronously.
+  Parameters: NWWorker *worker          The thread.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void RunHogwild(NWWorker *worker)
+{
+  NWPool         *pool = worker->Pool;
+  Network        *net = pool->Net;
+  unsigned long   first,num;
+
+  first = pool->Count * worker->Index / pool->Num;
+  num   = pool->Count * (worker->Index + 1) / pool->Num - first;
+
+  worker->SqErr = TrainSamples(net,&worker->Ctx,num,
+                               pool->Input + first * net->NumInput,
+                               pool->Target + first * net->NumOutput,
+                               pool->Eta + first);
+}
+
+/*****************************************************************************
+  Function:   Reduce()
+  Purpose:    This function does a thread's part in summing the threads'
+              blocks of weight changes into the first thread's block.
+              Every thread of the pool must call it.
+  Parameters: NWWorker *worker          The thread.
+  Returns:    Nothing.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void Reduce(NWWorker *worker)
+{
+  NWPool         *pool = worker->Pool;
+  unsigned long   ix;
+  int             step;
+  double         *sum,*part;
+
+  for(step = 1;step < pool->Num;step <<= 1)
+  {
+    pthread_barrier_wait(&pool->Barrier);  // Previous level is done.
+
+    if(worker->Index % (2 * step) == 0 && worker->Index + step < pool->Num)
+    {
+      sum  = worker->Accum[0];
+      part = pool->Workers[worker->Index + step].Accum[0];
+      for(ix = 0;ix < pool->Size;ix++)
+      {
+        sum[ix] += part[ix];
+        part[ix] = 0.0;
+      }
+    }
+  }
+}
+
+/*****************************************************************************
+  Function:   WorkerMain()
+  Purpose:    This function is run by each of the pool's threads other than
+              the first.  It waits for a batch, does its shard and its part
+              of the sum, and waits again, until told to quit.
+  Parameters: void *arg                 The thread (NWWorker).
+  Returns:    NULL.
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void *WorkerMain(void *arg)
+{
+  NWWorker *worker = (NWWorker *)arg;
+
+  pthread_mutex_lock(&worker->Pool->Lock);  // Wait for the rest of the pool.
+  pthread_mutex_unlock(&worker->Pool->Lock);
+  if(worker->Pool->Quit)                // Pool could not be started.
+    return(NULL);
+
+  for(;;)
+  {
+    pthread_barrier_wait(&worker->Pool->Barrier);  // Wait for a batch.
+    if(worker->Pool->Quit)
+      break;
+
+    if(worker->Pool->Hogwild)
+      RunHogwild(worker);
+    else
+    {
+      RunShard(worker);
+      Reduce(worker);
+    }
+
+    pthread_barrier_wait(&worker->Pool->Barrier);  // Batch is done.
+  }
+
+  return(NULL);
+}
+
+/*****************************************************************************
+  Function:   Network::SetupThreads()
+  Purpose:    This function starts a pool of threads to share the work of
+              TrainBatch() (if the network has been set up with
+              SetupTrain(TRUE,FALSE)) or of TrainHogwild() (if it has been
+              set up with SetupTrain(FALSE,FALSE)).  The pool is stopped if
+              the network changes shape.
+  Parameters: int num                   Number of threads, including the
+                                        calling thread.  If 1 or less, any
+                                        pool is stopped, and training runs
+                                        on the calling thread alone.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::SetupThreads(int num)
+{
+  NWPool         *pool;
+  NWWorker       *worker;
+  unsigned long   ix;
+  int             tx;
+  NWErr           nwErr;
+
+  EndThreads();                         // Stop any previous pool.
+
+  if(num <= 1 || NumUnits == 0)         // Single thread.
+    return(NW_SUCCESS);
+  if(!Frozen && (nwErr = Freeze()) != NW_SUCCESS)
+    return(nwErr);
+
+  if((pool = new NWPool) == NULL)
+    return(NW_ERR_MEMORY);
+  memset(pool,0,sizeof(NWPool));
+  pool->Net  = this;
+  pool->Num  = num;
+  pool->Size = RowStart[NumUnits] + NumUnits;
+
+  if((pool->Workers = new NWWorker[num]) == NULL)
+  {
+    delete pool;
+    return(NW_ERR_MEMORY);
+  }
+  Pool = pool;
+
+  for(tx = 0;tx < num;tx++)             // Set up each thread's state.
+  {
+    worker = &pool->Workers[tx];
+    worker->Pool  = pool;
+    worker->Index = tx;
+    worker->Accum = NULL;
+    worker->SqErr = 0.0;
+
+    if(tx == 0 || Accum == NULL)        // First thread uses Accum itself.
+    {
+      worker->Accum = Accum;
+      continue;
+    }
+
+    if((worker->Accum = new double *[NumUnits]) == NULL ||
+       (worker->Accum[0] = new double[pool->Size]) == NULL)
+    {
+      pool->Num = tx + 1;
+      EndThreads();
+      return(NW_ERR_MEMORY);
+    }
+    memset(worker->Accum[0],0,pool->Size * sizeof(double));
+    for(ix = 1;ix < NumUnits;ix++)
+      worker->Accum[ix] = worker->Accum[0] + (Accum[ix] - Accum[0]);
+  }
+
+  pthread_barrier_init(&pool->Barrier,NULL,num);
+  pthread_mutex_init(&pool->Lock,NULL);
+  pthread_mutex_lock(&pool->Lock);
+
+  for(tx = 1;tx < num;tx++)             // Start the other threads.
+  {
+    if(pthread_create(&pool->Workers[tx].Thread,NULL,WorkerMain,
+                      &pool->Workers[tx]) != 0)
+    {                                   // Stop those already started.
+      pool->Quit = TRUE;
+      pthread_mutex_unlock(&pool->Lock);
+      while(--tx > 0)
+        pthread_join(pool->Workers[tx].Thread,NULL);
+      pthread_mutex_destroy(&pool->Lock);
+      pthread_barrier_destroy(&pool->Barrier);
+      EndThreads();
+      return(NW_ERR_MEMORY);
+    }
+  }
+
+  pool->Running = TRUE;
+  pthread_mutex_unlock(&pool->Lock);
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::EndThreads()
+  Purpose:    This function stops the pool of training threads, if any, and
+              releases its resources.
+  Parameters: None.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::EndThreads(void)
+{
+  NWPool         *pool = Pool;
+  NWWorker       *worker;
+  int             tx;
+
+  if(pool == NULL)                      // No pool.
+    return(NW_SUCCESS);
+
+  if(pool->Running)                     // Stop the threads.
+  {
+    pool->Quit = TRUE;
+    pthread_barrier_wait(&pool->Barrier);
+    for(tx = 1;tx < pool->Num;tx++)
+      pthread_join(pool->Workers[tx].Thread,NULL);
+    pthread_mutex_destroy(&pool->Lock);
+    pthread_barrier_destroy(&pool->Barrier);
+  }
+
+  for(tx = 0;tx < pool->Num;tx++)
+  {
+    worker = &pool->Workers[tx];
+    FreeContext(&worker->Ctx);
+    if(tx > 0 && worker->Accum != NULL)
+    {
+      delete[] worker->Accum[0];
+      delete[] worker->Accum;
+    }
+  }
+
+  delete[] pool->Workers;
+  delete pool;
+  Pool = NULL;
+
+  return(NW_SUCCESS);
+}
+
+/*****************************************************************************
+  Function:   Network::TrainParallel()
+  Purpose:    This function does the work of TrainBatch() on the pool of
+              training threads.  The network must be frozen.
+  Parameters: unsigned long num         Number of samples.
+              const double *input       Input values.
+              const double *target      Target output values.
+              const double *eta         Learning parameter for each sample.
+              double *sq_err            If not NULL, the sum of the squared
+                                        output errors is added to it.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::TrainParallel(unsigned long num,const double *input,
+                             const double *target,const double *eta,
+                             double *sq_err)
+{
+  NWPool         *pool = Pool;
+  unsigned long   shard;
+  int             tx;
+  NWErr           nwErr;
+
+  shard = (num + pool->Num - 1) / pool->Num;  // Largest shard.
+  for(tx = 0;tx < pool->Num;tx++)
+    if((nwErr = SetupContext(&pool->Workers[tx].Ctx,shard,TRUE)) != NW_SUCCESS)
+      return(nwErr);
+
+  pool->Hogwild = FALSE;
+  pool->Count   = num;
+  pool->Input   = input;
+  pool->Target  = target;
+  pool->Eta     = eta;
+
+  pthread_barrier_wait(&pool->Barrier); // Start the other threads.
+  RunShard(&pool->Workers[0]);
+  Reduce(&pool->Workers[0]);
+  pthread_barrier_wait(&pool->Barrier); // Wait for them to finish.
+
+  if(sq_err != NULL)
+    for(tx = 0;tx < pool->Num;tx++)
+      *sq_err += pool->Workers[tx].SqErr;
+
+  return(ApplyAccum());
+}
+
+/*****************************************************************************
+  Function:   Network::TrainHogwild()
+  Purpose:    This function trains the network on a batch of samples
+              asynchronously: the batch is split among the pool of training
+              threads started by SetupThreads(), and each thread trains on
+              its share a sample at a time, changing the shared weights
+              without locking (see above).  Without a pool, the samples are
+              trained on in order by the calling thread.  The network must
+              have been set up with SetupTrain(FALSE,FALSE).
+  Parameters: unsigned long num         Number of samples.
+              const double *input       Input values, as for TrainBatch().
+              const double *target      Target output values, as for
+                                        TrainBatch().
+              const double *eta         Learning parameter for each sample.
+              double *sq_err            If not NULL, the sum of the squared
+                                        output errors of the samples (each
+                                        before its own update) is added to
+                                        it.
+  Returns:    A NetWorks error value (0 on success).
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+NWErr Network::TrainHogwild(unsigned long num,const double *input,
+                            const double *target,const double *eta,
+                            double *sq_err)
+{
+  NWPool         *pool = Pool;
+  double          err = 0.0;
+  int             tx;
+  NWErr           nwErr;
+
+  if(NumUnits == 0 || num == 0)         // Nothing to do.
+    return(NW_SUCCESS);
+  if(Accum != NULL || Momentum != NULL) // Not updating weights directly.
+    return(NW_ERR_BADPARAM);
+
+  if(!Frozen && (nwErr = Freeze()) != NW_SUCCESS)
+    return(nwErr);
+
+  if(pool == NULL)                      // Calling thread alone.
+  {
+    if((nwErr = SetupContext(&Batch,1,TRUE)) != NW_SUCCESS)
+      return(nwErr);
+    err = TrainSamples(this,&Batch,num,input,target,eta);
+  }
+  else
+  {
+    for(tx = 0;tx < pool->Num;tx++)
+      if((nwErr = SetupContext(&pool->Workers[tx].Ctx,1,TRUE)) != NW_SUCCESS)
+        return(nwErr);
+
+    pool->Hogwild = TRUE;
+    pool->Count   = num;
+    pool->Input   = input;
+    pool->Target  = target;
+    pool->Eta     = eta;
+
+    pthread_barrier_wait(&pool->Barrier); // Start the other threads.
+    RunHogwild(&pool->Workers[0]);
+    pthread_barrier_wait(&pool->Barrier); // Wait for them to finish.
+
+    for(tx = 0;tx < pool->Num;tx++)
+      err += pool->Workers[tx].SqErr;
+  }
+
+  if(sq_err != NULL)
+    *sq_err += err;
+
+  return(NW_SUCCESS);
+}
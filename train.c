@@ -1,8 +1,59 @@
 // Training driver for neural network.
 //
+// Usage: train [-b batch-size] [-t threads] [-a] [-s seed] [-w weight-file]
+//              [-d data-file [-m window]] [-k block-size | -r]
+//              [-p precision] [-f sigmoid]
+//
+//   -b  Number of samples whose weight changes are accumulated and applied
+//       together (default 1, which updates the weights after every sample).
+//       The changes are summed, not averaged, so learning coefficients
+//       should be scaled down as the batch size grows.
+//   -t  Number of threads to split each batch among (default 1).  Without
+//       -b, the batch size becomes 32 samples per thread.  For a given seed
+//       and number of threads, the results are always the same on a given
+//       machine, and on every machine with NW_KERNELS=strict (see below).
+//   -a  Train asynchronously: each thread trains on its share of a batch a
+//       sample at a time, updating the shared weights as it goes, without
+//       waiting for the others (Hogwild).  The results vary from run to run.
+//   -s  Seed for the random-number generator (default is the time).
+//   -w  Checkpoint only the weights, to the given weight file: each
+//       checkpoint appends just the weights which have changed since the
+//       one before.  If the file exists, training resumes from the weights
+//       it holds.  The whole network is still saved at the end.
+//   -d  Take the training data from the given data set file (written by
+//       dsconv), rather than from stdin.  The file is mapped, not parsed,
+//       and its samples are fed to the network as they lie in it.
+//   -m  Stream the data set file rather than mapping it, for data sets
+//       larger than memory: it is read a chunk of about window samples at
+//       a time, the next chunk being read while the last is trained on.
+//       The samples are shuffled a chunk at a time -- the chunks are taken
+//       in random order, and the samples within each in random order.
+//   -k  Shuffle the samples in blocks of the given number of consecutive
+//       samples: the blocks are taken in random order, and the samples
+//       within each in random order.  Samples which lie together are used
+//       together, which is kinder to the cache than a full shuffle.
+//   -r  Sample with replacement: each pass draws as many samples as there
+//       are, each at random from all of them, rather than taking every
+//       sample once in a random order.
+//   -p  Precision of the arithmetic: "double", "single" (single-precision
+//       weights and sums, which halves the memory the weights are read
+//       from), or "mixed" (single-precision weights, double-precision
+//       sums).  The weights are still updated in double precision, but
+//       the network is saved in the precision chosen.  The default is the
+//       precision the network was saved in.
+//   -f  How to compute the sigmoid function: "exact" (the default, with the
+//       C library's exp()), "poly" (a vectorized polynomial approximation,
+//       within 1e-15), or "table" (an interpolated table, within 3e-6).
+//
+// The numeric kernels are chosen to suit the CPU.  The environment variable
+// NW_KERNELS may name the set to use ("scalar", "sse2", "avx2" or "avx512"),
+// and/or "strict", for arithmetic which gives the same results whichever set
+// is used, separated by commas (see dispatch.cpp).
+//
 // The first line of stdin specifies the network file to load.
 // The second line of stdin specifies the number of training iterations.
-// The remaining lines of stdin contain the following, whitespace-separated:
+// Without -d, the remaining lines of stdin contain the following,
+// whitespace-separated:
 //   Learning coefficient for this datum.
 //   Data for input units, in order of their definition.
 //   Target data for output units, in order of their definition.
@@ -12,103 +63,306 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <unistd.h>
 
 #include "nwclass.h"
 
-void main(void)
+// Choose the order in which to take samples 0 to num - 1: a random
+// permutation of them, taken in blocks of block samples, or (if replace is
+// TRUE) num samples drawn at random.  Blocks needs room for a number per
+// block.
+
+static void Order(unsigned long *order, unsigned long *blocks,
+                  unsigned long num, unsigned long block, int replace)
+{
+  unsigned long i, j, n, pos, start, num_blocks;
+
+  if(replace)
+  {
+    for(i = 0; i < num; i++)
+      order[i] = Rand32() % num;
+    return;
+  }
+
+  if(block <= 1)
+  {
+    RandPermute(order, num);
+    return;
+  }
+
+  num_blocks = (num + block - 1) / block;
+  RandPermute(blocks, num_blocks);
+  for(i = pos = 0; i < num_blocks; i++)
+  {
+    start = blocks[i] * block;
+    n = num - start < block ? num - start : block;
+    RandPermute(&order[pos], n);
+    for(j = 0; j < n; j++)
+      order[pos + j] += start;
+    pos += n;
+  }
+}
+
+// Return the precision (PREC_xxx) with the given name, or -1.
+
+static int Precision(const char *name)
+{
+  if(strcmp(name, "double") == 0)
+    return(PREC_DOUBLE);
+  if(strcmp(name, "single") == 0)
+    return(PREC_SINGLE);
+  if(strcmp(name, "mixed") == 0)
+    return(PREC_MIXED);
+  return(-1);
+}
+
+// Return the way of computing the sigmoid function (SIG_xxx) with the given
+// name, or -1.
+
+static int SigmoidMode(const char *name)
+{
+  if(strcmp(name, "exact") == 0)
+    return(SIG_EXACT);
+  if(strcmp(name, "poly") == 0)
+    return(SIG_POLY);
+  if(strcmp(name, "table") == 0)
+    return(SIG_TABLE);
+  return(-1);
+}
+
+int main(int argc, char *argv[])
 {
   char      buffer[1027];
   char      filename[1027];
-  char     *ptr;
-  int       iter_cnt, data_cnt = 0, i, j, k, l;
-  int      *touched = NULL;
-  double   *eta = NULL;
-  double  **input = NULL;
-  double  **output = NULL;
+  char     *weights = NULL, *data_file = NULL;
+  int       iter_cnt;
+  int       batch_size = 0, batch_cnt, i, k;
+  int       threads = 1, async = FALSE, replace = FALSE, prec = -1;
+  int       sig = SIG_EXACT;
+  unsigned long seed = time(NULL), block = 1;
+  unsigned long window = 0, num_chunks, chunk_first, chunk_num = 0, pos = 0;
+  unsigned long *chunk_order = NULL, *order = NULL, *blocks = NULL;
+  unsigned long order_space = 0, c;
+  unsigned long num_rows, line;
+  unsigned long data_cnt = 0, j, l;     // Samples may exceed INT_MAX.
+  double   *text = NULL;
+  const double *s_eta, *s_in, *s_out;
+  double   *batch_eta, *batch_in, *batch_out;
   double    rms;
   Network   net;
+  NWDataset data;
+  NWErr     nwErr;
+
+  while((i = getopt(argc, argv, "b:t:as:w:d:m:k:rp:f:")) != -1)
+  {
+    if(i == 'b' && (batch_size = atoi(optarg)) > 0)
+      continue;
+    if(i == 't' && (threads = atoi(optarg)) > 0)
+      continue;
+    if(i == 'a')
+    {
+      async = TRUE;
+      continue;
+    }
+    if(i == 's')
+    {
+      seed = strtoul(optarg, NULL, 0);
+      continue;
+    }
+    if(i == 'w')
+    {
+      weights = optarg;
+      continue;
+    }
+    if(i == 'd')
+    {
+      data_file = optarg;
+      continue;
+    }
+    if(i == 'm' && (window = strtoul(optarg, NULL, 0)) > 0)
+      continue;
+    if(i == 'k' && (block = strtoul(optarg, NULL, 0)) > 0)
+      continue;
+    if(i == 'r')
+    {
+      replace = TRUE;
+      continue;
+    }
+    if(i == 'p' && (prec = Precision(optarg)) >= 0)
+      continue;
+    if(i == 'f' && (sig = SigmoidMode(optarg)) >= 0)
+      continue;
+    fprintf(stderr,
+            "Usage: %s [-b batch-size] [-t threads] [-a] [-s seed] "
+            "[-w weight-file] [-d data-file [-m window]]\n"
+            "       [-k block-size | -r] [-p precision] [-f sigmoid]\n",
+            argv[0]);
+    exit(1);
+  }
+
+  if(window > 0 && data_file == NULL)
+    { fprintf(stderr, "-m needs a data set file (-d).\n"); exit(1); }
+
+  if(batch_size == 0)
+    batch_size = threads > 1 ? 32 * threads : 1;
 
   setpriority(PRIO_PROCESS, 0, 2);
 
-  Randomize32(time(NULL));
+  Randomize32(seed);
 
   fgets(filename, sizeof(filename), stdin);
   *strchr(filename, '\n') = '\0';
   net.Open(filename);
+  if(prec >= 0 && net.SetPrecision(prec) != NW_SUCCESS)
+    { fprintf(stderr, "Unable to set precision.\n"); exit(1); }
+  net.SetSigmoid(sig);
+
+  if(weights != NULL && access(weights, F_OK) == 0 &&
+     net.LoadWeights(weights) != NW_SUCCESS)
+    { fprintf(stderr, "Unable to load weights.\n"); exit(1); }
 
   fgets(buffer, sizeof(buffer), stdin);
   iter_cnt = atoi(buffer);
 
-  while(fgets(buffer, sizeof(buffer), stdin))
+  if(data_file != NULL)
   {
-    touched = (int *)realloc(touched, sizeof(int) * (data_cnt + 1));
-    eta = (double *)realloc(eta, sizeof(double) * (data_cnt + 1));
-    input = (double **)realloc(input, sizeof(double *) * (data_cnt + 1));
-    output = (double **)realloc(output, sizeof(double *) * (data_cnt + 1));
-    input[data_cnt] = (double *)malloc(net.NumInput * sizeof(double));
-    output[data_cnt] = (double *)malloc(net.NumOutput * sizeof(double));
-
-    if((ptr = strtok(buffer, " \t\n")) == NULL)
-      { fprintf(stderr, "Badly formatted input.\n"); exit(1); }
-    eta[data_cnt] = atof(ptr);
-    touched[data_cnt] = FALSE;
-
-    for(i = 0; i < net.NumInput; i++)
-    {
-      if((ptr = strtok(NULL, " \t\n")) == NULL)
-        { fprintf(stderr, "Badly formatted input.\n"); exit(1); }
-      input[data_cnt][i] = atof(ptr);
-    }
-
-    for(i = 0; i < net.NumOutput; i++)
-    {
-      if((ptr = strtok(NULL, " \t\n")) == NULL)
-        { fprintf(stderr, "Badly formatted input.\n"); exit(1); }
-      output[data_cnt][i] = atof(ptr);
-    }
+    if(window > 0)
+      nwErr = data.OpenStream(data_file, window, &num_chunks);
+    else
+      nwErr = data.Open(data_file);
+    if(nwErr != NW_SUCCESS)
+      { fprintf(stderr, "%s: %s\n", data_file, net.ErrMsg(nwErr)); exit(1); }
+    if(data.NumInput != net.NumInput || data.NumOutput != net.NumOutput)
+      { fprintf(stderr, "Data set does not fit network.\n"); exit(1); }
+    data_cnt = data.NumRows;
+    if(window > 0)
+      chunk_order = (unsigned long *)malloc((num_chunks + 1) *
+                                            sizeof(unsigned long));
+  }
 
-    data_cnt++;
+  if(data_file == NULL)                 // Read the samples from stdin.
+  {
+    nwErr = NWReadText(stdin, net.NumInput + net.NumOutput + 1, 0, &text,
+                       &num_rows, &line);
+    if(nwErr == NW_ERR_BADFILE)         // Count the first two lines.
+      fprintf(stderr, "Badly formatted input at line %lu.\n", line + 2);
+    else if(nwErr != NW_SUCCESS)
+      fprintf(stderr, "%s\n", net.ErrMsg(nwErr));
+    if(nwErr != NW_SUCCESS)
+      exit(1);
+    data_cnt = num_rows;
   }
 
-  net.SetupTrain(FALSE, FALSE);
+  net.SetupTrain(batch_size > 1 && !async, FALSE);
+  if(net.SetupThreads(batch_size > 1 || async ? threads : 1) != NW_SUCCESS)
+    { fprintf(stderr, "Unable to start threads.\n"); exit(1); }
+
+  batch_eta = (double *)malloc(batch_size * sizeof(double));
+  batch_in = (double *)malloc(batch_size * net.NumInput * sizeof(double));
+  batch_out = (double *)malloc(batch_size * net.NumOutput * sizeof(double));
+
+  if(window > 0 && data_cnt > 0)        // Start reading the first chunk.
+  {
+    RandPermute(chunk_order, num_chunks);
+    data.Fetch(chunk_order[0]);
+    c = 1;
+  }
 
   for(i = 0; i < iter_cnt; i++)
   {
     rms = 0;
+    batch_cnt = 0;
 
     for(j = 0; j < data_cnt; j++)
     {
-      k = Rand32() % (data_cnt - j);
-      for(l = 0; k >= 0; k--)
+      if(pos == chunk_num)              // Choose the order of the samples
+      {                                 //   (of the next chunk, if
+        if(window > 0)                  //   streaming, starting to read
+        {                               //   the one after).
+          nwErr = data.NextChunk(&chunk_first, &chunk_num);
+          if(nwErr != NW_SUCCESS)
+          {
+            fprintf(stderr, "%s: %s\n", data_file, net.ErrMsg(nwErr));
+            exit(1);
+          }
+          if(c == num_chunks && i < iter_cnt - 1)
+          {
+            RandPermute(chunk_order, num_chunks);
+            c = 0;
+          }
+          if(c < num_chunks)
+            data.Fetch(chunk_order[c++]);
+        }
+        else
+        {
+          chunk_first = 0;
+          chunk_num = data_cnt;
+        }
+
+        if(chunk_num > order_space)
+        {
+          order_space = chunk_num;
+          order = (unsigned long *)realloc(order, order_space *
+                                           sizeof(unsigned long));
+          blocks = (unsigned long *)realloc(blocks, order_space *
+                                            sizeof(unsigned long));
+        }
+        Order(order, blocks, chunk_num, block, replace);
+        pos = 0;
+      }
+
+      l = chunk_first + order[pos++];
+
+      if(data_file != NULL)
+        s_eta = data.Row(l, &s_in, &s_out);
+      else
       {
-        while(touched[l])
-          l++;
+        s_eta = &text[l * (net.NumInput + net.NumOutput + 1)];
+        s_in = s_eta + 1;
+        s_out = s_in + net.NumInput;
       }
 
-      touched[l] = TRUE;
+      if(batch_size > 1 || async)       // Add sample to the batch.
+      {
+        batch_eta[batch_cnt] = *s_eta;
+        memcpy(&batch_in[batch_cnt * net.NumInput], s_in,
+               net.NumInput * sizeof(double));
+        memcpy(&batch_out[batch_cnt * net.NumOutput], s_out,
+               net.NumOutput * sizeof(double));
+
+        if(++batch_cnt == batch_size || j == data_cnt - 1)
+        {
+          if(async)
+            net.TrainHogwild(batch_cnt, batch_in, batch_out, batch_eta, &rms);
+          else
+            net.TrainBatch(batch_cnt, batch_in, batch_out, batch_eta, &rms);
+          batch_cnt = 0;
+        }
+        continue;
+      }
 
       for(k = 0; k < net.NumInput; k++)
-        net.SetInput(k, input[l][k]);
+        net.SetInput(k, s_in[k]);
       net.ForwardPass();
 
       for(k = 0; k < net.NumOutput; k++)
       {
-        net.ApplyTarget(net.NumUnits - net.NumOutput + k, output[l][k]);
+        net.ApplyTarget(net.NumUnits - net.NumOutput + k, s_out[k]);
         rms += net.Error[net.NumUnits - net.NumOutput + k]
                * net.Error[net.NumUnits - net.NumOutput + k];
       }
-      net.BackwardPass(eta[l], 0);
+      net.BackwardPass(*s_eta, 0);
     }
 
-    memset(touched, 0, data_cnt * sizeof(int));
-
     if(i % 100 == 99)
     {
       fprintf(stdout, "RMS(%i): %f\n",i,sqrt(rms / (net.NumOutput * data_cnt)));
-      net.Save(filename);
+      if(net.Checkpoint(weights ? weights : filename,
+                        weights ? CKPT_DELTA : CKPT_IMAGE) != NW_SUCCESS)
+        fprintf(stderr, "Unable to save checkpoint.\n");
     }
   }
 
@@ -119,5 +373,8 @@ void main(void)
   net.EndTrain();
 
   net.Save(filename);
-}
+  if(weights != NULL)
+    net.SaveWeights(weights, TRUE);
 
+  return(0);
+}